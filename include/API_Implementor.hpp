@@ -31,10 +31,17 @@
     #endif
 #endif
 
+#include <array>
+#include <atomic>
 #include <memory>
+#include <optional>
 #include <shared_mutex>
 #include <string>
 #include <vector>
+#include <CancellationToken.hpp>
+#include <MemoryAccount.hpp>
+#include <ProfiledMutex.hpp>
+#include <RequestLimiter.hpp>
 #include <nlohmann/json.hpp>
 
 namespace ncpass
@@ -91,7 +98,10 @@ class NCPASSCPP_PUBLIC API_Implementor : public std::enable_shared_from_this<API
     static std::vector<std::shared_ptr<API_Type>> s_activeInstances;   ///< Contains all the instances currently existing of a certain API_Type that are vaild.
     static std::vector<std::shared_ptr<API_Type>> s_creatingInstances; ///< Contains all the instances currently existing of a certain API_Type that are being created (constructing or first pull).
     static std::vector<std::weak_ptr<API_Type>>   s_deletingInstances; ///< Contains all the instances currently existing of a certain API_Type that are pending deletion.
-    static std::shared_mutex s_mutex;                                  ///< Mutex used for locking access to static variables.
+    static ProfiledMutex<std::shared_mutex> s_mutex;                   ///< Mutex used for locking access to static variables.
+    static MemoryAccount                    s_memoryAccount;           ///< The memory held by all the instances of API_Type.
+
+    mutable std::array<std::atomic<size_t>, MemoryAccount::TRANSPORT + 1> _accountedMemory; ///< The memory this instance reported with API_Implementor::setMemoryUsage().
 
 
   protected:
@@ -104,12 +114,13 @@ class NCPASSCPP_PUBLIC API_Implementor : public std::enable_shared_from_this<API
      */
     enum Methods
     {
+        GET,
         POST,
         PATCH
     };
 
 
-    constexpr const static char* strMethods[] = { "POST", "PATCH" }; ///< Used to get a C string from API_Implementor::Methods
+    constexpr const static char* strMethods[] = { "GET", "POST", "PATCH" }; ///< Used to get a C string from API_Implementor::Methods
 
     /**
      * @brief Constructor for providing the Nextcloud server's credentials.
@@ -167,9 +178,83 @@ class NCPASSCPP_PUBLIC API_Implementor : public std::enable_shared_from_this<API
      * @param method The HTTPS method to use for the call.
      * @param apiAction The final part of the API URL.
      * @param apiArgs The arguments for the POST request in JSON. example JSON: { {"arg1", "value"}, {"arg2", "value"} }
-     * @return The returning JSON of the call.
+     * @param priority The lane the request waits in when the Session's request limit is reached.
+     * @param token Aborts the request once cancelled. The request is also bounded by the Session's timeouts.
+     * @return The returning JSON of the call. An empty object if the request failed or was cancelled.
+     */
+    nlohmann::json apiCall(Methods method, const std::string& apiAction, const nlohmann::json& apiArgs, RequestLimiter::Priority priority = RequestLimiter::NORMAL,
+                           const CancellationToken& token = CancellationToken());
+
+    /**
+     * @brief Make a curl HTTPS call to the server without needing an instance (example: listing all the objects of a type).
+     * @param session The ncpass::Session to make the call with.
+     * @param apiPath The path to append to the URL (example: ncpass::Password would be "password/").
+     * @param method The HTTPS method to use for the call.
+     * @param apiAction The final part of the API URL.
+     * @param apiArgs The arguments for the POST request in JSON. example JSON: { {"arg1", "value"}, {"arg2", "value"} }
+     * @param priority The lane the request waits in when the Session's request limit is reached.
+     * @param token Aborts the request once cancelled. The request is also bounded by the Session's timeouts.
+     * @return The returning JSON of the call. An empty object if the request failed or was cancelled.
+     */
+    static nlohmann::json apiCall(const Session& session, const std::string& apiPath, Methods method, const std::string& apiAction, const nlohmann::json& apiArgs,
+                                  RequestLimiter::Priority priority = RequestLimiter::NORMAL, const CancellationToken& token = CancellationToken());
+
+    /**
+     * @brief Make a curl HTTPS call to the server and get the raw response (example: an image from the service API).
+     * Takes care of everything API_Implementor::apiCall() does except parsing the response.
+     * @param session The ncpass::Session to make the call with.
+     * @param apiPath The path to append to the URL (example: "service/").
+     * @param method The HTTPS method to use for the call.
+     * @param apiAction The final part of the API URL.
+     * @param apiArgs The arguments for the POST request in JSON. Not sent with API_Implementor::GET.
+     * @param priority The lane the request waits in when the Session's request limit is reached.
+     * @param token Aborts the request once cancelled. The request is also bounded by the Session's timeouts.
+     * @param responseCode Set to the HTTP status code of the response if not nullptr.
+     * @return The body of the response. Nothing if the request failed or was cancelled.
+     */
+    static std::optional<std::string> apiRequest(const Session& session, const std::string& apiPath, Methods method, const std::string& apiAction, const nlohmann::json& apiArgs,
+                                                 RequestLimiter::Priority priority = RequestLimiter::NORMAL, const CancellationToken& token = CancellationToken(),
+                                                 long* responseCode = nullptr);
+
+    /**
+     * @return The ncpass::Session this instance is tied to.
+     */
+    const Session& getSession() const;
+
+    /**
+     * @brief Counts memory in the account of the Session and of API_Type.
+     * @param session The Session the memory belongs to.
+     * @param category What the memory is used for.
+     * @param bytes The amount of bytes.
+     */
+    static void addMemory(const Session& session, MemoryAccount::Category category, size_t bytes);
+
+    /**
+     * @brief Stops counting memory added with API_Implementor::addMemory().
+     * @param session The Session the memory belongs to.
+     * @param category What the memory was used for.
+     * @param bytes The amount of bytes.
+     */
+    static void removeMemory(const Session& session, MemoryAccount::Category category, size_t bytes);
+
+    /**
+     * @brief Reports how much memory this instance holds for a category. Replaces what was reported for the category before.
+     * @param category What the memory is used for.
+     * @param bytes The amount of bytes.
+     */
+    void setMemoryUsage(MemoryAccount::Category category, size_t bytes) const;
+
+    /**
+     * @brief Stops counting all the memory this instance reported. Called by the destructor.
+     */
+    void releaseMemoryUsage() const;
+
+    /**
+     * @brief Gets the memory held by all instances of API_Type across every Session.
+     * Requests are counted as transport of the type that made them.
+     * @return The memory usage of the type.
      */
-    nlohmann::json apiCall(Methods method, const std::string& apiAction, const nlohmann::json& apiArgs);
+    static MemoryUsage getTypeMemoryUsage();
 
 
   public:
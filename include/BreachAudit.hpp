@@ -0,0 +1,194 @@
+/*
+ * ncpasscpp. A library that implements Nextcloud Password's API.
+ * Copyright (C) 2021  Reed Krantz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#if defined _WIN32 || defined __CYGWIN__
+    #ifdef BUILDING_NCPASSCPP
+        #define NCPASSCPP_PUBLIC __declspec(dllexport)
+    #else
+        #define NCPASSCPP_PUBLIC __declspec(dllimport)
+    #endif
+#else
+    #ifdef BUILDING_NCPASSCPP
+        #define NCPASSCPP_PUBLIC __attribute__ ((visibility("default")))
+    #else
+        #define NCPASSCPP_PUBLIC
+    #endif
+#endif
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <CancellationToken.hpp>
+#include <ChangeNotifier.hpp>
+
+namespace ncpass
+{
+
+
+
+
+class Password; // forward declaration
+class Session;  // forward declaration
+
+
+
+
+/**
+ * @brief Checks the passwords of a Session against a local copy of the Have I Been Pwned password list, without any network requests.
+ * The list is the SHA-1 file ordered by hash ("HASH:COUNT" per line), as offered by haveibeenpwned.com or put together by the PwnedPasswordsDownloader.
+ * The file is memory mapped and searched in place, so it's never loaded into memory and opening it is instant.
+ * Passwords are matched by the "hash" field the server keeps for them. A hash the server shortened (see the "hash length" setting of the Passwords app) matches every breached hash it's the beginning of.
+ * @see https://haveibeenpwned.com/Passwords
+ * @author Reed Krantz
+ */
+class NCPASSCPP_PUBLIC BreachAudit : public std::enable_shared_from_this<BreachAudit>
+{
+  public:
+
+    /**
+     * @brief A password found in the list.
+     */
+    struct Finding
+    {
+        std::shared_ptr<Password> password; ///< The breached password.
+        uint64_t                  count;    ///< How often the password was seen in breaches.
+    };
+
+    /**
+     * @brief The outcome of BreachAudit::audit().
+     */
+    struct Report
+    {
+        std::vector<Finding> breached;  ///< The breached passwords.
+        size_t               audited;   ///< The amount of passwords checked.
+        size_t               unaudited; ///< The amount of passwords without a hash (not pulled yet or the server doesn't keep their hash).
+        bool                 complete;  ///< False if the token was cancelled before all the passwords were checked.
+    };
+
+    typedef std::function<void(const Finding& finding)> Callback; ///< Called by BreachAudit::watch() whenever a password is changed to a breached one.
+
+
+  private:
+
+    constexpr const static size_t k_hashLength = 40; ///< The length of a SHA-1 hash in hex.
+
+    /**
+     * @brief The outcome of the last check of a password.
+     */
+    struct Result
+    {
+        std::weak_ptr<Password> password; ///< The password checked. Used to tell if the entry still belongs to a live password.
+        std::string             hash;     ///< The hash that was checked.
+        uint64_t                count;    ///< How often the hash was seen in breaches. 0 if it wasn't.
+    };
+
+    const char* _data; ///< The memory mapped file.
+    size_t      _size; ///< The size of the file in bytes.
+
+    std::unordered_map<const Password*, Result> _results; ///< The outcome of the last check of every password, so audits only check the passwords that changed since.
+    mutable std::mutex                          _mutex;   ///< Mutex used for locking access to BreachAudit::_results.
+
+    /**
+     * @param data The memory mapped file.
+     * @param size The size of the file in bytes.
+     */
+    BreachAudit(const char* data, size_t size);
+
+    /**
+     * @param pos An offset into the file.
+     * @return The offset of the start of the line pos is in.
+     */
+    size_t lineStart(size_t pos) const;
+
+    /**
+     * @param pos The offset of the start of a line.
+     * @return The line without its line break.
+     */
+    std::string_view lineAt(size_t pos) const;
+
+    /**
+     * @param line A line of the file.
+     * @return The first 16 hex digits of the hash of the line as a number. Used to interpolate the position of a hash.
+     */
+    static uint64_t hashKey(std::string_view line);
+
+    /**
+     * @brief Gets the hash to check for a password from its latest snapshot, without touching it.
+     * @param password The password.
+     * @return The hash in upper case. Empty if the password has none or it isn't a hash.
+     */
+    static std::string getHash(const Password& password);
+
+
+  public:
+
+    BreachAudit(const BreachAudit&)            = delete;
+    BreachAudit& operator=(const BreachAudit&) = delete;
+
+    /**
+     * @brief Unmaps the file.
+     */
+    ~BreachAudit();
+
+    /**
+     * @brief Memory maps a password list.
+     * @param path The path of the SHA-1 list ordered by hash.
+     * @return The audit. nullptr if the file couldn't be opened or is empty.
+     */
+    static std::shared_ptr<BreachAudit> open(const std::string& path);
+
+    /**
+     * @brief Looks up a hash in the list.
+     * The position of the hash is interpolated from its value, since SHA-1 hashes are spread evenly, then narrowed down by bisection. A lookup touches only a few pages of the file.
+     * Thread safe, lookups don't lock.
+     * @param hash A SHA-1 hash in hex, or the beginning of one (example: the "hash" field of a password). Either case.
+     * @return How often the hash was seen in breaches. 0 if it wasn't in the list or isn't a hash.
+     */
+    uint64_t lookup(const std::string& hash) const;
+
+    /**
+     * @brief Checks all the fetched passwords of a Session.
+     * The passwords are checked in parallel across all cores. Passwords whose hash didn't change since they were last checked by this audit aren't looked up again.
+     * This is a local only action. Blocks the thread.
+     * @param session A shared_ptr to a ncpass::Session instance.
+     * @param token Stops the audit once cancelled.
+     * @return The outcome of the audit.
+     * @see ncpass::Password::fetchAll()
+     */
+    Report audit(const std::shared_ptr<Session>& session, const CancellationToken& token = CancellationToken());
+
+    /**
+     * @brief Checks every password of a Session again whenever its hash changes (example: Password::setPassword() or a pull).
+     * Keeps the outcome of the next BreachAudit::audit() up to date as well. The subscription is dropped with ncpass::Session::unsubscribe().
+     * @param session A shared_ptr to a ncpass::Session instance.
+     * @param callback Called whenever a password changes to a breached one.
+     * @param executor Runs the callback. If empty the callback is called on the thread that made the change.
+     * @return The ID of the subscription.
+     * @see ncpass::Session::subscribe()
+     */
+    ChangeNotifier::SubscriptionID watch(const std::shared_ptr<Session>& session, Callback callback, ChangeNotifier::Executor executor = nullptr);
+};
+
+
+}
@@ -0,0 +1,208 @@
+/*
+ * ncpasscpp. A library that implements Nextcloud Password's API.
+ * Copyright (C) 2021  Reed Krantz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#if defined _WIN32 || defined __CYGWIN__
+    #ifdef BUILDING_NCPASSCPP
+        #define NCPASSCPP_PUBLIC __declspec(dllexport)
+    #else
+        #define NCPASSCPP_PUBLIC __declspec(dllimport)
+    #endif
+#else
+    #ifdef BUILDING_NCPASSCPP
+        #define NCPASSCPP_PUBLIC __attribute__ ((visibility("default")))
+    #else
+        #define NCPASSCPP_PUBLIC
+    #endif
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+
+namespace ncpass
+{
+
+
+
+
+/**
+ * @brief Cancels asynchronous operations or gives them a deadline.
+ * Copies share the same state, so cancelling any copy cancels the operations that were given one of the others.
+ * A cancelled operation stops waiting, aborts its request and leaves its pending changes queued so they can be pushed later.
+ * @author Reed Krantz
+ */
+class NCPASSCPP_PUBLIC CancellationToken
+{
+  private:
+
+    /**
+     * @brief The state shared by all copies of a token.
+     */
+    struct State
+    {
+        std::atomic<bool>                     cancelled; ///< True once CancellationToken::cancel() was called.
+        std::atomic<bool>                     urgent;    ///< True once CancellationToken::setUrgent() was called.
+        std::chrono::steady_clock::time_point deadline;  ///< The time the token counts as cancelled. time_point::max() if there is none.
+        std::list<std::function<void()>>      wakeups;   ///< Called by CancellationToken::cancel() and CancellationToken::setUrgent(). Registered by CancellationToken::Wakeup.
+        std::mutex                            mutex;     ///< Mutex for State::wakeups.
+    };
+
+    std::shared_ptr<State> _state; ///< The state shared by all copies of this token.
+
+
+  public:
+
+    /**
+     * @brief Wakes up a waiting thread once the token is cancelled or made urgent, for as long as it lives.
+     * Registering and dropping it locks the token, which CancellationToken::cancel() holds while it wakes the waiting threads.
+     * So it must not be created or destroyed while holding a lock that the wake up function takes.
+     */
+    class NCPASSCPP_PUBLIC Wakeup
+    {
+      private:
+
+        std::shared_ptr<State>                     _state; ///< The state of the token.
+        std::list<std::function<void()>>::iterator _itr;   ///< The position of the wake up function in State::wakeups.
+
+
+      public:
+
+        /**
+         * @param token The token.
+         * @param wake Called on the thread calling CancellationToken::cancel() (example: locks the mutex of a condition variable and notifies it).
+         */
+        Wakeup(const CancellationToken& token, std::function<void()> wake);
+
+        /**
+         * @brief Unregisters the wake up function. It's never called afterwards.
+         */
+        ~Wakeup();
+
+        Wakeup(const Wakeup&)            = delete;
+        Wakeup& operator=(const Wakeup&) = delete;
+    };
+
+    /**
+     * @brief Creates a token without a deadline that is only cancelled by CancellationToken::cancel().
+     */
+    CancellationToken();
+
+    /**
+     * @brief Creates a token that is cancelled at the deadline.
+     * @param deadline The time the token counts as cancelled.
+     */
+    explicit CancellationToken(std::chrono::steady_clock::time_point deadline);
+
+    /**
+     * @brief Creates a token that is cancelled after a timeout.
+     * @param timeout The time from now until the token counts as cancelled.
+     * @return The new token.
+     */
+    static CancellationToken after(std::chrono::milliseconds timeout);
+
+    /**
+     * @brief Cancels every operation that was given this token or one of its copies and wakes up the threads waiting on it.
+     * Takes the locks of the waiting threads, so it must not be called while holding one of them.
+     */
+    void cancel();
+
+    /**
+     * @return True if the token was cancelled or its deadline passed.
+     */
+    bool isCancelled() const;
+
+    /**
+     * @brief Marks the operations that were given this token or one of its copies as awaited by the user and wakes up the threads waiting on it.
+     * Their requests waiting in a lower lane of a ncpass::RequestLimiter move up to the ncpass::RequestLimiter::INTERACTIVE lane.
+     * Takes the locks of the waiting threads, so it must not be called while holding one of them.
+     */
+    void setUrgent();
+
+    /**
+     * @return True if the token was made urgent.
+     */
+    bool isUrgent() const;
+
+    /**
+     * @return The deadline of the token. time_point::max() if there is none.
+     */
+    std::chrono::steady_clock::time_point getDeadline() const;
+
+    /**
+     * @brief Waits on a condition variable once, until it's notified or the deadline of the token passes.
+     * Without a CancellationToken::Wakeup only the deadline wakes the thread up, not CancellationToken::cancel().
+     * @param conVar The condition variable to wait on.
+     * @param lock A lock on the mutex of the condition variable.
+     */
+    template <class ConVar, class Lock>
+    void waitOnce(ConVar& conVar, Lock& lock) const
+    {
+        if( _state->deadline == std::chrono::steady_clock::time_point::max() )
+            conVar.wait(lock);
+        else
+            conVar.wait_until(lock, _state->deadline);
+    }
+
+    /**
+     * @brief Waits on a condition variable until the predicate is true or the token is cancelled.
+     * The lock is let go briefly to register a CancellationToken::Wakeup, just like waiting on the condition variable would.
+     * @param conVar The condition variable to wait on.
+     * @param lock A lock on the mutex of the condition variable.
+     * @param predicate The condition to wait for.
+     * @return True if the predicate became true, false if the token was cancelled first.
+     */
+    template <class ConVar, class Lock, class Predicate>
+    bool wait(ConVar& conVar, Lock& lock, Predicate predicate) const
+    {
+        while( !predicate() )
+        {
+            if( isCancelled() )
+                return false;
+
+            lock.unlock();
+
+            {
+                Wakeup wakeup(*this, [&conVar, mutex = lock.mutex()] ()
+                  {
+                      std::unique_lock wakeLock(*mutex);
+
+                      conVar.notify_all();
+                  }
+                  );
+
+                lock.lock();
+
+                while( !predicate() && !isCancelled() )
+                    waitOnce(conVar, lock);
+
+                lock.unlock();
+            }
+
+            lock.lock();
+        }
+
+        return true;
+    }
+};
+
+
+}
@@ -0,0 +1,147 @@
+/*
+ * ncpasscpp. A library that implements Nextcloud Password's API.
+ * Copyright (C) 2021  Reed Krantz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#if defined _WIN32 || defined __CYGWIN__
+    #ifdef BUILDING_NCPASSCPP
+        #define NCPASSCPP_PUBLIC __declspec(dllexport)
+    #else
+        #define NCPASSCPP_PUBLIC __declspec(dllimport)
+    #endif
+#else
+    #ifdef BUILDING_NCPASSCPP
+        #define NCPASSCPP_PUBLIC __attribute__ ((visibility("default")))
+    #else
+        #define NCPASSCPP_PUBLIC
+    #endif
+#endif
+
+#include <functional>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ncpass
+{
+
+
+
+
+class Password; // forward declaration
+
+
+
+
+/**
+ * @brief Describes a change to a Password.
+ * @see ncpass::ChangeNotifier
+ */
+struct NCPASSCPP_PUBLIC ChangeEvent
+{
+    /**
+     * @brief Where a change came from.
+     */
+    enum Origin
+    {
+        LOCAL, ///< The application changed the password. It isn't pushed yet.
+        PULL,  ///< The password was pulled from the server.
+        PUSH,  ///< A local change was pushed to the server.
+        FAILED ///< A local change couldn't be pushed or the password couldn't be created. The change stays pending.
+    };
+
+    std::shared_ptr<Password> password;    ///< The password that changed.
+    std::string               oldRevision; ///< The revision before the change. Empty if the password had none yet.
+    std::string               newRevision; ///< The revision after the change. The same as ChangeEvent::oldRevision for ChangeEvent::LOCAL changes.
+    std::vector<std::string>  fields;      ///< The keys of the fields that changed (example: "label").
+    Origin                    origin;      ///< Where the change came from.
+};
+
+
+
+
+/**
+ * @brief Delivers ChangeEvents to the observers of a Session.
+ * Observers subscribe to a whole Session, one Password or one field of a Password and are only called for the changes they subscribed to.
+ * Each observer is called on the executor it subscribed with, so a UI can have its events posted to its own event loop.
+ * @see ncpass::Session::subscribe()
+ * @see ncpass::Password::subscribe()
+ * @author Reed Krantz
+ */
+class NCPASSCPP_PUBLIC ChangeNotifier
+{
+  public:
+
+    using Callback       = std::function<void(const ChangeEvent&)>;     ///< Called with every change an observer subscribed to.
+    using Executor       = std::function<void(std::function<void()>)>; ///< Runs a task (example: posts it to an event loop). An empty Executor runs the task on the thread that made the change.
+    using SubscriptionID = unsigned long;                               ///< Identifies a subscription so it can be cancelled.
+
+
+  private:
+
+    /**
+     * @brief An observer and what it subscribed to.
+     */
+    struct Subscription
+    {
+        const Password* password; ///< The password observed. nullptr for every password of the Session.
+        std::string     field;    ///< The key of the field observed. Empty for every field.
+        Callback        callback; ///< Called with every matching change.
+        Executor        executor; ///< Runs ChangeNotifier::Subscription::callback.
+    };
+
+    std::unordered_map<SubscriptionID, Subscription>                 _subscriptions; ///< All subscriptions by their ID.
+    std::unordered_map<const Password*, std::vector<SubscriptionID>> _byPassword;    ///< The IDs of the subscriptions of each password. nullptr for the whole Session.
+    SubscriptionID                                                   _nextID;        ///< The ID of the next subscription.
+    mutable std::shared_mutex                                        _mutex;         ///< Mutex used for locking access to all member variables.
+
+
+  public:
+
+    /**
+     * @brief Constructor for ChangeNotifier.
+     */
+    ChangeNotifier();
+
+    /**
+     * @brief Adds an observer.
+     * @param password The password to observe. nullptr to observe every password of the Session.
+     * @param field The key of the field to observe (example: "label"). Empty to observe every field.
+     * @param callback Called with every matching change.
+     * @param executor Runs the callback. If empty the callback is called on the thread that made the change, which is usually a background thread.
+     * @return The ID of the subscription.
+     */
+    SubscriptionID subscribe(const Password* password, const std::string& field, Callback callback, Executor executor);
+
+    /**
+     * @brief Removes an observer. Events that were already handed to its executor are still delivered.
+     * @param id The ID returned by ChangeNotifier::subscribe().
+     */
+    void unsubscribe(SubscriptionID id);
+
+    /**
+     * @brief Hands a change to every observer that subscribed to it.
+     * Must be called without any locks of the changed password held, so observers can read it right away.
+     * @param event The change.
+     */
+    void notify(const ChangeEvent& event) const;
+};
+
+
+}
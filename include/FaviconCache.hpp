@@ -0,0 +1,248 @@
+/*
+ * ncpasscpp. A library that implements Nextcloud Password's API.
+ * Copyright (C) 2021  Reed Krantz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#if defined _WIN32 || defined __CYGWIN__
+    #ifdef BUILDING_NCPASSCPP
+        #define NCPASSCPP_PUBLIC __declspec(dllexport)
+    #else
+        #define NCPASSCPP_PUBLIC __declspec(dllimport)
+    #endif
+#else
+    #ifdef BUILDING_NCPASSCPP
+        #define NCPASSCPP_PUBLIC __attribute__ ((visibility("default")))
+    #else
+        #define NCPASSCPP_PUBLIC
+    #endif
+#endif
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <CancellationToken.hpp>
+#include <RequestLimiter.hpp>
+
+namespace ncpass
+{
+
+
+
+
+/**
+ * @brief Caches the favicons and website previews of the service API of the server, so lists can show them without a request per row.
+ * Images are requested once per domain no matter how many passwords share it, even while the first request is still in flight.
+ * They are kept in memory in least recently used order and optionally on disk, both bounded in size.
+ * Images are downloaded by a few background threads. Images that were asked for go first, prefetched ones go in the ncpass::RequestLimiter::BULK lane.
+ * @see https://git.mdns.eu/nextcloud/passwords/-/wikis/Developers/Api/Service-Api
+ * @author Reed Krantz
+ */
+class NCPASSCPP_PUBLIC FaviconCache
+{
+  public:
+
+    typedef std::shared_ptr<const std::string> Image; ///< The bytes of an image as sent by the server (usually a PNG). nullptr if the image isn't available.
+
+    /**
+     * @brief Downloads the image of a service action (example: "favicon/example.com/32"). Blocks until it's downloaded.
+     * Returns nothing if the image couldn't be downloaded.
+     */
+    typedef std::function<std::optional<std::string>(const std::string& action, RequestLimiter::Priority priority, const CancellationToken& token)> Source;
+
+    constexpr const static int    k_defaultSize        = 32;              ///< The size of a favicon in pixels if none is given.
+    constexpr const static size_t k_defaultMemoryLimit = 4 * 1024 * 1024; ///< How many bytes of images are kept in memory unless set otherwise.
+
+
+  private:
+
+    constexpr const static size_t               k_workerCount = 4;                        ///< The amount of threads downloading images.
+    constexpr const static std::chrono::seconds k_retryDelay  = std::chrono::seconds(60); ///< How long an image that couldn't be downloaded isn't asked for again.
+
+    /**
+     * @brief An image held in memory.
+     */
+    struct Entry
+    {
+        Image                                 image;    ///< The image. nullptr if it couldn't be downloaded.
+        std::chrono::steady_clock::time_point failedAt; ///< When the image couldn't be downloaded.
+        std::list<std::string>::iterator      lru;      ///< The position of the image in FaviconCache::_lru.
+    };
+
+    /**
+     * @brief An image that is waiting for or being downloaded.
+     */
+    struct Job
+    {
+        std::promise<Image>       promise;     ///< Set once the image is downloaded.
+        std::shared_future<Image> future;      ///< Handed to everyone asking for the image in the meantime.
+        bool                      interactive; ///< True if someone asked for the image, false if it's only prefetched.
+        bool                      started;     ///< True once a worker took the job.
+    };
+
+    const Source _source; ///< Downloads the images.
+
+    std::unordered_map<std::string, Entry> _memory;      ///< The images in memory by their action.
+    std::list<std::string>                 _lru;         ///< The actions of the images in memory, most recently used first.
+    size_t                                 _memoryUsage; ///< The bytes of the images in memory.
+    size_t                                 _memoryLimit; ///< The bytes of images kept in memory at most.
+
+    std::unordered_map<std::string, Job> _jobs;        ///< The images waiting for or being downloaded by their action.
+    std::deque<std::string>              _interactive; ///< The actions of the jobs someone asked for, oldest first.
+    std::deque<std::string>              _prefetch;    ///< The actions of the prefetched jobs, oldest first.
+
+    std::filesystem::path _directory; ///< The directory of the disk cache. Empty if there is none.
+    size_t                _diskUsage; ///< The bytes of the images in the disk cache.
+    size_t                _diskLimit; ///< The bytes of images kept on disk at most.
+
+    bool                     _stop;      ///< Tells the workers to stop.
+    CancellationToken        _stopToken; ///< Cancelled once the cache stops so the downloads in flight don't hold it up.
+    std::vector<std::thread> _workers;   ///< Download the images. Started once the first image is requested.
+
+    std::mutex              _mutex;     ///< Mutex used for locking access to all member variables except the disk cache.
+    std::mutex              _diskMutex; ///< Mutex used for locking access to the disk cache.
+    std::condition_variable _jobConVar; ///< Used whenever a job is queued or the cache stops.
+
+    /**
+     * @brief Gets an image from memory or queues it to be downloaded.
+     * @param action The service action of the image (example: "favicon/example.com/32").
+     * @param interactive True if someone is waiting for the image.
+     * @return A future for the image.
+     */
+    std::shared_future<Image> request(const std::string& action, bool interactive);
+
+    /**
+     * @brief Drops the least recently used images from memory until it's within its limit. Must be called with FaviconCache::_mutex locked.
+     */
+    void trimMemory();
+
+    /**
+     * @brief Puts an image in memory and drops the least recently used images over the memory limit. Must be called with FaviconCache::_mutex locked.
+     * @param action The service action of the image.
+     * @param image The image. nullptr if it couldn't be downloaded.
+     */
+    void remember(const std::string& action, const Image& image);
+
+    /**
+     * @param action The service action of an image.
+     * @return The path of the image in the disk cache. Must be called with FaviconCache::_diskMutex locked.
+     */
+    std::filesystem::path getDiskPath(const std::string& action) const;
+
+    /**
+     * @brief Reads an image from the disk cache and marks it as recently used.
+     * @param action The service action of the image.
+     * @return The image. nullptr if it isn't on disk.
+     */
+    Image readDisk(const std::string& action);
+
+    /**
+     * @brief Drops the least recently used images from the disk cache until it's within its limit. Must be called with FaviconCache::_diskMutex locked.
+     */
+    void trimDisk();
+
+    /**
+     * @brief Writes an image to the disk cache and drops the least recently used images over the disk limit.
+     * @param action The service action of the image.
+     * @param image The image.
+     */
+    void writeDisk(const std::string& action, const std::string& image);
+
+    /**
+     * @brief Downloads the queued images until the cache stops. Runs on the worker threads.
+     */
+    void work();
+
+
+  public:
+
+    /**
+     * @param source Downloads the images (example: a request to the service API of a Session).
+     */
+    explicit FaviconCache(Source source);
+
+    /**
+     * @brief Stops the workers.
+     */
+    ~FaviconCache();
+
+    /**
+     * @brief Gets the domain of a URL the way the server expects it (example: "https://user@Example.com:8080/login" is "example.com").
+     * @param url A URL or a domain.
+     * @return The domain. Empty if the URL has no domain or the domain contains characters other than letters, digits, '.', '-' and '_' (example: an unencoded international domain name).
+     */
+    static std::string getDomain(const std::string& url);
+
+    /**
+     * @brief Sets how many bytes of images are kept in memory. Drops the least recently used images over the limit.
+     * @param bytes The limit.
+     */
+    void setMemoryLimit(size_t bytes);
+
+    /**
+     * @brief Keeps the images on disk as well, so they survive the application. Images are dropped from disk least recently used first.
+     * @param directory The directory to keep the images in. Created if it doesn't exist. Empty to stop using a disk cache.
+     * @param bytes How many bytes of images are kept on disk at most.
+     * @return False if the directory couldn't be created.
+     */
+    bool setDiskCache(const std::string& directory, size_t bytes);
+
+    /**
+     * @brief Gets the favicon of a website. Returns a future that's ready right away if the favicon is in memory.
+     * @param url A URL or a domain (example: the URL of a password).
+     * @param size The size of the favicon in pixels.
+     * @return A future for the favicon. Holds nullptr if the favicon couldn't be downloaded.
+     */
+    std::shared_future<Image> getFavicon(const std::string& url, int size = k_defaultSize);
+
+    /**
+     * @brief Gets a screenshot of a website. Returns a future that's ready right away if the preview is in memory.
+     * @param url A URL or a domain (example: the URL of a password).
+     * @param mobile True for the mobile version of the website.
+     * @param width The width of the preview in pixels.
+     * @param height The height of the preview in pixels.
+     * @return A future for the preview. Holds nullptr if the preview couldn't be downloaded.
+     */
+    std::shared_future<Image> getPreview(const std::string& url, bool mobile = false, int width = 640, int height = 360);
+
+    /**
+     * @brief Downloads the favicons of websites in the background, so they're ready once they're asked for (example: the rows that are about to be shown).
+     * Favicons that are cached or already being downloaded are skipped.
+     * @param urls URLs or domains.
+     * @param size The size of the favicons in pixels.
+     */
+    void prefetchFavicons(const std::vector<std::string>& urls, int size = k_defaultSize);
+
+    /**
+     * @brief Stops the workers. Aborts the downloads in flight, their futures hold nullptr.
+     * Images in memory can still be read afterwards, but nothing is downloaded or read from disk anymore.
+     */
+    void stop();
+};
+
+
+}
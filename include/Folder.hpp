@@ -0,0 +1,178 @@
+/*
+ * ncpasscpp. A library that implements Nextcloud Password's API.
+ * Copyright (C) 2021  Reed Krantz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#if defined _WIN32 || defined __CYGWIN__
+    #ifdef BUILDING_NCPASSCPP
+        #define NCPASSCPP_PUBLIC __declspec(dllexport)
+    #else
+        #define NCPASSCPP_PUBLIC __declspec(dllimport)
+    #endif
+#else
+    #ifdef BUILDING_NCPASSCPP
+        #define NCPASSCPP_PUBLIC __attribute__ ((visibility("default")))
+    #else
+        #define NCPASSCPP_PUBLIC
+    #endif
+#endif
+
+#include <atomic>
+#include <condition_variable>
+#include <future>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+#include <API_Implementor.hpp>
+#include <nlohmann/json.hpp>
+
+namespace ncpass
+{
+
+
+
+
+class Password; // forward declaration
+
+
+
+
+/**
+ * @brief Folder objects tied to the nextcloud server.
+ * Folders are read only for now. The folder tree is kept locally in the Session's ncpass::RelationIndex so navigating it doesn't need any API calls.
+ * @see ncpass::RelationIndex
+ * @author Reed Krantz
+ */
+class NCPASSCPP_PUBLIC Folder : public API_Implementor<Folder>
+{
+  private:
+
+    nlohmann::json _json;          ///< The most current JSON for the folder.
+    std::string    _indexedParent; ///< The ID of the parent this folder is filed under in the Session's RelationIndex.
+    bool           _pullFailed;    ///< True if the last pull failed. Wakes up the getters waiting for fields that aren't coming.
+
+    mutable std::atomic<bool> _decryptionFailed; ///< True if the last encrypted field that was read couldn't be decrypted.
+
+    mutable std::shared_mutex           _memberMutex;  ///< The mutex used to lock any member variables of this instance.
+    mutable std::condition_variable_any _updateConVar; ///< Used whenever the folder is updated in any way.
+
+    /**
+     * @brief Merges JSON from the server into this folder and files it in the Session's RelationIndex.
+     * Must be called with Folder::_memberMutex locked.
+     * @param json_new The folder JSON returned by the server.
+     */
+    void merge(const nlohmann::json& json_new);
+
+    /**
+     * @brief Gets a field and waits for it if it isn't available yet. Encrypted fields are decrypted.
+     * @param key The key of the field (example: "label").
+     * @return The value of the field. An empty string if it couldn't be pulled or decrypted, see Folder::hasPullFailed() and Folder::hasDecryptionFailed().
+     */
+    std::string getField(const std::string& key) const;
+
+
+  protected:
+
+    /**
+     * @brief Links to an existing remote folder.
+     * @param session An active Nextcloud session.
+     * @param folder_json A JSON object containing the "id" of the folder.
+     * @see ncpass::Session
+     */
+    Folder(const std::shared_ptr<Session>& session, const nlohmann::json& folder_json);
+
+    /**
+     * @brief Pulls data from the server.
+     */
+    void pull();
+
+
+  public:
+
+    constexpr const static char* k_rootID = "00000000-0000-0000-0000-000000000000"; ///< The ID of the root folder.
+
+    /**
+     * @brief Fetches a Folder from the server based on the given ID.
+     * @param session A shared_ptr to a ncpass::Session instance. Used as credentials for the Nextcloud server's API.
+     * @param id The ID of an existing folder on the nextcloud server.
+     * @return A shared_ptr to the ncpass::Folder instance of the given ID.
+     * @see ncpass::Session
+     */
+    static std::shared_ptr<Folder> fetch(const std::shared_ptr<Session>& session, const std::string& id);
+
+    /**
+     * @brief Gets all the folders from the given Nextcloud server session asynchronously in a single request.
+     * @param session A shared_ptr to a ncpass::Session instance. Used as credentials for the Nextcloud server's API.
+     * @return A future for all the folders of the session. Holds a std::runtime_error if the folders couldn't be listed.
+     * @see ncpass::Session
+     */
+    static std::future<std::vector<std::shared_ptr<Folder>>> fetchAll(const std::shared_ptr<Session>& session);
+
+    /**
+     * @brief Gets all of the active instances of the Folder class.
+     * This is a local only action and does not create or sync with new folders in nextcloud.
+     * @return A vector containing all currently active instances.
+     */
+    static std::vector<std::shared_ptr<Folder>> getAll();
+
+    /**
+     * @brief Gets the memory held by all folders across every Session. This is a local only action.
+     * @return The memory usage of the folders.
+     * @see ncpass::Session::getMemoryUsage()
+     */
+    static MemoryUsage getMemoryUsage();
+
+    /**
+     * @return The UUID of the folder.
+     */
+    std::string getID() const;
+
+    /**
+     * @return True if the last encrypted field that was read couldn't be decrypted (example: the Session is locked or the key isn't in its keychain). Its getter returned an empty string.
+     */
+    bool hasDecryptionFailed() const;
+
+    /**
+     * @return True if the last pull of the folder failed (example: it doesn't exist on the server). The getters of fields that weren't pulled returned empty values.
+     */
+    bool hasPullFailed() const;
+
+    /**
+     * @return User defined label of the folder.
+     */
+    std::string getLabel() const;
+
+    /**
+     * @return The parent of this folder. nullptr for the root folder, if the parent wasn't fetched or if this folder couldn't be pulled.
+     */
+    std::shared_ptr<Folder> getParent() const;
+
+    /**
+     * @brief Gets the folders directly inside of this folder. This is a local only action.
+     * @return The fetched child folders.
+     */
+    std::vector<std::shared_ptr<Folder>> getFolders() const;
+
+    /**
+     * @brief Gets the passwords directly inside of this folder. This is a local only action.
+     * @return The fetched passwords in this folder.
+     */
+    std::vector<std::shared_ptr<Password>> getPasswords() const;
+};
+
+
+}
@@ -0,0 +1,145 @@
+/*
+ * ncpasscpp. A library that implements Nextcloud Password's API.
+ * Copyright (C) 2021  Reed Krantz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#if defined _WIN32 || defined __CYGWIN__
+    #ifdef BUILDING_NCPASSCPP
+        #define NCPASSCPP_PUBLIC __declspec(dllexport)
+    #else
+        #define NCPASSCPP_PUBLIC __declspec(dllimport)
+    #endif
+#else
+    #ifdef BUILDING_NCPASSCPP
+        #define NCPASSCPP_PUBLIC __attribute__ ((visibility("default")))
+    #else
+        #define NCPASSCPP_PUBLIC
+    #endif
+#endif
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace ncpass
+{
+
+
+
+
+class Password; // forward declaration
+
+
+
+
+/**
+ * @brief An index of the security relevant metadata of the passwords of a Session.
+ * Passwords are filed by the hash of their secret, the time it was last changed and the status the server gave them, as they are pulled and changed.
+ * Finding reused or old passwords is then proportional to the amount found, and never needs the secrets themselves.
+ * @see ncpass::Session::getReusedPasswords()
+ * @author Reed Krantz
+ */
+class NCPASSCPP_PUBLIC HealthIndex
+{
+  public:
+
+    /**
+     * @brief What a password is filed under.
+     */
+    struct Entry
+    {
+        std::string hash;       ///< The hash of the secret, shortened to HealthIndex::k_hashKeyLength. Empty if the password has none or is in the trash.
+        int64_t     edited = 0; ///< The time the secret was last changed in seconds since the epoch. 0 if it isn't known or the password is in the trash.
+        std::string status;     ///< The "statusCode" the server gave the password (example: "OUTDATED"). Empty if it isn't known or the password is in the trash.
+
+        bool operator==(const Entry& other) const;
+        bool operator!=(const Entry& other) const;
+    };
+
+    constexpr const static size_t k_hashKeyLength = 20; ///< The shortest hash the server keeps. Hashes are compared up to this length, so the full hash of a local change matches the shortened one of a pulled password.
+
+
+  private:
+
+    using Members = std::unordered_set<std::shared_ptr<Password>>; ///< The passwords filed under one key.
+
+    std::unordered_map<std::string, Members> _byHash;   ///< Maps hashes to the passwords with that secret.
+    std::unordered_set<std::string>          _reused;   ///< The hashes in HealthIndex::_byHash with more than one password.
+    std::map<int64_t, Members>               _byEdited; ///< Maps the times secrets were last changed to the passwords changed then, oldest first.
+    std::unordered_map<std::string, Members> _byStatus; ///< Maps status codes to the passwords with that status.
+
+    mutable std::shared_mutex _mutex; ///< Mutex used for locking access to all member variables.
+
+    /**
+     * @brief Moves a password from one key to another.
+     * @param members The index to update.
+     * @param password The password to move.
+     * @param oldKey The key the password was filed under.
+     * @param newKey The key to file the password under.
+     * @param none The key that means not filed.
+     */
+    template <class Index, class Key>
+    static void move(Index& members, const std::shared_ptr<Password>& password, const Key& oldKey, const Key& newKey, const Key& none);
+
+
+  public:
+
+    /**
+     * @param hash A hash of a secret (example: the "hash" field of a password).
+     * @return The hash as it's filed in the index.
+     */
+    static std::string toHashKey(const std::string& hash);
+
+    /**
+     * @brief Files a password under a new entry.
+     * @param password The password.
+     * @param oldEntry The entry the password was filed under. Default constructed if it wasn't filed yet.
+     * @param newEntry The entry to file the password under.
+     */
+    void setPassword(const std::shared_ptr<Password>& password, const Entry& oldEntry, const Entry& newEntry);
+
+    /**
+     * @return The passwords that share their secret with another password, grouped by secret.
+     */
+    std::vector<std::vector<std::shared_ptr<Password>>> getReused() const;
+
+    /**
+     * @param hash A hash of a secret (example: the "hash" field of a password).
+     * @return The passwords with that secret.
+     */
+    std::vector<std::shared_ptr<Password>> getByHash(const std::string& hash) const;
+
+    /**
+     * @param time A time in seconds since the epoch.
+     * @return The passwords whose secret was last changed before the time, oldest first.
+     */
+    std::vector<std::shared_ptr<Password>> getEditedBefore(int64_t time) const;
+
+    /**
+     * @param status A status code (example: "OUTDATED").
+     * @return The passwords with that status.
+     */
+    std::vector<std::shared_ptr<Password>> getByStatus(const std::string& status) const;
+};
+
+
+}
@@ -0,0 +1,149 @@
+/*
+ * ncpasscpp. A library that implements Nextcloud Password's API.
+ * Copyright (C) 2021  Reed Krantz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#if defined _WIN32 || defined __CYGWIN__
+    #ifdef BUILDING_NCPASSCPP
+        #define NCPASSCPP_PUBLIC __declspec(dllexport)
+    #else
+        #define NCPASSCPP_PUBLIC __declspec(dllimport)
+    #endif
+#else
+    #ifdef BUILDING_NCPASSCPP
+        #define NCPASSCPP_PUBLIC __attribute__ ((visibility("default")))
+    #else
+        #define NCPASSCPP_PUBLIC
+    #endif
+#endif
+
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+namespace ncpass
+{
+
+
+
+
+/**
+ * @brief An encrypted append-only journal of the pending changes of a Session.
+ * Every record is encrypted on its own and written as one line. Records are written and synced to the disk in batches by a background thread so appending never waits for the disk.
+ * The journal knows three kinds of records, all with a "key" identifying a password (its ID or a local key for passwords that weren't created yet):
+ *   - "edit" with a "patch" that was applied to the password.
+ *   - "created" with the "id" the server gave a password.
+ *   - "synced" once all edits of a password are on the server.
+ * @author Reed Krantz
+ */
+class NCPASSCPP_PUBLIC Journal
+{
+  private:
+
+    constexpr const static char* k_magic       = "ncpass-journal-1"; ///< The first word of the header line of a journal file.
+    constexpr const static char* k_checkRecord = "ncpass-journal";   ///< Sealed into the header line so a wrong passphrase is detected before any record is read.
+
+    std::unique_ptr<unsigned char, void (*)(void*)> _key; ///< The key records are encrypted with. Allocated with sodium_malloc().
+    int                                            _fd;  ///< The file descriptor of the journal file. -1 if the journal isn't open.
+
+    std::vector<std::string> _queue;    ///< Encrypted records waiting to be written.
+    unsigned long            _appended; ///< The amount of records appended so far.
+    unsigned long            _written;  ///< The amount of records written and synced so far.
+    bool                     _failed;   ///< True once a batch couldn't be written or synced. Nothing is written anymore until the journal is opened again.
+    bool                     _stop;     ///< Tells the writer thread to stop.
+    std::thread              _writer;   ///< Writes the queued records in batches.
+
+    mutable std::mutex      _mutex;          ///< Mutex used for locking access to all member variables.
+    std::condition_variable _queuedConVar;   ///< Used whenever a record is queued or the writer should stop.
+    std::condition_variable _writtenConVar;  ///< Used whenever a batch is written.
+
+    /**
+     * @brief Encrypts a record into a line of the journal.
+     * @param record The record.
+     * @return The hex encoded nonce and encrypted record.
+     */
+    std::string seal(const nlohmann::json& record) const;
+
+    /**
+     * @brief Decrypts a line of the journal.
+     * @param line The line without the line break.
+     * @return The record. A discarded JSON value if the line is corrupt (example: torn by a crash).
+     */
+    nlohmann::json unseal(const std::string& line) const;
+
+    /**
+     * @brief Writes the queued records in batches and syncs each batch to the disk. Runs on Journal::_writer.
+     * A batch that fails stays queued and the journal fails, since a partly written batch can't be appended to safely.
+     */
+    void writeLoop();
+
+    /**
+     * @brief Stops the writer thread after it wrote everything and closes the file.
+     */
+    void close();
+
+
+  public:
+
+    /**
+     * @brief Creates a closed journal.
+     * @throw std::runtime_error If libsodium couldn't be initialized.
+     */
+    Journal();
+
+    /**
+     * @brief Writes the remaining records and closes the journal.
+     */
+    ~Journal();
+
+    /**
+     * @brief Opens a journal file and compacts it to the records that are still pending. Creates the file if it doesn't exist or is empty.
+     * A torn last record (example: a crash while appending) is dropped. A file that isn't a journal or has a damaged record before the last one is left untouched.
+     * The key derivation is deliberately slow, so never call this on a thread that has to stay responsive.
+     * @param path The path of the journal file.
+     * @param passphrase The passphrase the journal is encrypted with.
+     * @return Maps the keys of the passwords with pending edits to all their edits merged into one patch.
+     *         Nothing if the file couldn't be opened, isn't a journal, is damaged or the passphrase is wrong.
+     */
+    std::optional<std::map<std::string, nlohmann::json>> open(const std::string& path, const std::string& passphrase);
+
+    /**
+     * @return True if records are being journaled.
+     */
+    bool isOpen() const;
+
+    /**
+     * @brief Queues a record to be written. Returns immediately. Does nothing if the journal isn't open.
+     * @param record The record.
+     */
+    void append(const nlohmann::json& record);
+
+    /**
+     * @brief Blocks until every record appended so far is on the disk.
+     * @return False if the journal failed to write or sync a record, so the records appended since aren't durable.
+     */
+    bool flush();
+};
+
+
+}
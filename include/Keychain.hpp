@@ -0,0 +1,162 @@
+/*
+ * ncpasscpp. A library that implements Nextcloud Password's API.
+ * Copyright (C) 2021  Reed Krantz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#if defined _WIN32 || defined __CYGWIN__
+    #ifdef BUILDING_NCPASSCPP
+        #define NCPASSCPP_PUBLIC __declspec(dllexport)
+    #else
+        #define NCPASSCPP_PUBLIC __declspec(dllimport)
+    #endif
+#else
+    #ifdef BUILDING_NCPASSCPP
+        #define NCPASSCPP_PUBLIC __attribute__ ((visibility("default")))
+    #else
+        #define NCPASSCPP_PUBLIC
+    #endif
+#endif
+
+#include <condition_variable>
+#include <memory>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <CancellationToken.hpp>
+#include <nlohmann/json.hpp>
+
+namespace ncpass
+{
+
+
+
+
+/**
+ * @brief Holds the client side encryption (CSE) keys of a Session.
+ * Implements the "CSEv1r1" format of the Passwords app. The keys are kept in memory allocated by libsodium and wiped when the keychain is locked or destroyed.
+ * @see https://git.mdns.eu/nextcloud/passwords/-/wikis/Developers/Encryption/CSEv1Encryption
+ * @author Reed Krantz
+ */
+class NCPASSCPP_PUBLIC Keychain
+{
+  private:
+
+    typedef std::unique_ptr<unsigned char, void (*)(void*)> SecureKey; ///< A key in memory allocated with sodium_malloc().
+
+    std::unordered_map<std::string, SecureKey> _keys;    ///< Maps key IDs to their keys.
+    std::string                                _current; ///< The ID of the key used to encrypt new data.
+    unsigned int                               _unlocking; ///< The amount of unlocks under way. Decrypting and encrypting only wait for the keychain while there are some.
+
+    mutable std::shared_mutex           _mutex;          ///< Mutex used for locking access to all member variables.
+    mutable std::condition_variable_any _unlockedConVar; ///< Used whenever the keychain gets unlocked or locked, or an unlock ends.
+
+    /**
+     * @brief Decrypts data encrypted with crypto_secretbox_easy() and prefixed with its nonce.
+     * @param cipher The nonce followed by the encrypted data.
+     * @param key The key of crypto_secretbox_KEYBYTES bytes.
+     * @return The decrypted data. Nothing if the data is invalid or the key is wrong.
+     */
+    static std::optional<std::string> open(const std::string& cipher, const unsigned char* key);
+
+
+  public:
+
+    constexpr const static char* k_type = "CSEv1r1"; ///< The "cseType" of objects encrypted with this keychain.
+
+    /**
+     * @brief Marks an unlock as under way for as long as it lives (example: while the keychain is being fetched from the server).
+     * Decrypting and encrypting wait for the keychain in the meantime instead of failing right away.
+     */
+    class NCPASSCPP_PUBLIC Unlocking
+    {
+      private:
+
+        Keychain& _keychain; ///< The keychain being unlocked.
+
+
+      public:
+
+        /**
+         * @param keychain The keychain being unlocked.
+         */
+        explicit Unlocking(Keychain& keychain);
+
+        /**
+         * @brief Ends the unlock and wakes up the threads waiting for the keychain.
+         */
+        ~Unlocking();
+
+        Unlocking(const Unlocking&)            = delete;
+        Unlocking& operator=(const Unlocking&) = delete;
+    };
+
+    /**
+     * @brief Creates a locked keychain.
+     * @throw std::runtime_error If libsodium couldn't be initialized.
+     */
+    Keychain();
+
+    /**
+     * @brief Solves the "PWDv1r1" challenge of the "session/request" action with the master password.
+     * The key derivation is deliberately slow, so never call this on a thread that has to stay responsive.
+     * @param challenge The "challenge" object returned by "session/request".
+     * @param masterPassword The CSE master password of the account.
+     * @return The solution to send as "challenge" to "session/open". Nothing if the challenge isn't supported or is invalid.
+     */
+    static std::optional<std::string> solveChallenge(const nlohmann::json& challenge, const std::string& masterPassword);
+
+    /**
+     * @brief Decrypts the keychain returned by the "keychain/get" action with the master password.
+     * The key derivation is deliberately slow, so never call this on a thread that has to stay responsive.
+     * @param keychain_json The JSON returned by "keychain/get".
+     * @param masterPassword The CSE master password of the account.
+     * @return True if the keychain could be decrypted. False if it couldn't or its keys didn't fit into secure memory.
+     */
+    bool unlock(const nlohmann::json& keychain_json, const std::string& masterPassword);
+
+    /**
+     * @brief Wipes all keys from memory. Threads waiting for an unlock under way keep waiting for it.
+     */
+    void lock();
+
+    /**
+     * @return True if the keys are available.
+     */
+    bool isUnlocked() const;
+
+    /**
+     * @brief Decrypts a field. Blocks while an unlock is under way, fails right away if the keychain is locked otherwise.
+     * @param keyID The "cseKey" of the object the field belongs to.
+     * @param cipher The hex encoded field.
+     * @param token Stops waiting for the unlock once cancelled.
+     * @return The plain text of the field. Nothing if the keychain is locked, the token was cancelled, the key doesn't exist or the field is invalid.
+     */
+    std::optional<std::string> decrypt(const std::string& keyID, const std::string& cipher, const CancellationToken& token = CancellationToken()) const;
+
+    /**
+     * @brief Encrypts a field with the current key. Blocks while an unlock is under way, fails right away if the keychain is locked otherwise.
+     * @param plain The plain text of the field.
+     * @param keyID Gets set to the ID of the key used. This is the new "cseKey" of the object.
+     * @param token Stops waiting for the unlock once cancelled.
+     * @return The hex encoded field. Nothing if the keychain is locked or the token was cancelled.
+     */
+    std::optional<std::string> encrypt(const std::string& plain, std::string& keyID, const CancellationToken& token = CancellationToken()) const;
+};
+
+
+}
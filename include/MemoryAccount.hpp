@@ -0,0 +1,121 @@
+/*
+ * ncpasscpp. A library that implements Nextcloud Password's API.
+ * Copyright (C) 2021  Reed Krantz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#if defined _WIN32 || defined __CYGWIN__
+    #ifdef BUILDING_NCPASSCPP
+        #define NCPASSCPP_PUBLIC __declspec(dllexport)
+    #else
+        #define NCPASSCPP_PUBLIC __declspec(dllimport)
+    #endif
+#else
+    #ifdef BUILDING_NCPASSCPP
+        #define NCPASSCPP_PUBLIC __attribute__ ((visibility("default")))
+    #else
+        #define NCPASSCPP_PUBLIC
+    #endif
+#endif
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+namespace ncpass
+{
+
+
+
+
+/**
+ * @brief The amount of memory held by the library, split up by what it's used for.
+ * All values are in bytes and estimated from the sizes of the objects and the capacities of their strings.
+ */
+struct NCPASSCPP_PUBLIC MemoryUsage
+{
+    size_t objects;   ///< The objects themselves and their entries in the registry.
+    size_t payloads;  ///< The JSON of the objects, including encrypted fields.
+    size_t pending;   ///< The patches of local changes that weren't pushed yet.
+    size_t transport; ///< The bodies of requests in flight and the receive buffers of open connections.
+
+    /**
+     * @return The sum of all the categories.
+     */
+    size_t total() const;
+};
+
+
+
+
+/**
+ * @brief Counts the memory held by a Session or a type of object.
+ * Objects report their usage whenever it changes, so reading it is a handful of atomic loads instead of a walk over every object.
+ * @see ncpass::Session::getMemoryUsage()
+ * @see ncpass::API_Implementor::getTypeMemoryUsage()
+ * @author Reed Krantz
+ */
+class NCPASSCPP_PUBLIC MemoryAccount
+{
+  public:
+
+    /**
+     * @brief The categories of ncpass::MemoryUsage.
+     */
+    enum Category
+    {
+        OBJECTS,
+        PAYLOADS,
+        PENDING,
+        TRANSPORT
+    };
+
+
+  private:
+
+    std::array<std::atomic<size_t>, TRANSPORT + 1> _bytes; ///< The bytes held per category.
+
+
+  public:
+
+    MemoryAccount();
+
+    MemoryAccount(const MemoryAccount&) = delete;
+
+    MemoryAccount& operator=(const MemoryAccount&) = delete;
+
+    /**
+     * @brief Counts memory that was allocated.
+     * @param category What the memory is used for.
+     * @param bytes The amount of bytes.
+     */
+    void add(Category category, size_t bytes);
+
+    /**
+     * @brief Stops counting memory that was freed.
+     * @param category What the memory was used for.
+     * @param bytes The amount of bytes. Must have been added before.
+     */
+    void remove(Category category, size_t bytes);
+
+    /**
+     * @return The memory currently counted.
+     */
+    MemoryUsage get() const;
+};
+
+
+}
@@ -31,13 +31,27 @@
     #endif
 #endif
 
+#include <array>
+#include <atomic>
 #include <chrono>
 #include <condition_variable>
 #include <deque>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
 #include <mutex>
+#include <optional>
 #include <shared_mutex>
 #include <string>
+#include <vector>
 #include <API_Implementor.hpp>
+#include <CancellationToken.hpp>
+#include <ChangeNotifier.hpp>
+#include <HealthIndex.hpp>
+#include <ProfiledMutex.hpp>
+#include <StringPool.hpp>
+#include <SyncScheduler.hpp>
 #include <nlohmann/json.hpp>
 
 namespace ncpass
@@ -46,6 +60,12 @@ namespace ncpass
 
 
 
+class Folder; // forward declaration
+class Tag;    // forward declaration
+
+
+
+
 /**
  * @brief Password objects tied to the nextcloud server.
  * Changes to local Password objects will always be asynchronously synced to the server. The same is not true for changes to the remote password object. So call ncpass::Password::sync() often.
@@ -54,15 +74,67 @@ namespace ncpass
  */
 class NCPASSCPP_PUBLIC Password : public API_Implementor<Password>
 {
+  public:
+
+    /**
+     * @brief How much of a password to request from the server.
+     * Maps onto the "details" argument of the Passwords API. The API has no level below "model", so the server always sends the password, notes and customFields.
+     * @see https://git.mdns.eu/nextcloud/passwords/-/wikis/Developers/Api/Password-Api
+     */
+    enum Details
+    {
+        SUMMARY, ///< Requested as "model", then the password, notes and customFields are wiped and loaded again the first time they are accessed. Saves memory, not bandwidth.
+        MODEL,   ///< The complete model ("model").
+        TAGS,    ///< The complete model and its tags ("model+tags").
+        FULL     ///< The complete model, its folder, tags, shares and revisions ("model+folder+tags+shares+revisions").
+    };
+
+    class Snapshot; // forward declaration
+
+    /**
+     * @brief The result of Password::createMany().
+     */
+    struct CreateBatch
+    {
+        std::vector<std::shared_ptr<Password>> passwords; ///< One password per record, in the same order. Usable right away, like the password returned by Password::create().
+        std::future<std::vector<bool>>         created;   ///< Becomes ready once the pipeline is done. True for every password that was created on the server, in the same order.
+    };
+
+
   private:
 
+    constexpr const static char* strDetails[] = { "model", "model", "model+tags", "model+folder+tags+shares+revisions" }; ///< Used to get the "details" argument from Password::Details.
+    constexpr const static char* k_heavyKeys[]  = { "password", "notes", "customFields" };                                 ///< Fields that are secret or can get big. Dropped by Password::SUMMARY and by evictions.
+    constexpr const static char* k_internedKeys[] = { "username", "url", "folder", "share", "statusCode", "cseType", "cseKey" }; ///< Non secret fields that tend to repeat across passwords. These are stored in the Session's StringPool instead of Password::_json.
+    constexpr const static char* k_encryptedKeys[] = { "label", "username", "url", "password", "notes", "customFields" };     ///< Fields encrypted by client side encryption.
+    constexpr const static char* k_listedKeys[]    = { "label", "username", "url" };                                         ///< Encrypted fields shown in lists. Decrypted in bulk, the other encrypted fields are decrypted when accessed.
+    constexpr const static size_t k_createPipelineDepth = 8;                                                                 ///< The maximum amount of create requests Password::createMany() has in flight at once.
+    constexpr const static size_t k_prefetchDepth       = 8;                                                                 ///< The maximum amount of pulls Password::prefetch() has in flight at once.
+
     std::chrono::system_clock::time_point _lastSync; ///< The last time this password was synced with the server.
-    nlohmann::json _json;                            ///< The most current JSON for the password.
+    nlohmann::json _json;                            ///< The most current JSON for the password. Doesn't contain the fields in Password::k_internedKeys.
+    std::array<StringPool::Handle, std::size(k_internedKeys)> _interned; ///< The interned values of Password::k_internedKeys. nullptr if the field isn't set or isn't a string.
+    nlohmann::json _cipher;                          ///< The encrypted fields of Password::k_encryptedKeys as returned by the server. The decrypted values are stored in Password::_json once accessed.
     std::deque<nlohmann::json> _jsonPushQueue;       ///< A queue of JSON patches so that API_Implementor::_json can be reverted to earlier unpushed versions.
-
-    mutable std::shared_mutex           _memberMutex;  ///< The mutex used to lock any member variables of this instance.
-    mutable std::mutex                  _apiMutex;     ///< The mutex used to prevent 2 simultanious api calls. Never allow this to wait while you have a lock on _memberMutex or you will have a deadlock.
-    mutable std::condition_variable_any _updateConVar; ///< Used whenever the password is updated in any way.
+    std::shared_future<void> _pullFuture;            ///< The pull that is currently in flight. Invalid if there is none.
+    Details _pullDetails;                            ///< The Details requested by the pull in flight.
+    CancellationToken _pullToken;                    ///< The token of the pull in flight. Made urgent once someone who is waiting for the pull attaches to it.
+    unsigned long _pullCount;                        ///< The amount of pulls started. Used to tell if Password::_pullFuture was replaced.
+    bool _partial;                                   ///< True if the fields in Password::k_heavyKeys are missing (pulled as a Password::SUMMARY or evicted).
+    std::optional<Details> _missedPull;              ///< The details of the pulls that failed because the Session was offline. Pulled again once it's back online.
+    std::string _indexedFolder;                      ///< The ID of the folder this password is filed under in the Session's RelationIndex.
+    std::vector<std::string> _indexedTags;           ///< The IDs of the tags this password is filed under in the Session's RelationIndex.
+    HealthIndex::Entry _indexedHealth;               ///< What this password is filed under in the Session's HealthIndex.
+    std::string _journalKey;                         ///< The key of this password in the Session's Journal until the server gives it an ID.
+    std::shared_ptr<const Snapshot> _snapshot;       ///< The latest published state of the password. Only ever accessed with std::atomic_load() and std::atomic_store().
+
+    mutable std::atomic<std::chrono::steady_clock::time_point> _lastAccess; ///< The last time a field of this password was read or written. Used to find cold passwords.
+    std::atomic<bool> _decryptionFailed;                                    ///< True if a field of the last decryption couldn't be decrypted.
+    std::atomic<bool> _syncFailed;                                          ///< True if the last create or push of this password failed.
+
+    mutable ProfiledMutex<std::shared_mutex> _memberMutex;  ///< The mutex used to lock any member variables of this instance.
+    mutable ProfiledMutex<std::mutex>        _apiMutex;     ///< The mutex used to prevent 2 simultanious api calls. Never allow this to wait while you have a lock on _memberMutex or you will have a deadlock.
+    mutable std::condition_variable_any      _updateConVar; ///< Used whenever the password is updated in any way.
 
     /**
      * @brief Used to register a change to the JSON.
@@ -71,6 +143,253 @@ class NCPASSCPP_PUBLIC Password : public API_Implementor<Password>
      */
     void setJsonPatch(nlohmann::json patch);
 
+    /**
+     * @brief Changes fields locally, pushes them and notifies the observers.
+     * @param patch The JSON to be merged. (example: { "label": "Penguins" })
+     */
+    void setFields(const nlohmann::json& patch);
+
+    /**
+     * @brief Hands a change of this password to the observers of the Session. Must be called without Password::_memberMutex locked.
+     * @param oldRevision The revision before the change.
+     * @param newRevision The revision after the change.
+     * @param fields The keys of the fields that changed.
+     * @param origin Where the change came from.
+     */
+    void notifyChange(const std::string& oldRevision, const std::string& newRevision, std::vector<std::string> fields, ChangeEvent::Origin origin);
+
+    /**
+     * @brief Marks the pending changes of this password as failed and hands a ChangeEvent::FAILED change to the observers of the Session.
+     * Must be called without Password::_memberMutex and Password::_apiMutex locked.
+     */
+    void syncFailed();
+
+    /**
+     * @param patch An undo patch from Password::_jsonPushQueue.
+     * @return The keys of the fields the patch touches.
+     */
+    static std::vector<std::string> patchFields(const nlohmann::json& patch);
+
+    /**
+     * @return The key of this password in the Session's Journal. Must be called with Password::_memberMutex locked.
+     */
+    std::string getJournalKey() const;
+
+    /**
+     * @return A copy of Password::_json with the interned fields merged back in.
+     */
+    nlohmann::json materialize() const;
+
+    /**
+     * @brief Replaces Password::_json and moves the fields in Password::k_internedKeys to the Session's StringPool.
+     * @param json The complete JSON for the password.
+     */
+    void store(nlohmann::json json);
+
+    /**
+     * @brief Publishes the current state of the password as a new Password::Snapshot.
+     * Must be called with Password::_memberMutex locked whenever Password::_json or Password::_interned change.
+     */
+    void publish();
+
+    /**
+     * @brief Reports the memory held by the JSON and the pending patches of this password to its Session.
+     * Must be called with Password::_memberMutex locked whenever they change.
+     */
+    void updateMemoryUsage() const;
+
+    /**
+     * @brief Files this password under its current folder and tags in the Session's RelationIndex.
+     * Does nothing while the password is still being constructed. Must be called with Password::_memberMutex locked.
+     */
+    void updateRelations();
+
+    /**
+     * @brief Files this password under its current hash, edit time and status in the Session's HealthIndex.
+     * Does nothing while the password is still being constructed. Must be called with Password::_memberMutex locked.
+     */
+    void updateHealth();
+
+    /**
+     * @param key One of Password::k_internedKeys.
+     * @return The interned value of the field. nullptr if key isn't interned or the field isn't set. Must be called with Password::_memberMutex locked.
+     */
+    StringPool::Handle getInternedHandle(const std::string& key) const;
+
+    /**
+     * @param key The key of the field (example: "label").
+     * @return True if the field is available.
+     */
+    bool hasField(const std::string& key) const;
+
+    /**
+     * @brief Waits for a field to become available.
+     * If the password was fetched lazily or evicted this starts the pull.
+     * @param lock A lock on Password::_memberMutex.
+     * @param key The key of the field (example: "label").
+     * @return True if the field is available, false if the pull for it failed.
+     */
+    bool waitForField(std::shared_lock<ProfiledMutex<std::shared_mutex>>& lock, const std::string& key) const;
+
+    /**
+     * @brief Pulls data from the server on the current thread.
+     * Only ever called by the one thread started from Password::pull().
+     * @param details How much of the password to request.
+     * @param priority The lane the request waits in when the Session's request limit is reached.
+     * @param token Aborts the request once cancelled.
+     * @throw std::runtime_error If the Session is offline. The pull is repeated by Password::pullMissed() once the Session is back online.
+     * @throw std::runtime_error If the request failed, was cancelled or didn't return the password.
+     */
+    void pullBlocking(Details details, RequestLimiter::Priority priority, const CancellationToken& token);
+
+    /**
+     * @brief Creates a new password on the server on the current thread.
+     * Must be called with the Session online. Holds Password::_apiMutex for the request, then pulls the fields the server fills in within the same lane.
+     * The password stays in the journal if this fails. Does nothing if the password was already created.
+     * @param priority The lane the request waits in when the Session's request limit is reached.
+     * @param token Aborts the request once cancelled.
+     * @return True if the password was created.
+     */
+    bool createBlocking(RequestLimiter::Priority priority, const CancellationToken& token);
+
+    /**
+     * @brief Merges JSON from the server into this password.
+     * Values with pending changes are kept. Must be called with Password::_memberMutex locked.
+     * Waiters are only woken up if something changed.
+     * @param json_new The password JSON returned by the server.
+     * @param details The Details json_new was requested with.
+     * @return The keys of the fields that changed.
+     */
+    std::vector<std::string> merge(nlohmann::json json_new, Details details);
+
+    /**
+     * @brief Securely wipes and drops the fields in Password::k_heavyKeys.
+     * Must be called with Password::_memberMutex locked.
+     * @return The amount of bytes freed.
+     */
+    size_t dropHeavyFields();
+
+    /**
+     * @param key The key of the field (example: "label").
+     * @return True if the field is only available encrypted. Must be called with Password::_memberMutex locked.
+     */
+    bool isEncrypted(const std::string& key) const;
+
+    /**
+     * @brief Decrypts fields that are only available encrypted. Waits while the Session is being unlocked, fails while it's locked.
+     * Must be called without Password::_memberMutex locked. The decryption itself is done without holding the lock.
+     * @param keys The keys of the fields to decrypt.
+     * @param token Stops waiting for the Session to be unlocked once cancelled, the fields stay encrypted then.
+     */
+    void decryptFields(const std::vector<std::string>& keys, const CancellationToken& token = CancellationToken());
+
+    /**
+     * @brief Encrypts the fields of a password before it's sent to the server. Does nothing for passwords without client side encryption.
+     * @param json The complete JSON for the password with all fields decrypted.
+     * @param token Stops waiting for the Session to be unlocked once cancelled.
+     * @return False if the Session's keychain is locked or the token was cancelled, the JSON must not be sent then.
+     */
+    bool encryptFields(nlohmann::json& json, const CancellationToken& token = CancellationToken()) const;
+
+    /**
+     * @brief Decrypts the fields of Password::k_listedKeys of many passwords in parallel batches across all cores.
+     * @param passwords The passwords to decrypt.
+     */
+    static void decryptBatch(const std::vector<std::shared_ptr<Password>>& passwords);
+
+    /**
+     * @brief Pushes all the passwords of a Session that have pending changes. Called when the Session comes back online.
+     * @param session The Session whose passwords should be pushed.
+     * @param token Stops the pushes once cancelled.
+     */
+    static void pushPending(const Session& session, const CancellationToken& token = CancellationToken());
+
+    /**
+     * @brief Repeats the pulls that failed while a Session was offline. Called when the Session comes back online.
+     * @param session The Session whose passwords should be pulled.
+     */
+    static void pullMissed(const Session& session);
+
+    /**
+     * @brief Applies the pending changes of a Session's Journal and pushes them.
+     * @param session The Session the journal belongs to.
+     * @param pending Maps the journal keys of passwords to their pending changes.
+     * @see ncpass::Journal::open()
+     */
+    static void replay(const std::shared_ptr<Session>& session, const std::map<std::string, nlohmann::json>& pending);
+
+    /**
+     * @brief Gets a field and waits for it if it isn't available yet.
+     * @param key The key of the field (example: "label").
+     * @return The value of the field. An empty string if it couldn't be pulled or decrypted, see Password::hasDecryptionFailed().
+     * @see Password::waitForField()
+     */
+    nlohmann::json getField(const std::string& key) const;
+
+    /**
+     * @brief Gets a snapshot with all fields available and decrypted, pulling and decrypting them if needed.
+     * Fields that were only decrypted for this are dropped again and the password is evicted again if it was only pulled for this,
+     * so reading many passwords this way doesn't keep their secrets in memory.
+     * @param token Stops the pull and the decryption once cancelled, the snapshot may be incomplete then.
+     * @return The snapshot of the password.
+     */
+    std::shared_ptr<const Snapshot> getCompleteSnapshot(const CancellationToken& token = CancellationToken());
+
+    /**
+     * @brief Securely wipes and drops the fields in Password::k_heavyKeys to free memory.
+     * Nothing is dropped while there are pending changes or a pull in flight.
+     * @return The amount of bytes freed.
+     */
+    size_t evict();
+
+    /**
+     * @brief Takes the password out of the registry and the Session's indexes, so it's freed once the last shared_ptr to it is dropped.
+     * Used for passwords nobody asked for (example: the passwords created by Vault::importPasswords()). They are fetched again like any other password.
+     * Nothing is released while there are pending changes or a pull in flight.
+     * @return True if the password was released.
+     */
+    bool release();
+
+    /**
+     * @brief Evicts the least recently used passwords of a Session until they fit within its memory budget.
+     * @param session The Session whose passwords should be checked.
+     * @see ncpass::Session::setMemoryBudget()
+     */
+    static void enforceMemoryBudget(const Session& session);
+
+    /**
+     * @brief Schedules Password::enforceMemoryBudget() on a background thread.
+     * Calls made while a pass is already scheduled are merged into that pass.
+     * @param session The Session whose passwords should be checked.
+     */
+    static void scheduleEviction(const Session& session);
+
+    /**
+     * @brief Pulls a batch of the most outdated passwords of a Session. Called by the SyncScheduler on every tick of the Session.
+     * Passwords that were touched within SyncScheduler::Settings::hotWindow are outdated after SyncScheduler::Settings::hotInterval, the rest after interval.
+     * Passwords that were never pulled are left alone, they are pulled once they're accessed.
+     * @param session The Session whose passwords should be refreshed.
+     * @param settings How the Session is kept fresh.
+     * @param interval The current interval of the Session.
+     * @param since The time of the previous tick.
+     * @param active Set to true if any of the passwords were touched since the previous tick.
+     * @return The time until the next password is outdated. 0 if there are outdated passwords left.
+     */
+    static std::chrono::steady_clock::duration refresh(const std::shared_ptr<Session>& session, const SyncScheduler::Settings& settings, std::chrono::seconds interval,
+                                                       std::chrono::steady_clock::time_point since, bool& active);
+
+    /**
+     * @brief Registers every password of a list response through the normal dedup path and merges it.
+     * @param session The Session the list belongs to.
+     * @param json_list A JSON array of passwords returned by the server.
+     * @param details How much of the passwords was requested.
+     * @param onFound Called with each password as soon as it's merged. May be empty.
+     * @return All the passwords of the list.
+     * @throw std::runtime_error If the list request failed.
+     */
+    static std::vector<std::shared_ptr<Password>> mergeList(const std::shared_ptr<Session>& session, nlohmann::json& json_list, Details details,
+                                                            const std::function<void(const std::shared_ptr<Password>&)>& onFound);
+
 
   protected:
 
@@ -78,58 +397,129 @@ class NCPASSCPP_PUBLIC Password : public API_Implementor<Password>
      * @brief Creates a new password or links to an existing remote password.
      * @param session An active Nextcloud session.
      * @param password_json A JSON object containing "id" to link with an existing password or "label" and "password" to create a new one.
+     * @param token Stops creating a new password once cancelled. The password stays pending in the journal.
+     * @param deferCreate If true a new password isn't created on the server. The caller has to call Password::createBlocking() instead.
      * @see ncpass::Session
      */
-    Password(const std::shared_ptr<Session>& session, const nlohmann::json& password_json);
+    Password(const std::shared_ptr<Session>& session, const nlohmann::json& password_json, const CancellationToken& token = CancellationToken(),
+             bool deferCreate = false);
 
     /**
      * @brief Pulls data from the server.
+     * Only one pull per Password is ever in flight. Calling this while a pull is in flight attaches to that pull instead of starting a new one.
+     * If the pull in flight requests less details a new pull is queued behind it.
+     * @param details How much of the password to request.
+     * @param priority The lane the request waits in when the Session's request limit is reached.
+     * @param token Aborts the pull once cancelled. A pull that attaches to the pull in flight shares its token.
+     *              An interactive pull that attaches to or queues behind a pull in a lower lane makes that pull urgent, so it moves up to the interactive lane.
+     * @return A future that becomes ready when the pull in flight completes. Holds the exception of Password::pullBlocking() if the pull failed.
      */
-    void pull();
+    std::shared_future<void> pull(Details details = MODEL, RequestLimiter::Priority priority = RequestLimiter::NORMAL, const CancellationToken& token = CancellationToken());
 
     /**
      * @brief Pushes data to the server. This only updates the server's data if the local data is a newer version.
+     * @param token Aborts the push once cancelled. The changes stay queued so they can be pushed again later.
      */
-    void push();
+    void push(const CancellationToken& token = CancellationToken());
 
 
   public:
 
     /**
      * @brief Pulls/pushes the most recent data from/to the server.
+     * A password that couldn't be created yet (example: one of Vault::ImportResult::pending) is created instead.
+     * To keep all passwords fresh use ncpass::Session::setAutoSync() instead of calling this periodically.
+     * @param token Aborts the pull and push once cancelled.
      */
-    void sync();
+    void sync(const CancellationToken& token = CancellationToken());
 
     /**
      * @brief Blocks the thread and waits for all pending changes to be pushed and any current API call to be completed.
+     * @param token Stops waiting once cancelled (example: CancellationToken::after() to wait with a timeout).
+     * @return True if all pending changes were pushed, false if the token was cancelled first.
      */
-    void wait();
+    bool wait(const CancellationToken& token = CancellationToken());
 
     /**
      * @brief Creates a new password.
      * @param session A shared_ptr to a ncpass::Session instance. Used as credentials for the Nextcloud server's API.
      * @param label The label of the Password that you're creating.
      * @param password The password of the Password you're creating.
+     * @param token Aborts creating the password on the server once cancelled.
      * @return A shared_ptr to the ncpass::Password instance.
      * @see ncpass::Session
      */
-    static std::shared_ptr<Password> create(const std::shared_ptr<Session>& session, const std::string& label, const std::string& password);
+    static std::shared_ptr<Password> create(const std::shared_ptr<Session>& session, const std::string& label, const std::string& password,
+                                            const CancellationToken& token = CancellationToken());
+
+    /**
+     * @brief Creates many new passwords at once (example: importing from another password manager).
+     * The passwords are hashed in parallel across all cores, then created on the server by a pipeline that keeps at most Password::k_createPipelineDepth requests in flight.
+     * The requests wait in the RequestLimiter::BULK lane so they don't hold up interactive requests.
+     * @param session A shared_ptr to a ncpass::Session instance. Used as credentials for the Nextcloud server's API.
+     * @param records A JSON object per password. Each needs a "label" and a "password", other fields (example: "username", "url" or "notes") are optional.
+     * @param token Stops the pipeline once cancelled. Passwords that weren't created stay pending in the journal.
+     * @return The passwords and a future for the outcome of each of them.
+     * @see ncpass::Password::create()
+     */
+    static CreateBatch createMany(const std::shared_ptr<Session>& session, const std::vector<nlohmann::json>& records, const CancellationToken& token = CancellationToken());
 
     /**
      * @brief Fetches a Password from the server based on the given ID.
      * @param session A shared_ptr to a ncpass::Session instance. Used as credentials for the Nextcloud server's API.
      * @param id The ID of an existing password on the nextcloud server.
+     * @param lazy If true the password isn't pulled until one of its fields is accessed.
+     * @param details How much of the password to request.
+     * @param token Aborts the pull once cancelled. Getters waiting for the aborted pull return empty values.
      * @return A shared_ptr to the ncpass::Password instance of the given ID.
      * @see ncpass::Session
      */
-    static std::shared_ptr<Password> fetch(const std::shared_ptr<Session>& session, const std::string& id);
+    static std::shared_ptr<Password> fetch(const std::shared_ptr<Session>& session, const std::string& id, bool lazy = false, Details details = MODEL,
+                                           const CancellationToken& token = CancellationToken());
+
+    /**
+     * @brief Hints that the given passwords will probably be needed soon.
+     * The API can't show several passwords by ID in one request ("find" only matches a single value per field), so each password is pulled on its own
+     * in the ncpass::RequestLimiter::BULK lane, keeping at most Password::k_prefetchDepth pulls in flight so they don't flood the server.
+     * Passwords that are already populated or being pulled are skipped.
+     * @param session A shared_ptr to a ncpass::Session instance. Used as credentials for the Nextcloud server's API.
+     * @param ids The IDs of existing passwords on the nextcloud server.
+     * @see ncpass::Password::fetch()
+     */
+    static void prefetch(const std::shared_ptr<Session>& session, const std::vector<std::string>& ids);
 
     /**
      * @brief Gets all the passwords from the given Nextcloud server session asynchronously.
+     * This is a single request, so it is much cheaper than fetching the passwords one by one.
      * @param session A shared_ptr to a ncpass::Session instance. Used as credentials for the Nextcloud server's API.
+     * @param details How much of the passwords to request. Password::SUMMARY keeps the secrets out of memory until they are accessed, the list itself is as big as with Password::MODEL.
+     * @return A future for all the passwords of the session. Holds a std::runtime_error if the passwords couldn't be listed.
      * @see ncpass::Session
      */
-    static void fetchAll(const std::shared_ptr<Session>& session);
+    static std::future<std::vector<std::shared_ptr<Password>>> fetchAll(const std::shared_ptr<Session>& session, Details details = SUMMARY);
+
+    /**
+     * @brief Finds passwords matching the given criteria on the server asynchronously.
+     * The filtering is done by the server so only the matching passwords are downloaded.
+     * Matches are registered like any other fetched password, so passwords that are already active are updated instead of duplicated.
+     * @param session A shared_ptr to a ncpass::Session instance. Used as credentials for the Nextcloud server's API.
+     * @param criteria A JSON object of fields and the values they must have, e.g. {"favorite": true}. See the "password/find" action of the Passwords API.
+     * @param onFound Called on a background thread with each match as soon as it's merged. May be empty.
+     * @param details How much of the passwords to request. Password::SUMMARY keeps the secrets out of memory until they are accessed, the list itself is as big as with Password::MODEL.
+     * @return A future for all the matching passwords. Holds a std::runtime_error if the request failed.
+     * @see ncpass::Session
+     */
+    static std::future<std::vector<std::shared_ptr<Password>>> find(const std::shared_ptr<Session>& session, const nlohmann::json& criteria,
+                                                                     const std::function<void(const std::shared_ptr<Password>&)>& onFound = nullptr,
+                                                                     Details details = SUMMARY);
+
+    /**
+     * @brief Decrypts the label, username and url of all fetched passwords of a Session in parallel.
+     * Called by ncpass::Session::unlock(). Passwords fetched while the Session is unlocked are decrypted the same way as they arrive.
+     * @param session The Session whose passwords should be decrypted.
+     * @return A future that becomes ready when all the passwords are decrypted.
+     */
+    static std::future<void> decryptAll(const std::shared_ptr<Session>& session);
 
     /**
      * @brief Gets all of the active instances of the Password class.
@@ -138,11 +528,85 @@ class NCPASSCPP_PUBLIC Password : public API_Implementor<Password>
      */
     static std::vector<std::shared_ptr<Password>> getAll();
 
+    /**
+     * @brief Gets the memory held by all passwords across every Session. This is a local only action.
+     * @return The memory usage of the passwords.
+     * @see ncpass::Session::getMemoryUsage()
+     */
+    static MemoryUsage getMemoryUsage();
+
+    /**
+     * @brief Observes the changes to this password, from local edits as well as pulls and pushes.
+     * @param callback Called with every change.
+     * @param executor Runs the callback (example: posts it to a UI event loop). If empty the callback is called on the thread that made the change.
+     * @return The ID of the subscription.
+     * @see ncpass::Session::subscribe()
+     */
+    ChangeNotifier::SubscriptionID subscribe(ChangeNotifier::Callback callback, ChangeNotifier::Executor executor = nullptr);
+
+    /**
+     * @brief Observes the changes to one field of this password.
+     * @param field The key of the field (example: "label").
+     * @param callback Called with every change to the field.
+     * @param executor Runs the callback. If empty the callback is called on the thread that made the change.
+     * @return The ID of the subscription.
+     */
+    ChangeNotifier::SubscriptionID subscribe(const std::string& field, ChangeNotifier::Callback callback, ChangeNotifier::Executor executor = nullptr);
+
+    /**
+     * @brief Stops an observer.
+     * @param id The ID returned by Password::subscribe().
+     */
+    void unsubscribe(ChangeNotifier::SubscriptionID id);
+
+    /**
+     * @brief Gets the latest state of the password with a single atomic load, without locking or waiting.
+     * All the fields of a snapshot belong to the same version of the password, so they never mix the values from before and after a pull or a local change.
+     * Fields that aren't available locally (not pulled yet, evicted or not decrypted yet) are missing from the snapshot. The regular getters wait for those.
+     * Counts as using the password, so it's kept in memory longer than the passwords that weren't read.
+     * @return An immutable snapshot of the password. Never nullptr.
+     */
+    std::shared_ptr<const Snapshot> getSnapshot() const;
+
     /**
      * @return The UUID of the password.
      */
     std::string getID() const;
 
+    /**
+     * @return True if a field couldn't be decrypted the last time encrypted fields were accessed (example: the Session is locked or the key isn't in its keychain).
+     * Its getter returned an empty string, the field stays encrypted and is decrypted again the next time it's accessed.
+     */
+    bool hasDecryptionFailed() const;
+
+    /**
+     * @return True if the last attempt to create the password or push its changes failed (example: the server rejected it or the Session went offline).
+     * The changes stay pending. Password::sync() tries again, the changes of passwords that were created are also pushed again once the Session is back online.
+     * @see ncpass::ChangeEvent::FAILED
+     */
+    bool hasSyncFailed() const;
+
+    /**
+     * @brief Gets the interned value of a non secret field.
+     * Passwords of the same Session with equal values share the same handle so they can be grouped or filtered by comparing pointers.
+     * @param key One of "username", "url", "folder", "share", "statusCode", "cseType" or "cseKey".
+     * @return The handle of the field's value. nullptr if key isn't one of the above, the value isn't a string or the field couldn't be pulled.
+     */
+    StringPool::Handle getInternedField(const std::string& key) const;
+
+    /**
+     * @return The folder this password is in. nullptr if the folder wasn't fetched.
+     * @see ncpass::Folder::fetchAll()
+     */
+    std::shared_ptr<Folder> getFolder() const;
+
+    /**
+     * @brief Pulls the password with Password::TAGS first if its tags weren't pulled yet.
+     * @return The fetched tags of this password. Empty if its tags couldn't be pulled.
+     * @see ncpass::Tag::fetchAll()
+     */
+    std::vector<std::shared_ptr<Tag>> getTags() const;
+
     /**
      * @return User defined label of the password.
      */
@@ -175,6 +639,113 @@ class NCPASSCPP_PUBLIC Password : public API_Implementor<Password>
      * @param password The actual password.
      */
     void setPassword(const std::string& password);
+
+    /**
+     * @return The notes of the password.
+     */
+    std::string getNotes() const;
+
+    /**
+     * @brief Set the passwords notes asynchronously.
+     * @param notes The notes of the password.
+     */
+    void setNotes(const std::string& notes);
+
+    friend class Session;
+    friend class SyncScheduler;
+    friend class BreachAudit;
+    friend class Vault;
+};
+
+
+
+
+/**
+ * @brief An immutable version of a Password.
+ * Snapshots are published by the password every time it changes and share the interned values with it. The secret fields are wiped once the last reference is dropped.
+ * @see Password::getSnapshot()
+ */
+class NCPASSCPP_PUBLIC Password::Snapshot
+{
+  private:
+
+    nlohmann::json _json; ///< A copy of Password::_json at the time the snapshot was published.
+    std::array<StringPool::Handle, std::size(Password::k_internedKeys)> _interned; ///< The interned values of Password::k_internedKeys at the time the snapshot was published.
+
+    /**
+     * @param json A copy of Password::_json.
+     * @param interned The interned values of the password.
+     */
+    Snapshot(nlohmann::json json, const std::array<StringPool::Handle, std::size(Password::k_internedKeys)>& interned);
+
+
+  public:
+
+    Snapshot(const Snapshot&)            = delete;
+    Snapshot& operator=(const Snapshot&) = delete;
+
+    ~Snapshot();
+
+    /**
+     * @param key The key of the field (example: "label").
+     * @return True if the field is in the snapshot.
+     */
+    bool hasField(const std::string& key) const;
+
+    /**
+     * @param key The key of the field (example: "label").
+     * @return The value of the field. An empty string if the field isn't in the snapshot.
+     */
+    nlohmann::json getField(const std::string& key) const;
+
+    /**
+     * @param key One of "username", "url", "folder", "share", "statusCode", "cseType" or "cseKey".
+     * @return The handle of the field's value. nullptr if key isn't one of the above or the field isn't in the snapshot.
+     * @see Password::getInternedField()
+     */
+    StringPool::Handle getInternedField(const std::string& key) const;
+
+    /**
+     * @return The UUID of the password. Empty if the password wasn't created on the server yet.
+     */
+    std::string getID() const;
+
+    /**
+     * @return The revision of the password on the server. Empty if the password wasn't pulled or created yet.
+     */
+    std::string getRevision() const;
+
+    /**
+     * @return User defined label of the password.
+     */
+    std::string getLabel() const;
+
+    /**
+     * @return Username associated with the password.
+     */
+    std::string getUsername() const;
+
+    /**
+     * @return The url of the password.
+     */
+    std::string getUrl() const;
+
+    /**
+     * @return The actual password.
+     */
+    std::string getPassword() const;
+
+    /**
+     * @return The notes of the password.
+     */
+    std::string getNotes() const;
+
+    /**
+     * @return All the fields of the snapshot as one JSON object.
+     */
+    nlohmann::json toJson() const;
+
+    friend class Password;
 };
 
 
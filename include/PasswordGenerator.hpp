@@ -0,0 +1,168 @@
+/*
+ * ncpasscpp. A library that implements Nextcloud Password's API.
+ * Copyright (C) 2021  Reed Krantz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#if defined _WIN32 || defined __CYGWIN__
+    #ifdef BUILDING_NCPASSCPP
+        #define NCPASSCPP_PUBLIC __declspec(dllexport)
+    #else
+        #define NCPASSCPP_PUBLIC __declspec(dllimport)
+    #endif
+#else
+    #ifdef BUILDING_NCPASSCPP
+        #define NCPASSCPP_PUBLIC __attribute__ ((visibility("default")))
+    #else
+        #define NCPASSCPP_PUBLIC
+    #endif
+#endif
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <CancellationToken.hpp>
+#include <RequestLimiter.hpp>
+
+namespace ncpass
+{
+
+
+
+
+/**
+ * @brief Keeps pools of passwords generated by the password service of the server, so a new password is ready the moment a user asks for one.
+ * There is one pool per PasswordGenerator::Settings. A background thread refills the pools as passwords are taken.
+ * The pooled passwords are kept in memory allocated by libsodium and wiped once they are taken or the pool is dropped.
+ * @see https://git.mdns.eu/nextcloud/passwords/-/wikis/Developers/Api/Service-Api
+ * @author Reed Krantz
+ */
+class NCPASSCPP_PUBLIC PasswordGenerator
+{
+  public:
+
+    /**
+     * @brief How passwords are generated. Maps onto the arguments of the "service/password" action.
+     */
+    struct Settings
+    {
+        int  strength = 1;     ///< The strength of the password from 0 (weakest) to 4 (strongest).
+        bool numbers  = false; ///< True to include numbers.
+        bool special  = false; ///< True to include special characters.
+
+        /**
+         * @brief Orders settings so they can be used as the key of a pool.
+         */
+        bool operator<(const Settings& other) const;
+    };
+
+    /**
+     * @brief Generates one password on the server. Blocks until it's generated.
+     * Returns nothing if the password couldn't be generated.
+     */
+    typedef std::function<std::optional<std::string>(const Settings& settings, RequestLimiter::Priority priority, const CancellationToken& token)> Source;
+
+    constexpr const static size_t k_defaultPoolSize = 4; ///< The size of a pool created by the first PasswordGenerator::generate() for its settings.
+
+
+  private:
+
+    constexpr const static std::chrono::seconds k_retryDelay = std::chrono::seconds(10); ///< How long refilling pauses after the server failed to generate a password.
+
+    typedef std::unique_ptr<char, void (*)(void*)> SecureString; ///< A null terminated password in memory allocated with sodium_malloc().
+
+    /**
+     * @brief The passwords generated ahead of time for one Settings.
+     */
+    struct Pool
+    {
+        std::deque<SecureString> passwords; ///< The passwords ready to be taken, oldest first.
+        size_t                   size;      ///< The amount of passwords the pool is refilled to.
+    };
+
+    const Source             _source;    ///< Generates the passwords.
+    std::map<Settings, Pool> _pools;     ///< The pools by their settings.
+    bool                     _stop;      ///< Tells the refill thread to stop.
+    CancellationToken        _stopToken; ///< Cancelled once the generator stops so a request of the refill thread doesn't hold it up.
+    std::thread              _refiller;  ///< Refills the pools. Started once the first pool is created.
+
+    mutable std::mutex      _mutex;        ///< Mutex used for locking access to all member variables.
+    std::condition_variable _refillConVar; ///< Used whenever a password is taken, a pool changes or the generator stops.
+
+    /**
+     * @brief Copies a password into memory allocated with sodium_malloc().
+     * @param password The password.
+     * @return The copy. nullptr if no secure memory could be allocated.
+     */
+    static SecureString secure(const std::string& password);
+
+    /**
+     * @brief Starts the refill thread if it isn't running yet. Must be called with PasswordGenerator::_mutex locked.
+     */
+    void start();
+
+    /**
+     * @brief Refills the pools until the generator stops. Runs on the refill thread.
+     */
+    void refill();
+
+
+  public:
+
+    /**
+     * @param source Generates the passwords (example: a request to the "service/password" action of a Session).
+     * @throw std::runtime_error If libsodium couldn't be initialized.
+     */
+    explicit PasswordGenerator(Source source);
+
+    /**
+     * @brief Stops the refill thread and wipes the pools.
+     */
+    ~PasswordGenerator();
+
+    /**
+     * @brief Sets how many passwords are kept ready for the given settings.
+     * @param settings How the passwords are generated.
+     * @param size The amount of passwords to keep ready. 0 wipes and drops the pool.
+     */
+    void setPoolSize(const Settings& settings, size_t size);
+
+    /**
+     * @brief Takes a password from the pool of the given settings.
+     * Returns right away unless the pool ran dry, then the password is generated on the server while the pool is refilled in the background.
+     * The first call for a settings creates a pool of PasswordGenerator::k_defaultPoolSize passwords for them.
+     * @param settings How the password is generated.
+     * @param token Aborts generating the password on the server once cancelled.
+     * @return The password. Nothing if the pool was empty and the server couldn't generate a password.
+     */
+    std::optional<std::string> generate(const Settings& settings, const CancellationToken& token = CancellationToken());
+
+    /**
+     * @brief Stops the refill thread and wipes the pools. Aborts the request of the refill thread if it has one in flight.
+     * Passwords can still be generated afterwards, but only on the server one at a time.
+     */
+    void stop();
+};
+
+
+}
@@ -0,0 +1,276 @@
+/*
+ * ncpasscpp. A library that implements Nextcloud Password's API.
+ * Copyright (C) 2021  Reed Krantz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#if defined _WIN32 || defined __CYGWIN__
+    #ifdef BUILDING_NCPASSCPP
+        #define NCPASSCPP_PUBLIC __declspec(dllexport)
+    #else
+        #define NCPASSCPP_PUBLIC __declspec(dllimport)
+    #endif
+#else
+    #ifdef BUILDING_NCPASSCPP
+        #define NCPASSCPP_PUBLIC __attribute__ ((visibility("default")))
+    #else
+        #define NCPASSCPP_PUBLIC
+    #endif
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ncpass
+{
+
+
+
+
+/**
+ * @brief Collects how long the profiled mutexes of the library are waited for and held.
+ * Only collects anything if the library was built with NCPASSCPP_LOCK_STATS (meson option lock_stats). Otherwise ncpass::ProfiledMutex is a plain mutex.
+ * Mutexes with the same name share their counters (example: the member mutexes of all passwords).
+ * @see ncpass::ProfiledMutex
+ * @author Reed Krantz
+ */
+class NCPASSCPP_PUBLIC LockProfiler
+{
+  public:
+
+    /**
+     * @brief The counters of all the mutexes with one name. All times are in nanoseconds.
+     */
+    struct Counters
+    {
+        std::atomic<uint64_t> acquisitions; ///< How often the mutexes were locked.
+        std::atomic<uint64_t> contentions;  ///< How often a lock had to wait because the mutex was already locked.
+        std::atomic<uint64_t> totalWait;    ///< The time spent waiting for the mutexes.
+        std::atomic<uint64_t> maxWait;      ///< The longest wait for one of the mutexes.
+        std::atomic<uint64_t> totalHold;    ///< The time the mutexes were held.
+        std::atomic<uint64_t> maxHold;      ///< The longest time one of the mutexes was held.
+    };
+
+    /**
+     * @brief A snapshot of Counters.
+     */
+    struct Stats
+    {
+        std::string              name;         ///< The name of the mutexes (example: "Password::_memberMutex").
+        uint64_t                 acquisitions; ///< How often the mutexes were locked.
+        uint64_t                 contentions;  ///< How often a lock had to wait because the mutex was already locked.
+        std::chrono::nanoseconds totalWait;    ///< The time spent waiting for the mutexes.
+        std::chrono::nanoseconds maxWait;      ///< The longest wait for one of the mutexes.
+        std::chrono::nanoseconds totalHold;    ///< The time the mutexes were held.
+        std::chrono::nanoseconds maxHold;      ///< The longest time one of the mutexes was held.
+    };
+
+    /**
+     * @return True if the library was built with NCPASSCPP_LOCK_STATS.
+     */
+    static bool isEnabled();
+
+    /**
+     * @brief Gets the counters of a name, creating them if they don't exist yet.
+     * @param name The name of the mutexes.
+     * @return The counters. They are never destroyed.
+     */
+    static Counters& get(const std::string& name);
+
+    /**
+     * @brief Adds a measured time to a total and raises the maximum if it's longer.
+     * @param total The total to add the time to.
+     * @param max The maximum.
+     * @param time The measured time.
+     */
+    static void record(std::atomic<uint64_t>& total, std::atomic<uint64_t>& max, std::chrono::steady_clock::duration time);
+
+    /**
+     * @return A snapshot of the counters of every name, sorted by name.
+     */
+    static std::vector<Stats> getStats();
+
+    /**
+     * @brief Sets all counters back to 0 (example: after warming up a benchmark).
+     */
+    static void reset();
+};
+
+
+
+
+#ifdef NCPASSCPP_LOCK_STATS
+/**
+ * @brief A mutex that counts how long it's waited for and held in the LockProfiler.
+ * Works with std::unique_lock, std::shared_lock and std::condition_variable_any like the mutex it wraps.
+ * @tparam Mutex The wrapped mutex (example: std::shared_mutex).
+ * @see ncpass::LockProfiler
+ * @author Reed Krantz
+ */
+template <class Mutex>
+class ProfiledMutex
+{
+  private:
+
+    Mutex                                 _mutex;    ///< The wrapped mutex.
+    LockProfiler::Counters&               _counters; ///< The counters shared by all mutexes with the name of this one.
+    std::chrono::steady_clock::time_point _lockedAt; ///< The time the exclusive lock was taken. Only touched by the holder.
+
+    /**
+     * @brief Shared locks can be held by many threads at once, so every thread keeps the times it took its own.
+     * @return The shared locks held by the calling thread and the times they were taken.
+     */
+    static std::vector<std::pair<const ProfiledMutex*, std::chrono::steady_clock::time_point>>& sharedLocks()
+    {
+        thread_local std::vector<std::pair<const ProfiledMutex*, std::chrono::steady_clock::time_point>> locks;
+
+
+        return locks;
+    }
+
+    /**
+     * @brief Counts an acquisition.
+     * @param start The time the lock was requested.
+     * @param contended True if the lock had to wait.
+     * @return The time the lock was acquired.
+     */
+    std::chrono::steady_clock::time_point acquired(std::chrono::steady_clock::time_point start, bool contended)
+    {
+        const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+
+        _counters.acquisitions++;
+
+        if( contended )
+            _counters.contentions++;
+
+        LockProfiler::record(_counters.totalWait, _counters.maxWait, now - start);
+
+        return now;
+    }
+
+
+  public:
+
+    /**
+     * @param name The name to count this mutex under (example: "Password::_memberMutex").
+     */
+    explicit ProfiledMutex(const char* name) : _counters(LockProfiler::get(name))
+    {}
+
+
+    void lock()
+    {
+        const std::chrono::steady_clock::time_point start     = std::chrono::steady_clock::now();
+        const bool                                  contended = !_mutex.try_lock();
+
+
+        if( contended )
+            _mutex.lock();
+
+        _lockedAt = acquired(start, contended);
+    }
+
+
+    bool try_lock()
+    {
+        if( !_mutex.try_lock() )
+            return false;
+
+        _lockedAt = acquired(std::chrono::steady_clock::now(), false);
+
+        return true;
+    }
+
+
+    void unlock()
+    {
+        const std::chrono::steady_clock::duration held = std::chrono::steady_clock::now() - _lockedAt;
+
+
+        _mutex.unlock();
+        LockProfiler::record(_counters.totalHold, _counters.maxHold, held);
+    }
+
+
+    void lock_shared()
+    {
+        const std::chrono::steady_clock::time_point start     = std::chrono::steady_clock::now();
+        const bool                                  contended = !_mutex.try_lock_shared();
+
+
+        if( contended )
+            _mutex.lock_shared();
+
+        sharedLocks().emplace_back(this, acquired(start, contended));
+    }
+
+
+    bool try_lock_shared()
+    {
+        if( !_mutex.try_lock_shared() )
+            return false;
+
+        sharedLocks().emplace_back(this, acquired(std::chrono::steady_clock::now(), false));
+
+        return true;
+    }
+
+
+    void unlock_shared()
+    {
+        auto& locks = sharedLocks();
+
+
+        // A shared lock released on another thread than it was taken on isn't timed.
+        for( auto itr = locks.rbegin(); itr != locks.rend(); itr++ )
+        {
+            if( itr->first == this )
+            {
+                LockProfiler::record(_counters.totalHold, _counters.maxHold, std::chrono::steady_clock::now() - itr->second);
+                locks.erase(std::next(itr).base());
+                break;
+            }
+        }
+
+        _mutex.unlock_shared();
+    }
+};
+#else
+/**
+ * @brief Without NCPASSCPP_LOCK_STATS a ProfiledMutex is the mutex it wraps.
+ * @tparam Mutex The wrapped mutex (example: std::shared_mutex).
+ */
+template <class Mutex>
+class ProfiledMutex : public Mutex
+{
+  public:
+
+    /**
+     * @param name Ignored.
+     */
+    explicit ProfiledMutex(const char*)
+    {}
+};
+#endif
+
+
+}
@@ -0,0 +1,163 @@
+/*
+ * ncpasscpp. A library that implements Nextcloud Password's API.
+ * Copyright (C) 2021  Reed Krantz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#if defined _WIN32 || defined __CYGWIN__
+    #ifdef BUILDING_NCPASSCPP
+        #define NCPASSCPP_PUBLIC __declspec(dllexport)
+    #else
+        #define NCPASSCPP_PUBLIC __declspec(dllimport)
+    #endif
+#else
+    #ifdef BUILDING_NCPASSCPP
+        #define NCPASSCPP_PUBLIC __attribute__ ((visibility("default")))
+    #else
+        #define NCPASSCPP_PUBLIC
+    #endif
+#endif
+
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace ncpass
+{
+
+
+
+
+class Folder;   // forward declaration
+class Password; // forward declaration
+class Tag;      // forward declaration
+
+
+
+
+/**
+ * @brief A local copy of the relationships between the objects of a Session.
+ * Keeps the folder tree and the tag to password index up to date as objects are pulled, so navigating them never needs a round trip.
+ * Objects are filed under IDs so relationships to objects that haven't been fetched yet are kept as well.
+ * @see ncpass::Folder
+ * @see ncpass::Tag
+ * @author Reed Krantz
+ */
+class NCPASSCPP_PUBLIC RelationIndex
+{
+  private:
+
+    template <class API_Type>
+    using Members = std::unordered_map<std::string, std::unordered_set<std::shared_ptr<API_Type>>>; ///< Maps the ID of a parent object to its members.
+
+    Members<Folder>   _folderFolders;   ///< Maps folder IDs to their child folders.
+    Members<Password> _folderPasswords; ///< Maps folder IDs to the passwords in them.
+    Members<Password> _tagPasswords;    ///< Maps tag IDs to the passwords tagged with them.
+
+    std::unordered_map<std::string, std::shared_ptr<Folder>> _folders; ///< Maps folder IDs to folders.
+    std::unordered_map<std::string, std::shared_ptr<Tag>>    _tags;    ///< Maps tag IDs to tags.
+
+    mutable std::shared_mutex _mutex; ///< Mutex used for locking access to all member variables.
+
+    /**
+     * @brief Moves an object from one parent to another.
+     * @param members The relationship to update.
+     * @param member The object to move.
+     * @param oldParent The ID of the previous parent. Empty if there was none.
+     * @param newParent The ID of the new parent. Empty if there is none.
+     */
+    template <class API_Type>
+    static void move(Members<API_Type>& members, const std::shared_ptr<API_Type>& member, const std::string& oldParent, const std::string& newParent);
+
+    /**
+     * @param members The relationship to read.
+     * @param parent The ID of the parent.
+     * @return All the members of the parent.
+     */
+    template <class API_Type>
+    static std::vector<std::shared_ptr<API_Type>> get(const Members<API_Type>& members, const std::string& parent);
+
+
+  public:
+
+    /**
+     * @brief Files a folder under its ID and its parent.
+     * @param folder The folder.
+     * @param id The ID of the folder.
+     * @param oldParent The ID of the parent the folder was filed under. Empty if it wasn't filed yet.
+     * @param newParent The ID of the parent of the folder.
+     */
+    void setFolder(const std::shared_ptr<Folder>& folder, const std::string& id, const std::string& oldParent, const std::string& newParent);
+
+    /**
+     * @brief Files a tag under its ID.
+     * @param tag The tag.
+     * @param id The ID of the tag.
+     */
+    void setTag(const std::shared_ptr<Tag>& tag, const std::string& id);
+
+    /**
+     * @brief Moves a password to another folder.
+     * @param password The password.
+     * @param oldFolder The ID of the folder the password was filed under. Empty if it wasn't filed yet.
+     * @param newFolder The ID of the folder of the password.
+     */
+    void setPasswordFolder(const std::shared_ptr<Password>& password, const std::string& oldFolder, const std::string& newFolder);
+
+    /**
+     * @brief Changes the tags a password is filed under.
+     * @param password The password.
+     * @param oldTags The IDs of the tags the password was filed under.
+     * @param newTags The IDs of the tags of the password.
+     */
+    void setPasswordTags(const std::shared_ptr<Password>& password, const std::vector<std::string>& oldTags, const std::vector<std::string>& newTags);
+
+    /**
+     * @param id The ID of a folder.
+     * @return The folder or nullptr if it wasn't fetched.
+     */
+    std::shared_ptr<Folder> getFolder(const std::string& id) const;
+
+    /**
+     * @param id The ID of a tag.
+     * @return The tag or nullptr if it wasn't fetched.
+     */
+    std::shared_ptr<Tag> getTag(const std::string& id) const;
+
+    /**
+     * @param id The ID of a folder.
+     * @return The fetched folders directly inside of the folder.
+     */
+    std::vector<std::shared_ptr<Folder>> getFolderFolders(const std::string& id) const;
+
+    /**
+     * @param id The ID of a folder.
+     * @return The fetched passwords directly inside of the folder.
+     */
+    std::vector<std::shared_ptr<Password>> getFolderPasswords(const std::string& id) const;
+
+    /**
+     * @param id The ID of a tag.
+     * @return The fetched passwords tagged with the tag.
+     */
+    std::vector<std::shared_ptr<Password>> getTagPasswords(const std::string& id) const;
+};
+
+
+}
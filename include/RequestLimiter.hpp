@@ -0,0 +1,184 @@
+/*
+ * ncpasscpp. A library that implements Nextcloud Password's API.
+ * Copyright (C) 2021  Reed Krantz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#if defined _WIN32 || defined __CYGWIN__
+    #ifdef BUILDING_NCPASSCPP
+        #define NCPASSCPP_PUBLIC __declspec(dllexport)
+    #else
+        #define NCPASSCPP_PUBLIC __declspec(dllimport)
+    #endif
+#else
+    #ifdef BUILDING_NCPASSCPP
+        #define NCPASSCPP_PUBLIC __attribute__ ((visibility("default")))
+    #else
+        #define NCPASSCPP_PUBLIC
+    #endif
+#endif
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <CancellationToken.hpp>
+
+namespace ncpass
+{
+
+
+
+
+/**
+ * @brief Limits the rate and concurrency of the requests sent to a Nextcloud server.
+ * Combines a token bucket (requests per second with a burst allowance) and a cap on the amount of requests in flight.
+ * Waiting requests are admitted by priority and then in the order they arrived, so a request the user is waiting for skips ahead of queued background work.
+ * Bulk requests never take the last free slot so there's always room for the next interactive request.
+ * @see ncpass::Session::setRateLimit()
+ * @see ncpass::Session::setMaxInFlight()
+ * @author Reed Krantz
+ */
+class NCPASSCPP_PUBLIC RequestLimiter
+{
+  public:
+
+    /**
+     * @brief The lanes requests are admitted from. Lower lanes are only admitted while the higher ones are empty.
+     */
+    enum Priority
+    {
+        INTERACTIVE, ///< The user is waiting for the request (example: a getter blocking on a missing field).
+        NORMAL,      ///< Regular requests (example: pushing a change).
+        BULK         ///< Background requests nobody is waiting for (example: prefetching and background syncing).
+    };
+
+
+  private:
+
+    /**
+     * @brief A request waiting to be admitted.
+     * Every waiter has its own condition variable so only the head of the queue is woken up.
+     */
+    struct Waiter
+    {
+        std::condition_variable conVar; ///< Notified when this waiter might be able to be admitted.
+    };
+
+    double   _rate;        ///< Tokens added to the bucket every second. 0 disables rate limiting.
+    double   _burst;       ///< The maximum amount of tokens the bucket can hold.
+    double   _tokens;      ///< The amount of tokens currently in the bucket.
+    unsigned _maxInFlight; ///< The maximum amount of requests in flight at once. 0 disables the cap.
+    unsigned _inFlight;    ///< The amount of requests currently in flight.
+
+    std::chrono::steady_clock::time_point _lastRefill; ///< The last time tokens were added to the bucket.
+    std::array<std::deque<Waiter*>, BULK + 1> _queues; ///< Requests waiting to be admitted in the order they arrived. One queue per Priority.
+    std::mutex _mutex;                                 ///< Mutex used for locking access to all member variables.
+
+    /**
+     * @brief Adds the tokens accumulated since the last refill to the bucket.
+     * Must be called with RequestLimiter::_mutex locked.
+     * @param now The current time.
+     */
+    void refill(std::chrono::steady_clock::time_point now);
+
+    /**
+     * @return The request that is admitted next. The oldest request of the highest non empty lane. nullptr if nobody is waiting.
+     * Must be called with RequestLimiter::_mutex locked.
+     */
+    Waiter* front() const;
+
+    /**
+     * @brief Wakes up the request at the front of the queue so it can check if it can be admitted.
+     * Must be called with RequestLimiter::_mutex locked.
+     */
+    void notifyFront();
+
+    /**
+     * @brief Marks a request as finished.
+     */
+    void release();
+
+
+  public:
+
+    /**
+     * @brief RAII handle for an admitted request.
+     * The request counts as in flight until this is released or destroyed.
+     */
+    class NCPASSCPP_PUBLIC Slot
+    {
+      private:
+
+        RequestLimiter* _limiter; ///< The limiter that admitted this request. nullptr once released.
+
+
+      public:
+
+        Slot(RequestLimiter* limiter);
+
+        Slot(Slot&& slot);
+
+        Slot(const Slot&) = delete;
+
+        Slot& operator=(const Slot&) = delete;
+
+        ~Slot();
+
+        /**
+         * @brief Marks the request as finished before the Slot is destroyed.
+         */
+        void release();
+
+        /**
+         * @return False if the request was cancelled before it was admitted.
+         */
+        explicit operator bool() const;
+    };
+
+    /**
+     * @brief Constructor for RequestLimiter.
+     * @param requestsPerSecond The sustained amount of requests per second. 0 disables rate limiting.
+     * @param burst The amount of requests that can be sent at once before the rate limit applies.
+     * @param maxInFlight The maximum amount of requests in flight at once. 0 disables the cap.
+     */
+    RequestLimiter(double requestsPerSecond, unsigned burst, unsigned maxInFlight);
+
+    /**
+     * @brief Configures the token bucket.
+     * @param requestsPerSecond The sustained amount of requests per second. 0 disables rate limiting.
+     * @param burst The amount of requests that can be sent at once before the rate limit applies.
+     */
+    void setRateLimit(double requestsPerSecond, unsigned burst);
+
+    /**
+     * @brief Configures the cap on concurrent requests.
+     * @param maxInFlight The maximum amount of requests in flight at once. 0 disables the cap.
+     */
+    void setMaxInFlight(unsigned maxInFlight);
+
+    /**
+     * @brief Blocks the thread until the request can be sent or the token is cancelled.
+     * @param priority The lane to wait in.
+     * @param token Stops waiting once cancelled. Moves the request to the RequestLimiter::INTERACTIVE lane once it's made urgent.
+     * @return A Slot that has to be kept alive for as long as the request is in flight. An empty Slot if the token was cancelled first.
+     */
+    Slot acquire(Priority priority = NORMAL, const CancellationToken& token = CancellationToken());
+};
+
+
+}
@@ -31,9 +31,30 @@
     #endif
 #endif
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <shared_mutex>
 #include <string>
 #include <API_Implementor.hpp>
+#include <CancellationToken.hpp>
+#include <ChangeNotifier.hpp>
+#include <FaviconCache.hpp>
+#include <Journal.hpp>
+#include <HealthIndex.hpp>
+#include <Keychain.hpp>
+#include <MemoryAccount.hpp>
+#include <PasswordGenerator.hpp>
+#include <RelationIndex.hpp>
+#include <RequestLimiter.hpp>
+#include <StringPool.hpp>
+#include <SyncScheduler.hpp>
+#include <curl/curl.h>
 
 
 namespace ncpass
@@ -51,11 +72,105 @@ class NCPASSCPP_PUBLIC Session : public API_Implementor<Session>
 {
   private:
 
-    const std::string         k_apiURL;      ///< Base url to the api used to connect with the server (example: https://cloud.example.com/apps/passwords/api/1.0/).
-    const std::string         k_federatedID; ///< The federated ID of the Nextcloud session.
-    const std::string         k_username;    ///< The username of the Nextcloud account.
-    std::string               _password;     ///< The password of the Nextcloud account.
-    mutable std::shared_mutex _mutex;        ///< Mutex for this Session instance.
+    /**
+     * @brief Wakes the keepalive thread. Shared with the thread, so it can wait without keeping the Session alive.
+     */
+    struct KeepaliveSignal
+    {
+        std::mutex              mutex;       ///< Mutex for KeepaliveSignal::changes.
+        std::condition_variable conVar;      ///< Used whenever KeepaliveSignal::changes is incremented.
+        unsigned long           changes = 0; ///< Incremented whenever the keepalive interval changes or the Session is destroyed.
+    };
+
+    typedef std::unique_ptr<char, void (*)(void*)> SecureString; ///< A null terminated string in memory allocated with sodium_malloc().
+
+    const std::string         k_apiURL;          ///< Base url to the api used to connect with the server (example: https://cloud.example.com/apps/passwords/api/1.0/).
+    const std::string         k_federatedID;     ///< The federated ID of the Nextcloud session.
+    const std::string         k_username;        ///< The username of the Nextcloud account.
+    std::string               _password;         ///< The password of the Nextcloud account.
+    mutable std::shared_mutex _mutex;            ///< Mutex for this Session instance.
+    mutable RequestLimiter    _limiter;          ///< Limits the rate and concurrency of the requests sent with this Session.
+    mutable StringPool        _stringPool;       ///< Interns the non secret strings that repeat across the objects of this Session.
+    mutable RelationIndex     _relations;        ///< The folder tree and tag index of the objects of this Session.
+    mutable HealthIndex       _health;           ///< The hash, edit time and status index of the passwords of this Session.
+    mutable Keychain          _keychain;         ///< The client side encryption keys of this Session.
+    mutable ChangeNotifier    _notifier;         ///< Delivers the changes of the objects of this Session to their observers.
+    mutable MemoryAccount     _memoryAccount;    ///< The memory held by this Session and its objects.
+    mutable std::string       _apiSessionID;     ///< The ID of the API session opened with Session::open(). Sent with every request while set.
+    SecureString              _masterPassword;   ///< The master password used to open the API session. Needed to open it again once it expires. nullptr if there is none.
+    mutable std::mutex        _reopenMutex;      ///< Makes sure an expired API session is only opened again once.
+    mutable std::atomic<bool> _cookieAuth;       ///< True if requests made while an API session is open login with the session cookie instead of the password.
+    mutable std::atomic<bool> _keepaliveRunning; ///< True while the keepalive thread of this Session is running.
+
+    std::atomic<std::chrono::seconds>                          _keepaliveInterval; ///< How long the API session may be idle before a keepalive is sent.
+    const std::shared_ptr<KeepaliveSignal>                     _keepaliveSignal;   ///< Wakes the keepalive thread once the interval changes.
+    mutable std::atomic<std::chrono::steady_clock::time_point> _lastRequest;       ///< The last time a request was sent with this Session.
+    std::atomic<std::chrono::milliseconds>                     _connectTimeout;    ///< How long connecting to the server may take.
+    std::atomic<std::chrono::milliseconds>                     _requestTimeout;    ///< How long a whole request may take.
+
+    constexpr static size_t k_curlBufferSize = CURL_MAX_WRITE_SIZE; ///< The receive buffer curl allocates for every handle. Counted as transport while the handle is open.
+
+    CURLSH*                                     _curlShare;        ///< Shares DNS lookups and TLS sessions between the curl handles of this Session.
+    std::array<std::mutex, CURL_LOCK_DATA_LAST> _curlShareMutexes; ///< One mutex per kind of data in Session::_curlShare.
+    mutable std::vector<CURL*>                  _curlHandles;      ///< Idle curl handles. Each keeps its connection to the server open so it can be reused.
+    mutable std::mutex                          _curlHandlesMutex; ///< Mutex for Session::_curlHandles.
+
+    std::atomic<size_t>       _memoryBudget;      ///< The amount of bytes the Passwords of this Session may hold before cold ones get evicted. 0 is unlimited.
+    mutable std::atomic<bool> _evictionScheduled; ///< True while an eviction pass for this Session is pending.
+
+    mutable Journal                 _journal;      ///< The journal of pending changes. Only open after Session::openJournal().
+    std::atomic<bool>               _offline;      ///< True if the application set this Session offline.
+    mutable std::atomic<bool>       _disconnected; ///< True while the server can't be reached.
+    mutable std::mutex              _onlineMutex;  ///< Mutex for Session::_onlineConVar.
+    mutable std::condition_variable _onlineConVar; ///< Used whenever the Session comes back online.
+
+    PasswordGenerator _generator; ///< Keeps passwords generated by the server ready for Session::generatePassword().
+    FaviconCache      _favicons;  ///< Caches the favicons and previews of the service API for Session::getFavicon().
+
+    /**
+     * @brief Takes an idle curl handle or creates a new one.
+     * @return A curl handle set up to use Session::_curlShare.
+     */
+    CURL* takeCurlHandle() const;
+
+    /**
+     * @brief Returns a curl handle taken with Session::takeCurlHandle() so its connection can be reused.
+     * @param curl The curl handle.
+     */
+    void returnCurlHandle(CURL* curl) const;
+
+    /**
+     * @brief Opens the API session again after the server rejected it.
+     * Concurrent calls for the same expired session only open one new session.
+     * @param expiredID The ID of the API session the server rejected.
+     * @return True if there is a new API session.
+     */
+    bool reopen(const std::string& expiredID) const;
+
+    /**
+     * @brief Marks the server as unreachable or reachable again.
+     * While it's unreachable a background thread checks if it can be reached again with an increasing delay.
+     * @param disconnected True if a request failed because the server couldn't be reached.
+     */
+    void setDisconnected(bool disconnected) const;
+
+    /**
+     * @brief Wakes everything waiting for the Session to come online, repeats the pulls that failed while it was offline and pushes all pending changes in one go.
+     */
+    void notifyOnline() const;
+
+    /**
+     * @brief Blocks until the Session is online.
+     * @param token Stops waiting once cancelled.
+     * @return True if the Session is online, false if the token was cancelled first.
+     */
+    bool waitOnline(const CancellationToken& token = CancellationToken()) const;
+
+    /**
+     * @brief Starts a thread that keeps the API session alive while it's idle. Does nothing if the thread is already running.
+     * The thread stops once there is no API session anymore.
+     */
+    void startKeepalive() const;
 
 
   protected:
@@ -64,6 +179,7 @@ class NCPASSCPP_PUBLIC Session : public API_Implementor<Session>
      * @brief Constructor for Session.
      * @param username The user to login to the nextcloud server as.
      * @param serverRoot The root URL of the server without https:// or a path unless necessary for your server (example: cloud.example.com).
+     * A scheme is only needed to connect to a local test server without TLS (example: http://127.0.0.1:8080).
      * @param password The password for your login. If you have Two-Factor Authentication enabled this must be an app password.
      */
     Session(const std::string& username, const std::string& serverRoot, const std::string& password);
@@ -71,12 +187,19 @@ class NCPASSCPP_PUBLIC Session : public API_Implementor<Session>
 
   public:
 
+    /**
+     * @brief Closes all connections of this Session.
+     */
+    ~Session();
+
     /**
      * @brief Creates a Session object.
      * @param username The user to login to the nextcloud server as.
      * @param serverRoot The root URL of the server without https:// or a path unless necessary for your server (example: cloud.example.com, example.com/cloud).
+     * A scheme is only needed to connect to a local test server without TLS (example: http://127.0.0.1:8080).
      * @param password The password for your login. If you have Two-Factor Authentication enabled this must be an app password.
      * @return A shared pointer of the new Session object. This shared pointer gets copied to every child instance of API_Implementor.
+     * @throw std::runtime_error If libsodium couldn't be initialized.
      */
     static std::shared_ptr<Session> create(const std::string& username, const std::string& serverRoot, const std::string& password);
 
@@ -85,6 +208,7 @@ class NCPASSCPP_PUBLIC Session : public API_Implementor<Session>
      * @param federatedID The federated ID of the user to login as (example: user@cloud.example.com).
      * @param password The password for your login. If you have Two-Factor Authentication enabled this must be an app password.
      * @return A shared pointer of the new Session object. This shared pointer gets copied to every child instance of API_Implementor.
+     * @throw std::runtime_error If libsodium couldn't be initialized.
      */
     static std::shared_ptr<Session> create(const std::string& federatedID, const std::string& password);
 
@@ -107,8 +231,250 @@ class NCPASSCPP_PUBLIC Session : public API_Implementor<Session>
      */
     void setPassword(const std::string& password);
 
+    /**
+     * @brief Limits how many requests per second are sent to the Nextcloud server with this Session.
+     * Rate limiting is disabled by default.
+     * @param requestsPerSecond The sustained amount of requests per second. 0 disables rate limiting.
+     * @param burst The amount of requests that can be sent at once before the rate limit applies.
+     */
+    void setRateLimit(double requestsPerSecond, unsigned burst);
+
+    /**
+     * @brief Limits how many requests can be in flight at once with this Session.
+     * Requests over the limit are queued and sent by priority and then in the order they were made.
+     * Requests a user is waiting for (example: a getter waiting for a field) go before background work like Session::setAutoSync(), and background work always leaves one slot free.
+     * @param maxInFlight The maximum amount of concurrent requests (default: 6). 0 disables the cap.
+     */
+    void setMaxInFlight(unsigned maxInFlight);
+
+    /**
+     * @brief Limits how much memory the Passwords of this Session may use.
+     * When the budget is exceeded the least recently used Passwords get their password, notes and customFields wiped from memory.
+     * They are pulled again transparently the next time one of those fields is accessed.
+     * @param bytes The budget in bytes. 0 disables the budget (default).
+     */
+    void setMemoryBudget(size_t bytes);
+
+    /**
+     * @return The memory budget in bytes. 0 if there is none.
+     * @see ncpass::Session::setMemoryBudget()
+     */
+    size_t getMemoryBudget() const;
+
+    /**
+     * @brief Gets the memory held by this Session and all of its objects. This is a local only action.
+     * Kept up to date as the objects change, so it's cheap enough to check before every operation.
+     * Interned strings shared between passwords are not included.
+     * @return The memory usage of the Session.
+     * @see ncpass::API_Implementor::getTypeMemoryUsage()
+     */
+    MemoryUsage getMemoryUsage() const;
+
+    /**
+     * @brief Opens an API session asynchronously.
+     * Requests the login challenge, solves it on a background thread and opens the session.
+     * The connection used for the handshake is kept open and reused by the requests that follow.
+     * While the API session is open requests login with the session cookie, so the server doesn't have to verify the password every time.
+     * The session is kept alive while idle and opened again transparently if it expires anyway.
+     * If the server returns the client side encryption keychain it gets unlocked the same way as ncpass::Session::unlock().
+     * The steps run in sequence since each needs the one before: the challenge needs the salts of "session/request" and the keychain only comes with "session/open".
+     * Requests on other threads go ahead as soon as the session is open, while the keychain is still being unlocked.
+     * @param masterPassword The CSE master password of the account. Only needed if the account has one.
+     * @return A future that becomes true once the session is open or false if it couldn't be opened.
+     */
+    std::future<bool> open(const std::string& masterPassword = "");
+
+    /**
+     * @brief Sets how long the API session may be idle before a keepalive is sent to the server.
+     * Should be shorter than the session lifetime configured on the server.
+     * @param interval The idle time (default: 5 minutes).
+     */
+    void setKeepaliveInterval(std::chrono::seconds interval);
+
+    /**
+     * @brief Sets the timeouts of every request sent with this Session.
+     * A request that times out before it reached the server takes the Session offline like any other connection error.
+     * A request that was sent but didn't get a response in time only fails.
+     * Each operation can be given a shorter deadline or cancelled with a ncpass::CancellationToken.
+     * @param connect How long connecting to the server may take (default: 10 seconds).
+     * @param request How long a whole request may take, including connecting (default: 60 seconds).
+     */
+    void setTimeouts(std::chrono::milliseconds connect, std::chrono::milliseconds request);
+
+    /**
+     * @brief Keeps the fetched passwords of this Session fresh in the background.
+     * A single timer thread per process pulls small batches of the most outdated passwords of every Session with auto sync.
+     * Passwords that were read or written recently are refreshed more often, and the Session backs off while none of its passwords are touched.
+     * Off by default.
+     * @param enabled True to start keeping the passwords fresh, false to stop.
+     * @param settings How often passwords are refreshed and how many at once.
+     * @see ncpass::SyncScheduler
+     */
+    void setAutoSync(bool enabled, const SyncScheduler::Settings& settings = SyncScheduler::Settings());
+
+    /**
+     * @brief Opens a journal that keeps pending changes on the disk until they are pushed asynchronously.
+     * Changes that were still pending when the journal was last used (example: the application exited or the network was down) are applied and pushed again.
+     * The journal is encrypted with a key derived from the passphrase, so the passphrase has to stay the same between runs.
+     * @param path The path of the journal file. It's created if it doesn't exist.
+     * @param passphrase The passphrase to encrypt the journal with.
+     * @return A future that becomes true once the pending changes are applied or false if the journal couldn't be opened.
+     */
+    std::future<bool> openJournal(const std::string& path, const std::string& passphrase);
+
+    /**
+     * @brief Sets this Session offline or back online.
+     * Changes made while offline complete right away and are pushed together once the Session is back online.
+     * A Session also goes offline on its own while the server can't be reached and comes back once it can.
+     * @param offline True to stop sending changes to the server.
+     */
+    void setOffline(bool offline);
+
+    /**
+     * @brief Pushes all pending changes of this Session asynchronously and waits for them to be on the server and in the journal.
+     * Useful before shutting down. Give it a deadline so a hanging server can't stall the shutdown.
+     * Changes that weren't pushed when the token is cancelled stay pending, and in the journal if there is one.
+     * @param token Stops the flush once cancelled.
+     * @return A future that becomes true once every pending change was pushed or false if the token was cancelled first or the journal failed to write.
+     */
+    std::future<bool> flush(const CancellationToken& token = CancellationToken());
+
+    /**
+     * @return True if the Session is offline because it was set offline or the server can't be reached.
+     */
+    bool isOffline() const;
+
+    /**
+     * @brief Observes the changes to every password of this Session.
+     * Observers are only called when something actually changed, so there's no need to poll or wait on a thread per password.
+     * @param callback Called with every change.
+     * @param executor Runs the callback (example: posts it to a UI event loop). If empty the callback is called on the thread that made the change.
+     * @return The ID of the subscription.
+     * @see ncpass::Password::subscribe()
+     */
+    ChangeNotifier::SubscriptionID subscribe(ChangeNotifier::Callback callback, ChangeNotifier::Executor executor = nullptr);
+
+    /**
+     * @brief Observes the changes to one field of every password of this Session.
+     * @param field The key of the field (example: "label").
+     * @param callback Called with every change to the field.
+     * @param executor Runs the callback. If empty the callback is called on the thread that made the change.
+     * @return The ID of the subscription.
+     */
+    ChangeNotifier::SubscriptionID subscribe(const std::string& field, ChangeNotifier::Callback callback, ChangeNotifier::Executor executor = nullptr);
+
+    /**
+     * @brief Stops an observer of this Session or any of its passwords.
+     * @param id The ID returned when subscribing.
+     */
+    void unsubscribe(ChangeNotifier::SubscriptionID id);
+
+    /**
+     * @brief Unlocks client side encryption (CSE) asynchronously.
+     * Fetches the keychain, decrypts it with the master password and then decrypts the fetched passwords in parallel.
+     * Only the fields shown in lists are decrypted up front, the rest is decrypted the first time it's accessed.
+     * Reading an encrypted field waits while the Session is being unlocked. While it's locked otherwise the field can't be read, see ncpass::Password::hasDecryptionFailed().
+     * Changes that couldn't be encrypted while the Session was locked are pushed once it's unlocked.
+     * @param masterPassword The CSE master password of the account.
+     * @return A future that becomes true once the keychain is unlocked or false if it couldn't be unlocked.
+     * @see ncpass::Password::decryptAll()
+     */
+    std::future<bool> unlock(const std::string& masterPassword);
+
+    /**
+     * @brief Wipes the client side encryption keys from memory.
+     * Fields that were already decrypted stay available.
+     */
+    void lock();
+
+    /**
+     * @return True if the client side encryption keys are available.
+     */
+    bool isUnlocked() const;
+
+    /**
+     * @brief Generates a new password with the password service of the server.
+     * Passwords are generated ahead of time in the background, so this returns right away unless the pool for the settings ran dry.
+     * The first call for a settings starts a pool of PasswordGenerator::k_defaultPoolSize passwords for them.
+     * @param settings How the password is generated.
+     * @param token Aborts generating the password on the server once cancelled. Taking a password from the pool is never aborted.
+     * @return The password. Nothing if the pool was empty and the server couldn't generate a password.
+     * @see ncpass::PasswordGenerator
+     */
+    std::optional<std::string> generatePassword(const PasswordGenerator::Settings& settings = PasswordGenerator::Settings(), const CancellationToken& token = CancellationToken());
+
+    /**
+     * @brief Sets how many generated passwords are kept ready for the given settings (example: to have them ready before a form is opened).
+     * @param settings How the passwords are generated.
+     * @param size The amount of passwords to keep ready. 0 wipes and drops the pool.
+     */
+    void setGeneratorPool(const PasswordGenerator::Settings& settings, size_t size);
+
+    /**
+     * @brief Gets the fetched passwords that share their secret with another password. This is a local only action.
+     * The passwords are matched by their hash, so no secrets are read. Passwords in the trash are left out.
+     * @return The reused passwords, grouped by secret.
+     * @see ncpass::HealthIndex
+     */
+    std::vector<std::vector<std::shared_ptr<Password>>> getReusedPasswords() const;
+
+    /**
+     * @brief Gets the fetched passwords whose secret wasn't changed since the given time (example: now minus 365 days). This is a local only action.
+     * @param time The time.
+     * @return The passwords, oldest first.
+     */
+    std::vector<std::shared_ptr<Password>> getPasswordsEditedBefore(std::chrono::system_clock::time_point time) const;
+
+    /**
+     * @brief Gets the fetched passwords the server gave a status. This is a local only action.
+     * @param statusCode The status (example: "OUTDATED", "DUPLICATE" or "BREACHED").
+     * @return The passwords with the status.
+     */
+    std::vector<std::shared_ptr<Password>> getPasswordsByStatus(const std::string& statusCode) const;
+
+    /**
+     * @brief Gets the favicon of a website through the server, so the website doesn't learn who's asking.
+     * Favicons are cached per domain, so a list of passwords only sends one request per website. The future is ready right away if the favicon is in memory.
+     * @param url A URL or a domain (example: the URL of a password).
+     * @param size The size of the favicon in pixels.
+     * @return A future for the favicon. Holds nullptr if the favicon couldn't be downloaded.
+     * @see ncpass::FaviconCache
+     */
+    std::shared_future<FaviconCache::Image> getFavicon(const std::string& url, int size = FaviconCache::k_defaultSize);
+
+    /**
+     * @brief Gets a screenshot of a website through the server. Previews are cached like favicons.
+     * @param url A URL or a domain (example: the URL of a password).
+     * @param mobile True for the mobile version of the website.
+     * @param width The width of the preview in pixels.
+     * @param height The height of the preview in pixels.
+     * @return A future for the preview. Holds nullptr if the preview couldn't be downloaded.
+     */
+    std::shared_future<FaviconCache::Image> getPreview(const std::string& url, bool mobile = false, int width = 640, int height = 360);
+
+    /**
+     * @brief Downloads the favicons of passwords in the background (example: the rows of a list that are about to be shown).
+     * Only the URLs that are available locally are used, so this never blocks. Favicons that are cached or already being downloaded are skipped.
+     * @param passwords The passwords.
+     * @param size The size of the favicons in pixels.
+     */
+    void prefetchFavicons(const std::vector<std::shared_ptr<Password>>& passwords, int size = FaviconCache::k_defaultSize);
+
+    /**
+     * @brief Sets how many favicons and previews are cached and keeps them on disk as well, so they survive the application.
+     * @param directory The directory to keep the images in. Created if it doesn't exist. Empty to only cache them in memory.
+     * @param diskBytes How many bytes of images are kept on disk at most.
+     * @param memoryBytes How many bytes of images are kept in memory at most.
+     * @return False if the directory couldn't be created.
+     */
+    bool setFaviconCache(const std::string& directory, size_t diskBytes, size_t memoryBytes = FaviconCache::k_defaultMemoryLimit);
+
     template <class API_Type>
     friend class API_Implementor;
+
+    friend class Folder;
+    friend class Password;
+    friend class Tag;
 };
 
 
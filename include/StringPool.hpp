@@ -0,0 +1,97 @@
+/*
+ * ncpasscpp. A library that implements Nextcloud Password's API.
+ * Copyright (C) 2021  Reed Krantz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#if defined _WIN32 || defined __CYGWIN__
+    #ifdef BUILDING_NCPASSCPP
+        #define NCPASSCPP_PUBLIC __declspec(dllexport)
+    #else
+        #define NCPASSCPP_PUBLIC __declspec(dllimport)
+    #endif
+#else
+    #ifdef BUILDING_NCPASSCPP
+        #define NCPASSCPP_PUBLIC __attribute__ ((visibility("default")))
+    #else
+        #define NCPASSCPP_PUBLIC
+    #endif
+#endif
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace ncpass
+{
+
+
+
+
+/**
+ * @brief A pool of interned strings.
+ * Equal strings interned in the same pool share one allocation, so they can be compared by pointer.
+ * A string is removed from the pool as soon as the last handle to it is destroyed.
+ * Never intern secrets. Interned strings aren't wiped from memory.
+ * @author Reed Krantz
+ */
+class NCPASSCPP_PUBLIC StringPool
+{
+  public:
+
+    typedef std::shared_ptr<const std::string> Handle; ///< A handle to an interned string. Equal strings from the same pool have equal handles.
+
+
+  private:
+
+    /**
+     * @brief The contents of the pool.
+     * Kept in a shared_ptr so handles that outlive the pool don't touch freed memory when they are destroyed.
+     */
+    struct State
+    {
+        std::unordered_map<std::string_view, std::weak_ptr<const std::string>> strings; ///< The interned strings. The keys point into the strings they map to.
+        std::mutex mutex;                                                                ///< Mutex used for locking access to State::strings.
+    };
+
+    const std::shared_ptr<State> k_state; ///< The contents of the pool.
+
+
+  public:
+
+    StringPool();
+
+    StringPool(const StringPool&) = delete;
+
+    StringPool& operator=(const StringPool&) = delete;
+
+    /**
+     * @brief Gets the handle of a string, adding it to the pool if it isn't already in it.
+     * @param str The string to intern.
+     * @return The handle shared by every string equal to str in this pool.
+     */
+    Handle intern(const std::string& str);
+
+    /**
+     * @return The amount of unique strings currently in the pool.
+     */
+    size_t size() const;
+};
+
+
+}
@@ -0,0 +1,136 @@
+/*
+ * ncpasscpp. A library that implements Nextcloud Password's API.
+ * Copyright (C) 2021  Reed Krantz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#if defined _WIN32 || defined __CYGWIN__
+    #ifdef BUILDING_NCPASSCPP
+        #define NCPASSCPP_PUBLIC __declspec(dllexport)
+    #else
+        #define NCPASSCPP_PUBLIC __declspec(dllimport)
+    #endif
+#else
+    #ifdef BUILDING_NCPASSCPP
+        #define NCPASSCPP_PUBLIC __attribute__ ((visibility("default")))
+    #else
+        #define NCPASSCPP_PUBLIC
+    #endif
+#endif
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace ncpass
+{
+
+
+
+
+class Session; // forward declaration
+
+
+
+
+/**
+ * @brief Keeps the passwords of Sessions fresh in the background.
+ * There is only one scheduler and one timer thread per process no matter how many Sessions and passwords there are. The thread only runs while there are Sessions to keep fresh.
+ * Every tick of a Session pulls a small batch of its most outdated passwords. Passwords that were touched recently are refreshed more often.
+ * While none of the passwords of a Session are touched the ticks of that Session back off, and the ticks are jittered so many clients don't hit the server at the same time.
+ * @see ncpass::Session::setAutoSync()
+ * @author Reed Krantz
+ */
+class NCPASSCPP_PUBLIC SyncScheduler
+{
+  public:
+
+    /**
+     * @brief How a Session is kept fresh.
+     */
+    struct Settings
+    {
+        std::chrono::seconds interval    = std::chrono::seconds(60);  ///< How old a password may get before it's pulled again.
+        std::chrono::seconds maxInterval = std::chrono::seconds(900); ///< The longest Settings::interval may grow to while the Session is idle.
+        std::chrono::seconds hotInterval = std::chrono::seconds(10);  ///< How old a recently touched password may get before it's pulled again.
+        std::chrono::seconds hotWindow   = std::chrono::seconds(120); ///< How long a password counts as recently touched after it was read or written.
+        unsigned             batchSize   = 16;                        ///< The maximum amount of passwords pulled per tick.
+        double               jitter      = 0.2;                       ///< How much the time between ticks is randomly stretched or shrunk (0.2 is +-20%).
+    };
+
+
+  private:
+
+    /**
+     * @brief A Session that is kept fresh.
+     */
+    struct Entry
+    {
+        std::weak_ptr<Session>                session;  ///< The Session. Dropped once it's gone.
+        Settings                              settings; ///< How the Session is kept fresh.
+        std::chrono::seconds                  interval; ///< The current interval. Grows up to Settings::maxInterval while the Session is idle.
+        std::chrono::steady_clock::time_point lastTick; ///< The last tick of the Session.
+        std::chrono::steady_clock::time_point due;      ///< The next tick of the Session.
+    };
+
+    std::unordered_map<const Session*, Entry> _entries; ///< The Sessions that are kept fresh.
+    bool                                      _running; ///< True while the timer thread runs.
+    std::mutex                                _mutex;   ///< Mutex used for locking access to all member variables.
+    std::condition_variable                   _conVar;  ///< Wakes up the timer thread when the Sessions change.
+
+    /**
+     * @brief Constructor for SyncScheduler.
+     */
+    SyncScheduler();
+
+    /**
+     * @brief Runs the ticks of all Sessions when they are due. Runs on the timer thread until there are no Sessions left.
+     */
+    void run();
+
+    /**
+     * @param delay The time until the next tick.
+     * @param jitter How much to stretch or shrink the time randomly.
+     * @return The delay stretched or shrunk by a random amount.
+     */
+    static std::chrono::steady_clock::duration addJitter(std::chrono::steady_clock::duration delay, double jitter);
+
+
+  public:
+
+    /**
+     * @return The scheduler of the process.
+     */
+    static SyncScheduler& get();
+
+    /**
+     * @brief Starts keeping a Session fresh or changes its settings.
+     * @param session The Session.
+     * @param settings How the Session is kept fresh.
+     */
+    void add(const std::shared_ptr<Session>& session, const Settings& settings);
+
+    /**
+     * @brief Stops keeping a Session fresh.
+     * @param session The Session.
+     */
+    void remove(const Session* session);
+};
+
+
+}
@@ -0,0 +1,226 @@
+/*
+ * ncpasscpp. A library that implements Nextcloud Password's API.
+ * Copyright (C) 2021  Reed Krantz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#if defined _WIN32 || defined __CYGWIN__
+    #ifdef BUILDING_NCPASSCPP
+        #define NCPASSCPP_PUBLIC __declspec(dllexport)
+    #else
+        #define NCPASSCPP_PUBLIC __declspec(dllimport)
+    #endif
+#else
+    #ifdef BUILDING_NCPASSCPP
+        #define NCPASSCPP_PUBLIC __attribute__ ((visibility("default")))
+    #else
+        #define NCPASSCPP_PUBLIC
+    #endif
+#endif
+
+#include <future>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <CancellationToken.hpp>
+#include <nlohmann/json.hpp>
+
+namespace ncpass
+{
+
+
+
+
+class Password; // forward declaration
+class Session;  // forward declaration
+
+
+
+
+/**
+ * @brief Streams the passwords of a Session in and out of standard formats (example: moving a vault to or from another password manager).
+ * Records are handled one at a time, so exporting and importing large vaults doesn't hold the secrets of more than a batch of passwords in memory.
+ * The supported formats are:
+ *   - CSV with a header row. Exports the columns "label", "username", "password", "url" and "notes". Imports those columns (and the common names other password managers use for them) in any order, other columns are ignored.
+ *   - The JSON backup format of the Passwords app ({ "version", "encrypted", "passwords", ... }). Only unencrypted backups that state "encrypted" before "passwords" can be imported.
+ * @author Reed Krantz
+ */
+class NCPASSCPP_PUBLIC Vault
+{
+  public:
+
+    /**
+     * @brief The formats a vault can be streamed in.
+     */
+    enum Format
+    {
+        CSV, ///< Comma separated values with a header row (RFC 4180).
+        JSON ///< The JSON backup format of the Passwords app.
+    };
+
+    /**
+     * @brief The outcome of Vault::exportPasswords().
+     */
+    struct ExportResult
+    {
+        size_t written;  ///< The amount of passwords written.
+        bool   complete; ///< False if the passwords couldn't be listed, the stream failed or the token was cancelled before every password was written.
+    };
+
+    /**
+     * @brief The outcome of Vault::importPasswords().
+     */
+    struct ImportResult
+    {
+        size_t created;  ///< The amount of records created on the server.
+        size_t failed;   ///< The amount of records that couldn't be created.
+        size_t skipped;  ///< The amount of records without a label or a password.
+        bool   complete; ///< False if the input couldn't be read to the end, the backup is encrypted or the token was cancelled.
+
+        std::vector<std::shared_ptr<Password>> pending; ///< The passwords of the records that couldn't be created, in the order they were read. Password::sync() creates them again.
+    };
+
+
+  private:
+
+    constexpr const static char* k_csvColumns[] = { "label", "username", "password", "url", "notes" }; ///< The columns of an exported CSV file.
+    constexpr const static char* k_csvAliases[][2] = {                                                   ///< Column names used by other password managers and the field they map to.
+        { "name", "label" }, { "title", "label" }, { "login_username", "username" }, { "login", "username" },
+        { "login_password", "password" }, { "login_uri", "url" }, { "website", "url" }, { "note", "notes" }
+    };
+    constexpr const static char* k_importKeys[] = { "label", "username", "password", "url", "notes", "customFields", "favorite" }; ///< The fields taken from an imported record.
+    constexpr const static size_t k_importBatchSize = 256;  ///< The amount of records handed to Password::createMany() at once.
+    constexpr const static int    k_backupVersion   = 2;    ///< The "version" of exported JSON backups.
+
+    /**
+     * @brief Feeds imported records to Password::createMany() in batches.
+     * Only one batch is created at a time. Adding a record blocks while the previous batch is still being created, which keeps the reader from running ahead of the server.
+     * The passwords of a batch are evicted and released once they're created, so they don't stay in memory.
+     */
+    class Importer
+    {
+      private:
+
+        const std::shared_ptr<Session>& _session;  ///< The Session the records are created in.
+        const CancellationToken&        _token;    ///< Stops the import once cancelled.
+        std::vector<nlohmann::json>     _batch;    ///< The records read since the last batch was handed over.
+        std::vector<std::shared_ptr<Password>> _passwords; ///< The passwords of the batch being created.
+        std::future<std::vector<bool>>         _inFlight;  ///< The outcome of the batch being created. Invalid if there is none.
+        ImportResult                           _result;    ///< The outcome so far.
+
+        /**
+         * @brief Waits for the batch being created, counts its outcome and releases the passwords that were created.
+         * The passwords that weren't created are kept in Vault::ImportResult::pending.
+         */
+        void collect();
+
+        /**
+         * @brief Waits for the batch being created, then hands over the records read since.
+         */
+        void submit();
+
+
+      public:
+
+        /**
+         * @param session The Session the records are created in.
+         * @param token Stops the import once cancelled.
+         */
+        Importer(const std::shared_ptr<Session>& session, const CancellationToken& token);
+
+        /**
+         * @brief Adds a record. Records without a label or a password are skipped.
+         * @param json The record. Only the fields in Vault::k_importKeys are used.
+         */
+        void add(const nlohmann::json& json);
+
+        /**
+         * @brief Creates the remaining records and waits for them.
+         * @param complete False if the input couldn't be read to the end.
+         * @return The outcome of the import.
+         */
+        ImportResult finish(bool complete);
+    };
+
+    /**
+     * @param value A field.
+     * @return The field quoted for a CSV file.
+     */
+    static std::string quoteCsv(const std::string& value);
+
+    /**
+     * @brief Reads one record of a CSV file. Quoted fields may contain commas, quotes ("") and line breaks.
+     * @param in The stream to read from.
+     * @param fields Set to the fields of the record.
+     * @return False if there are no records left.
+     */
+    static bool readCsvRecord(std::istream& in, std::vector<std::string>& fields);
+
+    /**
+     * @brief Imports a CSV file.
+     * @param in The stream to read from.
+     * @param importer Receives the records.
+     * @param token Stops reading once cancelled.
+     * @return True if the file was read to the end.
+     */
+    static bool importCsv(std::istream& in, Importer& importer, const CancellationToken& token);
+
+    /**
+     * @brief Imports a JSON backup. Every password is handed over as soon as it's parsed and then discarded.
+     * @param in The stream to read from.
+     * @param importer Receives the records.
+     * @param token Stops handing over records once cancelled.
+     * @return True if the backup was read to the end and stated that it isn't encrypted before its passwords.
+     */
+    static bool importJson(std::istream& in, Importer& importer, const CancellationToken& token);
+
+
+  public:
+
+    /**
+     * @brief Writes the passwords of a Session to a stream.
+     * The passwords are listed from the server with a single request and written one at a time from their snapshots.
+     * Passwords that weren't fetched before the export are evicted again once they're written.
+     * Folders and tags are read only for now, so JSON backups only contain the passwords.
+     * Blocks the thread. Fields with client side encryption are written empty while the Session is locked.
+     * @param session A shared_ptr to a ncpass::Session instance. Used as credentials for the Nextcloud server's API.
+     * @param out The stream to write to.
+     * @param format The format to write.
+     * @param token Stops the export once cancelled. A JSON backup is still closed, so it holds the passwords written so far.
+     * @return The amount of passwords written and whether that's all of them.
+     * @see ncpass::Password::fetchAll()
+     */
+    static ExportResult exportPasswords(const std::shared_ptr<Session>& session, std::ostream& out, Format format, const CancellationToken& token = CancellationToken());
+
+    /**
+     * @brief Reads passwords from a stream and creates them on the server.
+     * Records are created in batches of Vault::k_importBatchSize through Password::createMany() while the next batch is read.
+     * The created passwords are released batch by batch, so the memory used doesn't grow with the amount of records. Fetch them to work with them.
+     * The passwords that couldn't be created are returned instead and keep their fields until they are.
+     * Blocks the thread until all the records are created.
+     * @param session A shared_ptr to a ncpass::Session instance. Used as credentials for the Nextcloud server's API.
+     * @param in The stream to read from.
+     * @param format The format to read.
+     * @param token Stops the import once cancelled. Records that weren't created yet are returned as pending, records that weren't read yet are left alone.
+     * @return The outcome of the import.
+     */
+    static ImportResult importPasswords(const std::shared_ptr<Session>& session, std::istream& in, Format format, const CancellationToken& token = CancellationToken());
+};
+
+
+}
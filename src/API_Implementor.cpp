@@ -16,7 +16,12 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
 #include <atomic>
+#include <cctype>
+#include <chrono>
+#include <mutex>
+#include <string_view>
 #include <API_Implementor.hpp>
 #include <curl/curl.h>
 #include <Session.hpp>
@@ -34,20 +39,26 @@ template <class API_Type>
 std::vector<std::weak_ptr<API_Type>> API_Implementor<API_Type>::s_deletingInstances;
 
 template <class API_Type>
-std::shared_mutex API_Implementor<API_Type>::s_mutex;
+ProfiledMutex<std::shared_mutex> API_Implementor<API_Type>::s_mutex("API_Implementor::s_mutex");
+
+template <class API_Type>
+MemoryAccount API_Implementor<API_Type>::s_memoryAccount;
 
 
 template <class API_Type>
 API_Implementor<API_Type>::API_Implementor(const std::shared_ptr<Session>& session, const std::string& apiPath) :
     k_lockbox(session),
     k_session(*session),
-    k_apiPath(apiPath + "/")
+    k_apiPath(apiPath + "/"),
+    _accountedMemory()
 {
     // Compile time check that API_Type has a base of API_Implementor.
     static_assert(
       std::is_base_of<API_Implementor, API_Type>::value,
       "API_Implementor<class API_Type>: API_Type should be set to your child class."
       );
+
+    setMemoryUsage(MemoryAccount::OBJECTS, sizeof(API_Type) + sizeof(std::shared_ptr<API_Type>));
 }
 
 
@@ -55,13 +66,16 @@ template <class API_Type>
 API_Implementor<API_Type>::API_Implementor(const API_Implementor& apiObject, const std::string& apiPath) :
     k_lockbox(apiObject.k_lockbox),
     k_session(apiObject.k_session),
-    k_apiPath(apiPath + "/")
+    k_apiPath(apiPath + "/"),
+    _accountedMemory()
 {
     // Compile time check that API_Type has a base of API_Implementor.
     static_assert(
       std::is_base_of<API_Implementor, API_Type>::value,
       "API_Implementor<class API_Type>: API_Type should be set to your child class."
       );
+
+    setMemoryUsage(MemoryAccount::OBJECTS, sizeof(API_Type) + sizeof(std::shared_ptr<API_Type>));
 }
 
 
@@ -69,7 +83,8 @@ template <class API_Type>
 API_Implementor<API_Type>::API_Implementor(const std::string& apiPath) :
     k_lockbox(std::shared_ptr<Session>()),
     k_session(static_cast<Session&>(*this)),
-    k_apiPath(apiPath + "/")
+    k_apiPath(apiPath + "/"),
+    _accountedMemory()
 {
     static_assert(std::is_base_of<Session, API_Type>::value, "API_Implementor(const std::string& apiPath) can only be called from Session");
 
@@ -84,7 +99,7 @@ API_Implementor<API_Type>::API_Implementor(const std::string& apiPath) :
 template <class API_Type>
 std::vector<std::shared_ptr<API_Type>> API_Implementor<API_Type>::getRegistered()
 {
-    std::shared_lock<std::shared_mutex> lock(s_mutex);
+    std::shared_lock lock(s_mutex);
 
 
     return s_activeInstances;
@@ -107,7 +122,7 @@ std::shared_ptr<API_Type> API_Implementor<API_Type>::registerInstance()
         newInstance = std::shared_ptr<API_Type>(static_cast<API_Type*>(this));
     }
 
-    std::unique_lock<std::shared_mutex> lock(s_mutex);
+    std::unique_lock lock(s_mutex);
 
 
     // verify that the object to register doesn't already have a duplicate
@@ -123,17 +138,18 @@ std::shared_ptr<API_Type> API_Implementor<API_Type>::registerInstance()
             return apiImp;
     }
 
-    for( auto itr = s_deletingInstances.begin(); itr != s_deletingInstances.end(); itr++ )
+    for( auto itr = s_deletingInstances.begin(); itr != s_deletingInstances.end(); )
     {
         if( auto apiImp = itr->lock() )
         {
             if( apiImp->getID() == id )
                 return apiImp;
+
+            itr++;
         }
         else
         {
-            s_deletingInstances.erase(itr);
-            itr--;
+            itr = s_deletingInstances.erase(itr);
         }
     }
 
@@ -149,7 +165,7 @@ bool API_Implementor<API_Type>::setPopulated()
 {
     auto thisPtr = this->shared_from_this();
 
-    std::unique_lock<std::shared_mutex> lock(s_mutex);
+    std::unique_lock lock(s_mutex);
 
 
     for( auto itr = s_creatingInstances.begin(); itr != s_creatingInstances.end(); itr++ )
@@ -172,17 +188,17 @@ bool API_Implementor<API_Type>::unregisterInstance()
 {
     auto thisPtr = this->shared_from_this();
 
-    std::unique_lock<std::shared_mutex> lock(s_mutex);
+    std::unique_lock lock(s_mutex);
 
 
     for( auto currentVector : { &s_activeInstances, &s_creatingInstances } )
     {
-        for( auto itr = currentVector.begin(); itr != currentVector.end(); itr++ )
+        for( auto itr = currentVector->begin(); itr != currentVector->end(); itr++ )
         {
             if( *itr == thisPtr )
             {
                 s_deletingInstances.push_back(std::weak_ptr(*itr));
-                currentVector.erase(itr);
+                currentVector->erase(itr);
 
                 return true;
             }
@@ -194,21 +210,55 @@ bool API_Implementor<API_Type>::unregisterInstance()
 
 
 template <class API_Type>
-nlohmann::json API_Implementor<API_Type>::apiCall(Methods method, const std::string& apiAction, const nlohmann::json& apiArgs)
+nlohmann::json API_Implementor<API_Type>::apiCall(Methods method, const std::string& apiAction, const nlohmann::json& apiArgs, RequestLimiter::Priority priority,
+                                                  const CancellationToken& token)
+{
+    return apiCall(k_session, k_apiPath, method, apiAction, apiArgs, priority, token);
+}
+
+
+template <class API_Type>
+nlohmann::json API_Implementor<API_Type>::apiCall(const Session& session, const std::string& apiPath, Methods method, const std::string& apiAction, const nlohmann::json& apiArgs,
+                                                  RequestLimiter::Priority priority, const CancellationToken& token)
 {
-    CURL*    curl;
-    CURLcode res;
+    std::optional<std::string> body = apiRequest(session, apiPath, method, apiAction, apiArgs, priority, token);
+
+
+    // Failed requests return an empty object so callers can check for the keys they expect.
+    if( !body )
+        return nlohmann::json::object();
+
+    nlohmann::json json = nlohmann::json::parse(*body, nullptr, false);
+
 
+    return !json.is_discarded() ? json : nlohmann::json::object();
+}
 
-    curl = curl_easy_init();
 
-    if( curl )
+template <class API_Type>
+std::optional<std::string> API_Implementor<API_Type>::apiRequest(const Session& session, const std::string& apiPath, Methods method, const std::string& apiAction,
+                                                                 const nlohmann::json& apiArgs, RequestLimiter::Priority priority, const CancellationToken& token,
+                                                                 long* responseCode)
+{
+    for( unsigned attempt = 0;; attempt++ )
     {
+        CURL*    curl;
+        CURLcode res;
+
+
+        if( token.isCancelled() )
+            return std::nullopt;
+
+        curl = session.takeCurlHandle();
+
+        if( !curl )
+            return std::nullopt;
+
         curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, strMethods[method]);
-        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, curl_slist_append(NULL, "Content-Type: application/json"));
 
         const std::string postFields = apiArgs.dump();
-        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, postFields.c_str());
+        if( method != GET )
+            curl_easy_setopt(curl, CURLOPT_POSTFIELDS, postFields.c_str());
 
         std::string buffer;
         curl_easy_setopt(
@@ -221,30 +271,224 @@ nlohmann::json API_Implementor<API_Type>::apiCall(Methods method, const std::str
           );
         curl_easy_setopt(curl, CURLOPT_WRITEDATA, &buffer);
 
-        std::shared_lock<std::shared_mutex> lock(k_session._mutex);
+        // The server hands out the ID of an API session in the "X-API-SESSION" header.
+        std::string apiSessionID;
+        curl_easy_setopt(
+          curl, CURLOPT_HEADERFUNCTION, +[] (char* contents, size_t size, size_t nmemb, void* userp)
+            {
+                constexpr std::string_view name = "x-api-session:";
+
+                std::string_view header(contents, size * nmemb);
+
+
+                if( header.size() > name.size() )
+                {
+                    bool matches = true;
+
+                    for( size_t i = 0; i < name.size(); i++ )
+                        matches = matches && (std::tolower((unsigned char)header[i]) == name[i]);
+
+                    if( matches )
+                    {
+                        header.remove_prefix(name.size());
+
+                        while( !header.empty() && std::isspace((unsigned char)header.front()) )
+                            header.remove_prefix(1);
+
+                        while( !header.empty() && std::isspace((unsigned char)header.back()) )
+                            header.remove_suffix(1);
+
+                        ((std::string*)userp)->assign(header);
+                    }
+                }
+
+                return size * nmemb;
+            }
+          );
+        curl_easy_setopt(curl, CURLOPT_HEADERDATA, &apiSessionID);
+
+        // Wait for the Session's rate limit and concurrency cap before touching the credentials.
+        RequestLimiter::Slot slot = session._limiter.acquire(priority, token);
+
+
+        if( !slot )
+        {
+            session.returnCurlHandle(curl);
+            return std::nullopt;
+        }
+
+        // The request is bounded by the Session's timeouts and the deadline of the token. Cancelling the token aborts the transfer.
+        const std::chrono::milliseconds remaining = std::chrono::duration_cast<std::chrono::milliseconds>(token.getDeadline() - std::chrono::steady_clock::now());
+
+
+        curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT_MS, (long)session._connectTimeout.load().count());
+        curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS,        (long)std::max(std::min(remaining, session._requestTimeout.load()), std::chrono::milliseconds(1)).count());
+        curl_easy_setopt(curl, CURLOPT_NOPROGRESS,        0L);
+        curl_easy_setopt(
+          curl, CURLOPT_XFERINFOFUNCTION, +[] (void* clientp, curl_off_t, curl_off_t, curl_off_t, curl_off_t) -> int
+            {
+                return ((const CancellationToken*)clientp)->isCancelled() ? 1 : 0;
+            }
+          );
+        curl_easy_setopt(curl, CURLOPT_XFERINFODATA, &token);
+
+        std::shared_lock<std::shared_mutex> lock(session._mutex);
+
+        const std::string sentSessionID = session._apiSessionID;
+        curl_slist*       headers       = curl_slist_append(NULL, "Content-Type: application/json");
+
+        if( !sentSessionID.empty() )
+            headers = curl_slist_append(headers, ("X-API-SESSION: " + sentSessionID).c_str());
+
+        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+        curl_easy_setopt(curl, CURLOPT_URL,        (session.k_apiURL + apiPath + apiAction).c_str());
+
+        // While an API session is open the login cookie saves the server from verifying the password again.
+        if( sentSessionID.empty() || !session._cookieAuth )
+        {
+            curl_easy_setopt(curl, CURLOPT_USERNAME, session.k_username.c_str());
+            curl_easy_setopt(curl, CURLOPT_PASSWORD, session._password.c_str());
+        }
+
+        // The request and response bodies are counted as transport while they are held.
+        const size_t requestBytes = postFields.capacity();
 
-        curl_easy_setopt(curl, CURLOPT_URL,      (k_session.k_apiURL + k_apiPath + apiAction).c_str());
-        curl_easy_setopt(curl, CURLOPT_USERNAME, k_session.k_username.c_str());
-        curl_easy_setopt(curl, CURLOPT_PASSWORD, k_session._password.c_str());
+
+        addMemory(session, MemoryAccount::TRANSPORT, requestBytes);
 
         res = curl_easy_perform(curl);
 
         lock.unlock();
+        slot.release();
+
+        const size_t responseBytes = buffer.capacity();
+
+
+        addMemory(session, MemoryAccount::TRANSPORT, responseBytes);
+
+        long code = 0;
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &code);
+
+        // Requests that never reached the server take the Session offline until it can be reached again.
+        switch( res )
+        {
+            case CURLE_COULDNT_RESOLVE_PROXY:
+            case CURLE_COULDNT_RESOLVE_HOST:
+            case CURLE_COULDNT_CONNECT:
+            case CURLE_SEND_ERROR:
+            case CURLE_RECV_ERROR:
+            case CURLE_GOT_NOTHING:
+                session.setDisconnected(true);
+                break;
+
+            // A request that timed out after it was sent only means the server was slower than the timeout.
+            case CURLE_OPERATION_TIMEDOUT:
+            {
+                long requestSize = 0;
+
+
+                curl_easy_getinfo(curl, CURLINFO_REQUEST_SIZE, &requestSize);
+
+                if( requestSize == 0 )
+                    session.setDisconnected(true);
+
+                break;
+            }
+
+            default:
+                break;
+        }
+
+        session._lastRequest = std::chrono::steady_clock::now();
+        session.returnCurlHandle(curl);
+        curl_slist_free_all(headers);
+
+        if( !apiSessionID.empty() )
+        {
+            std::unique_lock<std::shared_mutex> uniqueLock(session._mutex);
+
+            session._apiSessionID = std::move(apiSessionID);
+        }
+
+        // The API session expired. Open a new one and try again.
+        // If the new session gets rejected as well the server doesn't accept the login cookie, so fall back to the password.
+        if( (code == 401) && !sentSessionID.empty() && (attempt < 2) && !token.isCancelled() )
+        {
+            if( attempt == 0 )
+                session.reopen(sentSessionID);
+            else
+                session._cookieAuth = false;
+
+            removeMemory(session, MemoryAccount::TRANSPORT, requestBytes + responseBytes);
+
+            continue;
+        }
 
-        curl_easy_cleanup(curl);
+        removeMemory(session, MemoryAccount::TRANSPORT, requestBytes + responseBytes);
 
-        nlohmann::json json = nlohmann::json::parse(buffer);
+        if( responseCode )
+            *responseCode = code;
 
-        return json;
+        if( res != CURLE_OK )
+            return std::nullopt;
+
+        return buffer;
     }
+}
+
 
-    return "";
+template <class API_Type>
+const Session& API_Implementor<API_Type>::getSession() const { return k_session; }
+
+
+template <class API_Type>
+void API_Implementor<API_Type>::addMemory(const Session& session, MemoryAccount::Category category, size_t bytes)
+{
+    s_memoryAccount.add(category, bytes);
+    session._memoryAccount.add(category, bytes);
+}
+
+
+template <class API_Type>
+void API_Implementor<API_Type>::removeMemory(const Session& session, MemoryAccount::Category category, size_t bytes)
+{
+    s_memoryAccount.remove(category, bytes);
+    session._memoryAccount.remove(category, bytes);
+}
+
+
+template <class API_Type>
+void API_Implementor<API_Type>::setMemoryUsage(MemoryAccount::Category category, size_t bytes) const
+{
+    const size_t previous = _accountedMemory[category].exchange(bytes);
+
+
+    if( previous == bytes )
+        return;
+
+    removeMemory(k_session, category, previous);
+    addMemory(k_session, category, bytes);
+}
+
+
+template <class API_Type>
+void API_Implementor<API_Type>::releaseMemoryUsage() const
+{
+    for( size_t category = 0; category < _accountedMemory.size(); category++ )
+        setMemoryUsage((MemoryAccount::Category)category, 0);
 }
 
 
+template <class API_Type>
+MemoryUsage API_Implementor<API_Type>::getTypeMemoryUsage() { return s_memoryAccount.get(); }
+
+
 template <class API_Type>
 API_Implementor<API_Type>::~API_Implementor()
-{}
+{
+    // A Session releases its memory in its own destructor because its account is already destroyed by now.
+    releaseMemoryUsage();
+}
 
 
 }
@@ -0,0 +1,360 @@
+/*
+ * ncpasscpp. A library that implements Nextcloud Password's API.
+ * Copyright (C) 2021  Reed Krantz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <limits>
+#include <thread>
+#include <BreachAudit.hpp>
+#include <fcntl.h>
+#include <Password.hpp>
+#include <Session.hpp>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "API_Implementor.cpp"
+
+
+namespace ncpass
+{
+
+
+BreachAudit::BreachAudit(const char* data, size_t size) :
+    _data(data),
+    _size(size)
+{}
+
+
+BreachAudit::~BreachAudit() { munmap(const_cast<char*>(_data), _size); }
+
+
+std::shared_ptr<BreachAudit> BreachAudit::open(const std::string& path)
+{
+    int         fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat info;
+
+
+    if( fd < 0 )
+        return nullptr;
+
+    if( (fstat(fd, &info) != 0) || (info.st_size <= 0) )
+    {
+        close(fd);
+        return nullptr;
+    }
+
+    void* data = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+
+
+    // The mapping keeps the file open.
+    close(fd);
+
+    if( data == MAP_FAILED )
+        return nullptr;
+
+    // Lookups jump around the file, reading ahead would only waste memory.
+    madvise(data, info.st_size, MADV_RANDOM);
+
+    return std::shared_ptr<BreachAudit>(new BreachAudit(static_cast<const char*>(data), info.st_size));
+}
+
+
+size_t BreachAudit::lineStart(size_t pos) const
+{
+    while( (pos > 0) && (_data[pos - 1] != '\n') )
+        pos--;
+
+    return pos;
+}
+
+
+std::string_view BreachAudit::lineAt(size_t pos) const
+{
+    const char* end = static_cast<const char*>(std::memchr(_data + pos, '\n', _size - pos));
+
+
+    return std::string_view(_data + pos, (end ? end : _data + _size) - (_data + pos));
+}
+
+
+uint64_t BreachAudit::hashKey(std::string_view line)
+{
+    uint64_t key = 0;
+
+
+    for( size_t i = 0; i < 16; i++ )
+    {
+        const unsigned char c = (i < line.size()) ? line[i] : '0';
+
+
+        key = (key << 4) | (std::isdigit(c) ? (c - '0') : (std::isxdigit(c) ? (std::toupper(c) - 'A' + 10) : 0));
+    }
+
+    return key;
+}
+
+
+std::string BreachAudit::getHash(const Password& password)
+{
+    // Read straight from the snapshot, so auditing doesn't count as using the password.
+    const nlohmann::json hash = std::atomic_load(&password._snapshot)->getField("hash");
+
+
+    if( !hash.is_string() )
+        return "";
+
+    std::string upper;
+
+
+    for( unsigned char c : hash.get_ref<const std::string&>() )
+    {
+        if( !std::isxdigit(c) )
+            return "";
+
+        upper += std::toupper(c);
+    }
+
+    return upper;
+}
+
+
+uint64_t BreachAudit::lookup(const std::string& hash) const
+{
+    std::string target;
+
+
+    for( unsigned char c : hash )
+    {
+        if( !std::isxdigit(c) )
+            return 0;
+
+        target += std::toupper(c);
+    }
+
+    if( target.empty() || (target.size() > k_hashLength) )
+        return 0;
+
+    // Finds the first line that isn't ordered before the target.
+    // Probes alternate between the interpolated position of the target and the middle, so lookups in an evenly spread list
+    // take a handful of probes while a skewed list can't take more than twice as many as a plain binary search.
+    const uint64_t key = hashKey(target);
+
+    size_t   lo    = 0;
+    size_t   hi    = _size;
+    uint64_t keyLo = 0;
+    uint64_t keyHi = std::numeric_limits<uint64_t>::max();
+    bool     guess = true;
+
+
+    while( lo < hi )
+    {
+        size_t probe = lo + (hi - lo) / 2;
+
+
+        if( guess && (keyLo <= key) && (key < keyHi) )
+            probe = lo + static_cast<size_t>(static_cast<long double>(key - keyLo) / (keyHi - keyLo) * (hi - lo));
+
+        guess = !guess;
+        probe = lineStart(std::min(probe, hi - 1));
+
+        const std::string_view line = lineAt(probe);
+
+
+        if( line.substr(0, std::min(line.find(':'), target.size())) < target )
+        {
+            lo    = probe + line.size() + 1;
+            keyLo = hashKey(line);
+        }
+        else
+        {
+            hi    = probe;
+            keyHi = hashKey(line);
+        }
+    }
+
+    if( lo >= _size )
+        return 0;
+
+    const std::string_view line  = lineAt(lo);
+    const size_t           colon = line.find(':');
+    uint64_t               count = 1;
+
+
+    if( line.substr(0, std::min(colon, target.size())) != target )
+        return 0;
+
+    // A list without counts still marks the hash as breached.
+    if( colon != std::string_view::npos )
+        std::from_chars(line.data() + colon + 1, line.data() + line.size(), count);
+
+    return std::max<uint64_t>(count, 1);
+}
+
+
+BreachAudit::Report BreachAudit::audit(const std::shared_ptr<Session>& session, const CancellationToken& token)
+{
+    constexpr size_t batchSize = 256;
+
+    std::vector<std::shared_ptr<Password>> passwords;
+    std::vector<std::string>               hashes;
+    std::vector<uint64_t>                  counts;
+    std::vector<bool>                      checked;
+    Report                                 report = { {}, 0, 0, true };
+
+
+    for( const std::shared_ptr<Password>& passwd : Password::getAll() )
+    {
+        if( &passwd->getSession() != session.get() )
+            continue;
+
+        std::string hash = getHash(*passwd);
+
+
+        if( hash.empty() )
+        {
+            report.unaudited++;
+            continue;
+        }
+
+        passwords.push_back(passwd);
+        hashes.push_back(std::move(hash));
+    }
+
+    counts.resize(passwords.size());
+    checked.resize(passwords.size());
+
+    {
+        std::lock_guard lock(_mutex);
+
+
+        // Passwords that didn't change since they were last checked keep their outcome.
+        for( size_t i = 0; i < passwords.size(); i++ )
+        {
+            auto itr = _results.find(passwords[i].get());
+
+
+            if( (itr != _results.end()) && (itr->second.password.lock() == passwords[i]) && (itr->second.hash == hashes[i]) )
+            {
+                counts[i]  = itr->second.count;
+                checked[i] = true;
+            }
+        }
+    }
+
+    const size_t batches = (passwords.size() + batchSize - 1) / batchSize;
+    const size_t workers = std::min<size_t>(std::max(std::thread::hardware_concurrency(), 1u), batches);
+
+    std::atomic<size_t>      nextBatch = 0;
+    std::vector<std::thread> threads;
+    std::vector<char>        looked(passwords.size(), false); // Not a vector<bool>, the workers write to it concurrently.
+
+
+    auto worker = [&] ()
+      {
+          for( size_t batch = nextBatch++; (batch < batches) && !token.isCancelled(); batch = nextBatch++ )
+          {
+              for( size_t i = batch * batchSize; i < std::min(passwords.size(), (batch + 1) * batchSize); i++ )
+              {
+                  if( checked[i] )
+                      continue;
+
+                  counts[i] = lookup(hashes[i]);
+                  looked[i] = true;
+              }
+          }
+      };
+
+    // The calling thread takes part as well.
+    for( size_t i = 1; i < workers; i++ )
+        threads.emplace_back(worker);
+
+    worker();
+
+    for( std::thread& thread : threads )
+        thread.join();
+
+    std::lock_guard lock(_mutex);
+
+
+    // Drops the outcomes of passwords that are gone, their addresses can be reused.
+    for( auto itr = _results.begin(); itr != _results.end(); )
+    {
+        if( itr->second.password.expired() )
+            itr = _results.erase(itr);
+        else
+            itr++;
+    }
+
+    for( size_t i = 0; i < passwords.size(); i++ )
+    {
+        if( looked[i] )
+            _results[passwords[i].get()] = { passwords[i], hashes[i], counts[i] };
+
+        if( !checked[i] && !looked[i] )
+        {
+            report.complete = false;
+            continue;
+        }
+
+        report.audited++;
+
+        if( counts[i] > 0 )
+            report.breached.push_back({ passwords[i], counts[i] });
+    }
+
+    return report;
+}
+
+
+ChangeNotifier::SubscriptionID BreachAudit::watch(const std::shared_ptr<Session>& session, Callback callback, ChangeNotifier::Executor executor)
+{
+    return session->subscribe(
+      "hash", [audit = weak_from_this(), callback = std::move(callback)] (const ChangeEvent& event)
+      {
+          std::shared_ptr<BreachAudit> self = audit.lock();
+
+
+          if( !self )
+              return;
+
+          const std::string hash  = getHash(*event.password);
+          const uint64_t    count = hash.empty() ? 0 : self->lookup(hash);
+
+
+          {
+              std::lock_guard lock(self->_mutex);
+
+
+              if( hash.empty() )
+                  self->_results.erase(event.password.get());
+              else
+                  self->_results[event.password.get()] = { event.password, hash, count };
+          }
+
+          if( count > 0 )
+              callback({ event.password, count });
+      },
+      std::move(executor)
+      );
+}
+
+
+}
@@ -0,0 +1,100 @@
+/*
+ * ncpasscpp. A library that implements Nextcloud Password's API.
+ * Copyright (C) 2021  Reed Krantz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <CancellationToken.hpp>
+
+
+namespace ncpass
+{
+
+
+CancellationToken::Wakeup::Wakeup(const CancellationToken& token, std::function<void()> wake) :
+    _state(token._state)
+{
+    std::unique_lock lock(_state->mutex);
+
+
+    _itr = _state->wakeups.insert(_state->wakeups.end(), std::move(wake));
+}
+
+
+CancellationToken::Wakeup::~Wakeup()
+{
+    std::unique_lock lock(_state->mutex);
+
+
+    _state->wakeups.erase(_itr);
+}
+
+
+CancellationToken::CancellationToken() :
+    CancellationToken(std::chrono::steady_clock::time_point::max())
+{}
+
+
+CancellationToken::CancellationToken(std::chrono::steady_clock::time_point deadline) :
+    _state(std::make_shared<State>())
+{
+    _state->cancelled = false;
+    _state->urgent    = false;
+    _state->deadline  = deadline;
+}
+
+
+CancellationToken CancellationToken::after(std::chrono::milliseconds timeout) { return CancellationToken(std::chrono::steady_clock::now() + timeout); }
+
+
+void CancellationToken::cancel()
+{
+    std::unique_lock lock(_state->mutex);
+
+
+    _state->cancelled = true;
+
+    for( const std::function<void()>& wake : _state->wakeups )
+        wake();
+}
+
+
+bool CancellationToken::isCancelled() const { return _state->cancelled || (std::chrono::steady_clock::now() >= _state->deadline); }
+
+
+void CancellationToken::setUrgent()
+{
+    std::unique_lock lock(_state->mutex);
+
+
+    _state->urgent = true;
+
+    for( const std::function<void()>& wake : _state->wakeups )
+        wake();
+}
+
+
+bool CancellationToken::isUrgent() const { return _state->urgent; }
+
+
+std::chrono::steady_clock::time_point CancellationToken::getDeadline() const { return _state->deadline; }
+
+
+}
@@ -0,0 +1,120 @@
+/*
+ * ncpasscpp. A library that implements Nextcloud Password's API.
+ * Copyright (C) 2021  Reed Krantz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+#include <mutex>
+#include <shared_mutex>
+#include <utility>
+#include <ChangeNotifier.hpp>
+
+
+namespace ncpass
+{
+
+
+ChangeNotifier::ChangeNotifier() :
+    _nextID(1)
+{}
+
+
+ChangeNotifier::SubscriptionID ChangeNotifier::subscribe(const Password* password, const std::string& field, Callback callback, Executor executor)
+{
+    std::unique_lock lock(_mutex);
+    SubscriptionID   id = _nextID++;
+
+
+    _subscriptions.emplace(id, Subscription { password, field, std::move(callback), std::move(executor) });
+    _byPassword[password].push_back(id);
+
+    return id;
+}
+
+
+void ChangeNotifier::unsubscribe(SubscriptionID id)
+{
+    std::unique_lock lock(_mutex);
+    auto             itr = _subscriptions.find(id);
+
+
+    if( itr == _subscriptions.end() )
+        return;
+
+    std::vector<SubscriptionID>& ids = _byPassword.at(itr->second.password);
+
+
+    ids.erase(std::find(ids.begin(), ids.end(), id));
+
+    if( ids.empty() )
+        _byPassword.erase(itr->second.password);
+
+    _subscriptions.erase(itr);
+}
+
+
+void ChangeNotifier::notify(const ChangeEvent& event) const
+{
+    std::vector<std::pair<Callback, Executor>> observers;
+    std::vector<const Password*>               observed = { nullptr };
+
+
+    if( event.password )
+        observed.push_back(event.password.get());
+
+    {
+        std::shared_lock lock(_mutex);
+
+
+        // Only the subscriptions of the changed password and the whole Session are looked at.
+        for( const Password* password : observed )
+        {
+            auto itr = _byPassword.find(password);
+
+
+            if( itr == _byPassword.end() )
+                continue;
+
+            for( SubscriptionID id : itr->second )
+            {
+                const Subscription& subscription = _subscriptions.at(id);
+
+
+                if( subscription.field.empty() || (std::find(event.fields.begin(), event.fields.end(), subscription.field) != event.fields.end()) )
+                    observers.emplace_back(subscription.callback, subscription.executor);
+            }
+        }
+    }
+
+    if( observers.empty() )
+        return;
+
+    // Shared between the tasks so executors that run them later still have the event.
+    auto shared = std::make_shared<const ChangeEvent>(event);
+
+
+    for( auto& [callback, executor] : observers )
+    {
+        if( executor )
+            executor([callback = std::move(callback), shared] { callback(*shared); });
+        else
+            callback(*shared);
+    }
+}
+
+
+}
@@ -0,0 +1,462 @@
+/*
+ * ncpasscpp. A library that implements Nextcloud Password's API.
+ * Copyright (C) 2021  Reed Krantz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <system_error>
+#include <utility>
+#include <FaviconCache.hpp>
+#include "utils.hpp"
+
+
+namespace ncpass
+{
+
+
+/**
+ * @param image An image.
+ * @return A future that already holds the image.
+ */
+static std::shared_future<FaviconCache::Image> makeReady(const FaviconCache::Image& image)
+{
+    std::promise<FaviconCache::Image> promise;
+
+
+    promise.set_value(image);
+
+    return promise.get_future().share();
+}
+
+
+/**
+ * @param domain The domain of a website.
+ * @param size The size of the favicon in pixels.
+ * @return The service action of the favicon. The server only hands out sizes from 16 to 256 pixels.
+ */
+static std::string makeFaviconAction(const std::string& domain, int size) { return "favicon/" + domain + "/" + std::to_string(std::clamp(size, 16, 256)); }
+
+
+FaviconCache::FaviconCache(Source source) :
+    _source(std::move(source)),
+    _memoryUsage(0),
+    _memoryLimit(k_defaultMemoryLimit),
+    _diskUsage(0),
+    _diskLimit(0),
+    _stop(false)
+{}
+
+
+FaviconCache::~FaviconCache() { stop(); }
+
+
+std::string FaviconCache::getDomain(const std::string& url)
+{
+    std::string  domain = url;
+    const size_t scheme = domain.find("://");
+
+
+    if( scheme != std::string::npos )
+        domain.erase(0, scheme + 3);
+
+    domain.erase(std::min(domain.find_first_of("/?#"), domain.size()));
+
+    if( const size_t at = domain.rfind('@'); at != std::string::npos )
+        domain.erase(0, at + 1);
+
+    domain.erase(std::min(domain.find(':'), domain.size()));
+
+    while( !domain.empty() && (domain.back() == '.') )
+        domain.pop_back();
+
+    // The domain becomes part of the request path, so anything that would need escaping is rejected.
+    for( char& c : domain )
+    {
+        if( std::isalnum(static_cast<unsigned char>(c)) )
+            c = std::tolower(static_cast<unsigned char>(c));
+        else if( (c != '.') && (c != '-') && (c != '_') )
+            return "";
+    }
+
+    return domain;
+}
+
+
+void FaviconCache::trimMemory()
+{
+    while( (_memoryUsage > _memoryLimit) && !_lru.empty() )
+    {
+        auto itr = _memory.find(_lru.back());
+
+
+        _memoryUsage -= itr->first.size() + (itr->second.image ? itr->second.image->size() : 0);
+        _memory.erase(itr);
+        _lru.pop_back();
+    }
+}
+
+
+void FaviconCache::remember(const std::string& action, const Image& image)
+{
+    auto itr = _memory.find(action);
+
+
+    if( itr != _memory.end() )
+    {
+        _memoryUsage -= action.size() + (itr->second.image ? itr->second.image->size() : 0);
+        _lru.erase(itr->second.lru);
+        _memory.erase(itr);
+    }
+
+    _lru.push_front(action);
+    _memory[action] = { image, std::chrono::steady_clock::now(), _lru.begin() };
+    _memoryUsage   += action.size() + (image ? image->size() : 0);
+
+    trimMemory();
+}
+
+
+std::filesystem::path FaviconCache::getDiskPath(const std::string& action) const { return _directory / utils::SHA1(action); }
+
+
+FaviconCache::Image FaviconCache::readDisk(const std::string& action)
+{
+    std::unique_lock lock(_diskMutex);
+
+
+    if( _directory.empty() )
+        return nullptr;
+
+    const std::filesystem::path path = getDiskPath(action);
+    std::ifstream               file(path, std::ios::binary);
+    std::error_code             error;
+
+
+    if( !file )
+        return nullptr;
+
+    std::string image((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+
+    if( file.bad() || image.empty() )
+        return nullptr;
+
+    // The modification time orders the images for trimming.
+    std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), error);
+
+    return std::make_shared<const std::string>(std::move(image));
+}
+
+
+void FaviconCache::trimDisk()
+{
+    std::vector<std::pair<std::filesystem::file_time_type, std::filesystem::directory_entry>> files;
+    std::error_code                                                                           error;
+
+
+    _diskUsage = 0;
+
+    for( const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(_directory, error) )
+    {
+        if( !entry.is_regular_file(error) )
+            continue;
+
+        files.emplace_back(entry.last_write_time(error), entry);
+        _diskUsage += entry.file_size(error);
+    }
+
+    if( _diskUsage <= _diskLimit )
+        return;
+
+    std::sort(files.begin(), files.end(), [] (const auto& a, const auto& b) { return a.first < b.first; });
+
+    for( size_t i = 0; (i < files.size()) && (_diskUsage > _diskLimit); i++ )
+    {
+        const uintmax_t size = files[i].second.file_size(error);
+
+
+        if( std::filesystem::remove(files[i].second.path(), error) )
+            _diskUsage -= std::min<uintmax_t>(size, _diskUsage);
+    }
+}
+
+
+void FaviconCache::writeDisk(const std::string& action, const std::string& image)
+{
+    std::unique_lock lock(_diskMutex);
+
+
+    if( _directory.empty() || (image.size() > _diskLimit) )
+        return;
+
+    const std::filesystem::path path      = getDiskPath(action);
+    const std::filesystem::path temporary = path.string() + ".tmp";
+    std::error_code             error;
+
+
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+
+
+        // The image stays cached in memory, only the copy on the disk is lost (example: the disk is full).
+        // Checked after closing, since a buffered write only fails once it's flushed.
+        file.write(image.data(), image.size());
+        file.close();
+
+        if( !file )
+        {
+            std::filesystem::remove(temporary, error);
+            return;
+        }
+    }
+
+    // Readers never see a half written image.
+    std::filesystem::rename(temporary, path, error);
+
+    if( error )
+    {
+        std::filesystem::remove(temporary, error);
+        return;
+    }
+
+    _diskUsage += image.size();
+
+    if( _diskUsage > _diskLimit )
+        trimDisk();
+}
+
+
+void FaviconCache::work()
+{
+    std::unique_lock lock(_mutex);
+
+
+    while( !_stop )
+    {
+        std::deque<std::string>& queue = !_interactive.empty() ? _interactive : _prefetch;
+
+
+        if( queue.empty() )
+        {
+            _jobConVar.wait(lock);
+            continue;
+        }
+
+        const std::string action = std::move(queue.front());
+
+
+        queue.pop_front();
+
+        auto job = _jobs.find(action);
+
+
+        // A prefetched job that was asked for in the meantime is queued twice, the second time it's already taken.
+        if( (job == _jobs.end()) || job->second.started )
+            continue;
+
+        job->second.started = true;
+
+        const RequestLimiter::Priority priority = job->second.interactive ? RequestLimiter::INTERACTIVE : RequestLimiter::BULK;
+
+        lock.unlock();
+
+        Image image = readDisk(action);
+
+
+        if( !image )
+        {
+            std::optional<std::string> downloaded = _source(action, priority, _stopToken);
+
+
+            if( downloaded && !downloaded->empty() )
+            {
+                writeDisk(action, *downloaded);
+                image = std::make_shared<const std::string>(std::move(*downloaded));
+            }
+        }
+
+        lock.lock();
+
+        // A download aborted by stopping isn't the server's fault, so it's not remembered as failed.
+        if( image || !_stopToken.isCancelled() )
+            remember(action, image);
+
+        job = _jobs.find(action);
+        job->second.promise.set_value(image);
+        _jobs.erase(job);
+    }
+}
+
+
+std::shared_future<FaviconCache::Image> FaviconCache::request(const std::string& action, bool interactive)
+{
+    std::unique_lock lock(_mutex);
+    auto             cached = _memory.find(action);
+
+
+    // Images that couldn't be downloaded aren't asked for again for a while, so a list that's redrawn doesn't flood the server.
+    if( (cached != _memory.end()) && (cached->second.image || (std::chrono::steady_clock::now() - cached->second.failedAt < k_retryDelay)) )
+    {
+        _lru.splice(_lru.begin(), _lru, cached->second.lru);
+
+        return makeReady(cached->second.image);
+    }
+
+    auto job = _jobs.find(action);
+
+
+    if( job != _jobs.end() )
+    {
+        // Someone is waiting for a prefetched image now, so it skips the line.
+        if( interactive && !job->second.interactive && !job->second.started )
+        {
+            job->second.interactive = true;
+            _interactive.push_back(action);
+            _jobConVar.notify_one();
+        }
+
+        return job->second.future;
+    }
+
+    if( _stop )
+        return makeReady(nullptr);
+
+    Job& added = _jobs[action];
+
+
+    added.future      = added.promise.get_future().share();
+    added.interactive = interactive;
+    added.started     = false;
+
+    (interactive ? _interactive : _prefetch).push_back(action);
+
+    while( _workers.size() < k_workerCount )
+        _workers.emplace_back(&FaviconCache::work, this);
+
+    _jobConVar.notify_one();
+
+    return added.future;
+}
+
+
+void FaviconCache::setMemoryLimit(size_t bytes)
+{
+    std::unique_lock lock(_mutex);
+
+
+    _memoryLimit = bytes;
+
+    trimMemory();
+}
+
+
+bool FaviconCache::setDiskCache(const std::string& directory, size_t bytes)
+{
+    std::unique_lock lock(_diskMutex);
+    std::error_code  error;
+
+
+    _directory.clear();
+
+    if( directory.empty() )
+        return true;
+
+    std::filesystem::create_directories(directory, error);
+
+    if( !std::filesystem::is_directory(directory, error) )
+        return false;
+
+    _directory = directory;
+    _diskLimit = bytes;
+
+    trimDisk();
+
+    return true;
+}
+
+
+std::shared_future<FaviconCache::Image> FaviconCache::getFavicon(const std::string& url, int size)
+{
+    const std::string domain = getDomain(url);
+
+
+    if( domain.empty() )
+        return makeReady(nullptr);
+
+    return request(makeFaviconAction(domain, size), true);
+}
+
+
+std::shared_future<FaviconCache::Image> FaviconCache::getPreview(const std::string& url, bool mobile, int width, int height)
+{
+    const std::string domain = getDomain(url);
+
+
+    if( domain.empty() )
+        return makeReady(nullptr);
+
+    return request("preview/" + domain + "/" + (mobile ? "mobile" : "desktop") + "/" + std::to_string(std::max(width, 1)) + "/" + std::to_string(std::max(height, 1)), true);
+}
+
+
+void FaviconCache::prefetchFavicons(const std::vector<std::string>& urls, int size)
+{
+    for( const std::string& url : urls )
+    {
+        const std::string domain = getDomain(url);
+
+
+        if( !domain.empty() )
+            request(makeFaviconAction(domain, size), false);
+    }
+}
+
+
+void FaviconCache::stop()
+{
+    {
+        std::unique_lock lock(_mutex);
+
+
+        _stop = true;
+        _stopToken.cancel();
+        _jobConVar.notify_all();
+    }
+
+    for( std::thread& worker : _workers )
+    {
+        if( worker.joinable() )
+            worker.join();
+    }
+
+    std::unique_lock lock(_mutex);
+
+
+    // Jobs no worker got to.
+    for( auto& [action, job] : _jobs )
+        job.promise.set_value(nullptr);
+
+    _jobs.clear();
+    _interactive.clear();
+    _prefetch.clear();
+}
+
+
+}
@@ -0,0 +1,226 @@
+/*
+ * ncpasscpp. A library that implements Nextcloud Password's API.
+ * Copyright (C) 2021  Reed Krantz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <future>
+#include <memory>
+#include <shared_mutex>
+#include <stdexcept>
+#include <thread>
+#include <Folder.hpp>
+#include <nlohmann/json.hpp>
+#include <Session.hpp>
+#include "API_Implementor.cpp"
+#include "utils.hpp"
+
+
+namespace ncpass
+{
+
+
+void Folder::merge(const nlohmann::json& json_new)
+{
+    _json.merge_patch(json_new);
+
+    const std::string parent = _json.value("parent", "");
+
+
+    if( auto folder = weak_from_this().lock() )
+    {
+        getSession()._relations.setFolder(folder, _json.at("id"), _indexedParent, parent);
+        _indexedParent = parent;
+    }
+
+    setMemoryUsage(MemoryAccount::PAYLOADS, utils::jsonSize(_json));
+    _pullFailed = false;
+    _updateConVar.notify_all();
+}
+
+
+Folder::Folder(const std::shared_ptr<Session>& session, const nlohmann::json& folder_json) :
+    _Base(session, "folder"),
+    _json(folder_json),
+    _pullFailed(false),
+    _decryptionFailed(false)
+{}
+
+
+void Folder::pull()
+{
+    std::thread t1([folder = shared_from_this()] ()
+      {
+          nlohmann::json apiArgs;
+
+
+          apiArgs["id"] = folder->getID();
+
+          nlohmann::json json_new = folder->apiCall(POST, "show", apiArgs);
+
+
+          if( (json_new.value("id", "") == apiArgs.at("id")) && json_new.contains("revision") )
+          {
+              std::unique_lock memberLock(folder->_memberMutex);
+              folder->merge(json_new);
+          }
+          else
+          {
+              std::unique_lock memberLock(folder->_memberMutex);
+
+              folder->_pullFailed = true;
+              folder->_updateConVar.notify_all();
+          }
+      }
+      );
+
+
+    t1.detach();
+}
+
+
+std::shared_ptr<Folder> Folder::fetch(const std::shared_ptr<Session>& session, const std::string& id)
+{
+    nlohmann::json json;
+
+
+    json["id"] = id;
+
+    std::shared_ptr<Folder> toReturn = (new Folder(session, json))->registerInstance();
+
+
+    toReturn->pull();
+
+    return toReturn;
+}
+
+
+std::future<std::vector<std::shared_ptr<Folder>>> Folder::fetchAll(const std::shared_ptr<Session>& session)
+{
+    return std::async(
+      std::launch::async, [session] ()
+      {
+          std::vector<std::shared_ptr<Folder>> folders;
+          nlohmann::json json_list = _Base::apiCall(*session, "folder/", POST, "list", nlohmann::json::object());
+
+
+          if( !json_list.is_array() )
+              throw std::runtime_error("The server didn't return a list of folders.");
+
+          for( const nlohmann::json& json_new : json_list )
+          {
+              if( !json_new.contains("id") )
+                  continue;
+
+              nlohmann::json json_id;
+
+
+              json_id["id"] = json_new.at("id");
+
+              std::shared_ptr<Folder> folder = (new Folder(session, json_id))->registerInstance();
+
+              {
+                  std::unique_lock memberLock(folder->_memberMutex);
+                  folder->merge(json_new);
+              }
+
+              folders.push_back(folder);
+          }
+
+          return folders;
+      }
+      );
+}
+
+
+std::vector<std::shared_ptr<Folder>> Folder::getAll() { return _Base::getRegistered(); }
+
+
+MemoryUsage Folder::getMemoryUsage() { return _Base::getTypeMemoryUsage(); }
+
+
+std::string Folder::getField(const std::string& key) const
+{
+    std::shared_lock lock(_memberMutex);
+
+
+    _updateConVar.wait(lock, [this, &key] { return _json.contains(key) || _pullFailed; });
+
+    if( !_json.contains(key) )
+        return "";
+
+    if( _json.value("cseType", "none") == "none" )
+        return _json.at(key);
+
+    const std::string cipher = _json.at(key);
+    const std::string keyID  = _json.value("cseKey", "");
+
+
+    lock.unlock();
+
+    std::optional<std::string> plain = getSession()._keychain.decrypt(keyID, cipher);
+
+
+    _decryptionFailed = !plain;
+
+    return plain.value_or("");
+}
+
+
+std::string Folder::getID() const
+{
+    std::shared_lock lock(_memberMutex);
+
+
+    return _json.at("id");
+}
+
+
+bool Folder::hasDecryptionFailed() const { return _decryptionFailed; }
+
+
+bool Folder::hasPullFailed() const
+{
+    std::shared_lock lock(_memberMutex);
+
+
+    return _pullFailed;
+}
+
+
+std::string Folder::getLabel() const { return getField("label"); }
+
+
+std::shared_ptr<Folder> Folder::getParent() const
+{
+    std::shared_lock lock(_memberMutex);
+
+
+    _updateConVar.wait(lock, [this] { return _json.contains("parent") || _pullFailed; });
+
+    if( !_json.contains("parent") || (_json.at("parent") == _json.at("id")) )
+        return nullptr;
+
+    return getSession()._relations.getFolder(_json.at("parent"));
+}
+
+
+std::vector<std::shared_ptr<Folder>> Folder::getFolders() const { return getSession()._relations.getFolderFolders(getID()); }
+
+
+std::vector<std::shared_ptr<Password>> Folder::getPasswords() const { return getSession()._relations.getFolderPasswords(getID()); }
+
+
+}
@@ -0,0 +1,157 @@
+/*
+ * ncpasscpp. A library that implements Nextcloud Password's API.
+ * Copyright (C) 2021  Reed Krantz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <cctype>
+#include <mutex>
+#include <shared_mutex>
+#include <HealthIndex.hpp>
+
+
+namespace ncpass
+{
+
+
+bool HealthIndex::Entry::operator==(const Entry& other) const { return (hash == other.hash) && (edited == other.edited) && (status == other.status); }
+
+
+bool HealthIndex::Entry::operator!=(const Entry& other) const { return !(*this == other); }
+
+
+std::string HealthIndex::toHashKey(const std::string& hash)
+{
+    std::string key = hash.substr(0, k_hashKeyLength);
+
+
+    for( char& c : key )
+        c = std::tolower(static_cast<unsigned char>(c));
+
+    return key;
+}
+
+
+template <class Index, class Key>
+void HealthIndex::move(Index& members, const std::shared_ptr<Password>& password, const Key& oldKey, const Key& newKey, const Key& none)
+{
+    if( oldKey != none )
+    {
+        auto itr = members.find(oldKey);
+
+
+        if( itr != members.end() )
+        {
+            itr->second.erase(password);
+
+            if( itr->second.empty() )
+                members.erase(itr);
+        }
+    }
+
+    if( newKey != none )
+        members[newKey].insert(password);
+}
+
+
+void HealthIndex::setPassword(const std::shared_ptr<Password>& password, const Entry& oldEntry, const Entry& newEntry)
+{
+    std::unique_lock lock(_mutex);
+
+
+    if( oldEntry.hash != newEntry.hash )
+    {
+        move(_byHash, password, oldEntry.hash, newEntry.hash, std::string());
+
+        for( const std::string& hash : { oldEntry.hash, newEntry.hash } )
+        {
+            auto itr = _byHash.find(hash);
+
+
+            if( (itr != _byHash.end()) && (itr->second.size() > 1) )
+                _reused.insert(hash);
+            else
+                _reused.erase(hash);
+        }
+    }
+
+    if( oldEntry.edited != newEntry.edited )
+        move(_byEdited, password, oldEntry.edited, newEntry.edited, int64_t(0));
+
+    if( oldEntry.status != newEntry.status )
+        move(_byStatus, password, oldEntry.status, newEntry.status, std::string());
+}
+
+
+std::vector<std::vector<std::shared_ptr<Password>>> HealthIndex::getReused() const
+{
+    std::shared_lock                                    lock(_mutex);
+    std::vector<std::vector<std::shared_ptr<Password>>> groups;
+
+
+    groups.reserve(_reused.size());
+
+    for( const std::string& hash : _reused )
+    {
+        const Members& members = _byHash.at(hash);
+
+
+        groups.emplace_back(members.begin(), members.end());
+    }
+
+    return groups;
+}
+
+
+std::vector<std::shared_ptr<Password>> HealthIndex::getByHash(const std::string& hash) const
+{
+    std::shared_lock lock(_mutex);
+    auto             itr = _byHash.find(toHashKey(hash));
+
+
+    if( itr == _byHash.end() )
+        return {};
+
+    return std::vector<std::shared_ptr<Password>>(itr->second.begin(), itr->second.end());
+}
+
+
+std::vector<std::shared_ptr<Password>> HealthIndex::getEditedBefore(int64_t time) const
+{
+    std::shared_lock                       lock(_mutex);
+    std::vector<std::shared_ptr<Password>> passwords;
+
+
+    for( auto itr = _byEdited.begin(); (itr != _byEdited.end()) && (itr->first < time); itr++ )
+        passwords.insert(passwords.end(), itr->second.begin(), itr->second.end());
+
+    return passwords;
+}
+
+
+std::vector<std::shared_ptr<Password>> HealthIndex::getByStatus(const std::string& status) const
+{
+    std::shared_lock lock(_mutex);
+    auto             itr = _byStatus.find(status);
+
+
+    if( itr == _byStatus.end() )
+        return {};
+
+    return std::vector<std::shared_ptr<Password>>(itr->second.begin(), itr->second.end());
+}
+
+
+}
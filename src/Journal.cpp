@@ -0,0 +1,379 @@
+/*
+ * ncpasscpp. A library that implements Nextcloud Password's API.
+ * Copyright (C) 2021  Reed Krantz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <stdexcept>
+#include <fcntl.h>
+#include <Journal.hpp>
+#include <sodium.h>
+#include <unistd.h>
+#include "utils.hpp"
+
+
+namespace ncpass
+{
+
+
+/**
+ * @brief Writes a whole buffer to a file descriptor.
+ * @param fd The file descriptor.
+ * @param data The data to write.
+ * @return True if everything was written.
+ */
+static bool writeAll(int fd, const std::string& data)
+{
+    size_t offset = 0;
+
+
+    while( offset < data.size() )
+    {
+        ssize_t written = ::write(fd, data.data() + offset, data.size() - offset);
+
+        if( written < 0 )
+            return false;
+
+        offset += written;
+    }
+
+    return true;
+}
+
+
+Journal::Journal() :
+    _key(nullptr, sodium_free),
+    _fd(-1),
+    _appended(0),
+    _written(0),
+    _failed(false),
+    _stop(false)
+{
+    if( sodium_init() < 0 )
+        throw std::runtime_error("libsodium couldn't be initialized.");
+}
+
+
+Journal::~Journal() { close(); }
+
+
+std::string Journal::seal(const nlohmann::json& record) const
+{
+    std::string    plain  = record.dump();
+    std::string    cipher(crypto_secretbox_NONCEBYTES + crypto_secretbox_MACBYTES + plain.size(), '\0');
+    unsigned char* nonce  = (unsigned char*)cipher.data();
+
+
+    randombytes_buf(nonce, crypto_secretbox_NONCEBYTES);
+    crypto_secretbox_easy(nonce + crypto_secretbox_NONCEBYTES, (const unsigned char*)plain.data(), plain.size(), nonce, _key.get());
+    sodium_memzero(plain.data(), plain.size());
+
+    return utils::binToHex(cipher);
+}
+
+
+nlohmann::json Journal::unseal(const std::string& line) const
+{
+    std::optional<std::string> cipher = utils::hexToBin(line);
+
+
+    if( !cipher || (cipher->size() < crypto_secretbox_NONCEBYTES + crypto_secretbox_MACBYTES) )
+        return nlohmann::json(nlohmann::json::value_t::discarded);
+
+    const unsigned char* nonce   = (const unsigned char*)cipher->data();
+    const size_t         boxSize = cipher->size() - crypto_secretbox_NONCEBYTES;
+
+    std::string plain(boxSize - crypto_secretbox_MACBYTES, '\0');
+
+
+    if( crypto_secretbox_open_easy((unsigned char*)plain.data(), nonce + crypto_secretbox_NONCEBYTES, boxSize, nonce, _key.get()) != 0 )
+        return nlohmann::json(nlohmann::json::value_t::discarded);
+
+    nlohmann::json record = nlohmann::json::parse(plain, nullptr, false);
+
+
+    sodium_memzero(plain.data(), plain.size());
+
+    return record;
+}
+
+
+std::optional<std::map<std::string, nlohmann::json>> Journal::open(const std::string& path, const std::string& passphrase)
+{
+    std::map<std::string, nlohmann::json> pending;
+    std::string                           salt;
+    std::string                           check;
+    std::ifstream                         file(path);
+    std::string                           line;
+
+
+    close();
+
+    if( !file && (::access(path.c_str(), F_OK) == 0) )
+        return std::nullopt;
+
+    // The header holds the salt of the key and the sealed check record. A new journal gets a new salt.
+    if( file && std::getline(file, line) )
+    {
+        const std::string prefix = std::string(k_magic) + " ";
+        const size_t      space  = line.find(' ', prefix.size());
+
+
+        // Anything else is left alone rather than replaced by an empty journal.
+        if( (line.rfind(prefix, 0) != 0) || (space == std::string::npos) || (space + 1 == line.size()) )
+            return std::nullopt;
+
+        std::optional<std::string> fileSalt = utils::hexToBin(line.substr(prefix.size(), space - prefix.size()));
+
+
+        if( !fileSalt || (fileSalt->size() != crypto_pwhash_SALTBYTES) )
+            return std::nullopt;
+
+        salt  = *fileSalt;
+        check = line.substr(space + 1);
+    }
+    else if( file.bad() || (file.is_open() && !file.eof()) )
+    {
+        return std::nullopt;
+    }
+    else
+    {
+        salt.resize(crypto_pwhash_SALTBYTES);
+        randombytes_buf(salt.data(), salt.size());
+    }
+
+    _key.reset((unsigned char*)sodium_malloc(crypto_secretbox_KEYBYTES));
+
+    if( !_key || crypto_pwhash(_key.get(), crypto_secretbox_KEYBYTES, passphrase.c_str(), passphrase.size(), (const unsigned char*)salt.data(),
+                               crypto_pwhash_OPSLIMIT_INTERACTIVE, crypto_pwhash_MEMLIMIT_INTERACTIVE, crypto_pwhash_ALG_DEFAULT) != 0 )
+    {
+        _key.reset();
+        return std::nullopt;
+    }
+
+    // The check record tells a wrong passphrase apart from a damaged record, even if the journal holds no records.
+    if( !check.empty() && !(unseal(check) == nlohmann::json(k_checkRecord)) )
+    {
+        _key.reset();
+        return std::nullopt;
+    }
+
+    while( std::getline(file, line) )
+    {
+        nlohmann::json record = unseal(line);
+
+
+        if( record.is_discarded() || !record.is_object() )
+        {
+            // A crash while appending can only tear the last record. A damaged record before it means the journal can't be trusted.
+            if( file.peek() != std::ifstream::traits_type::eof() )
+            {
+                _key.reset();
+                return std::nullopt;
+            }
+
+            break;
+        }
+
+        const std::string key  = record.value("key", "");
+        const std::string type = record.value("type", "");
+
+
+        if( type == "edit" )
+        {
+            pending[key].merge_patch(record.value("patch", nlohmann::json::object()));
+        }
+        else if( type == "created" )
+        {
+            // Edits of the created password can only be pushed with its ID.
+            auto itr = pending.find(key);
+
+            if( itr != pending.end() )
+            {
+                pending[record.value("id", "")].merge_patch(itr->second);
+                pending.erase(key);
+            }
+        }
+        else if( type == "synced" )
+        {
+            pending.erase(key);
+        }
+    }
+
+    file.close();
+
+    // Compact the journal by writing only what's still pending to a new file and replacing the old one.
+    const std::string tmpPath = path + ".tmp";
+
+    int fd = ::open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+
+
+    if( fd < 0 )
+    {
+        _key.reset();
+        return std::nullopt;
+    }
+
+    std::string data = std::string(k_magic) + " " + utils::binToHex(salt) + " " + seal(k_checkRecord) + "\n";
+
+    for( const auto& [key, patch] : pending )
+        data += seal({ { "type", "edit" }, { "key", key }, { "patch", patch } }) + "\n";
+
+    if( !writeAll(fd, data) || (::fsync(fd) != 0) || (::rename(tmpPath.c_str(), path.c_str()) != 0) )
+    {
+        ::close(fd);
+        _key.reset();
+        return std::nullopt;
+    }
+
+    ::close(fd);
+
+    std::unique_lock lock(_mutex);
+
+
+    _fd = ::open(path.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
+
+    if( _fd < 0 )
+    {
+        _key.reset();
+        return std::nullopt;
+    }
+
+    _failed = false;
+    _stop   = false;
+    _writer = std::thread(&Journal::writeLoop, this);
+
+    return pending;
+}
+
+
+bool Journal::isOpen() const
+{
+    std::unique_lock lock(_mutex);
+
+
+    return _fd >= 0;
+}
+
+
+void Journal::append(const nlohmann::json& record)
+{
+    std::unique_lock lock(_mutex);
+
+
+    if( _fd < 0 )
+        return;
+
+    _queue.push_back(seal(record));
+    _appended++;
+
+    _queuedConVar.notify_one();
+}
+
+
+bool Journal::flush()
+{
+    std::unique_lock lock(_mutex);
+    const unsigned long target = _appended;
+
+
+    _writtenConVar.wait(lock, [this, target] { return (_written >= target) || (_fd < 0) || _failed; });
+
+    return !_failed;
+}
+
+
+void Journal::writeLoop()
+{
+    std::unique_lock lock(_mutex);
+
+
+    while( true )
+    {
+        _queuedConVar.wait(lock, [this] { return (!_queue.empty() && !_failed) || _stop; });
+
+        if( (_queue.empty() || _failed) && _stop )
+            return;
+
+        // Give records appended around the same time a chance to share the sync.
+        if( !_stop )
+        {
+            lock.unlock();
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            lock.lock();
+        }
+
+        std::vector<std::string> batch;
+        std::string              data;
+
+
+        batch.swap(_queue);
+
+        const unsigned long batchEnd = _written + batch.size();
+
+        lock.unlock();
+
+        for( const std::string& line : batch )
+            data += line + "\n";
+
+        const bool synced = writeAll(_fd, data) && (::fdatasync(_fd) == 0);
+
+
+        lock.lock();
+
+        // The records stay queued, they only count as written once they're on the disk.
+        if( !synced )
+        {
+            _queue.insert(_queue.begin(), std::make_move_iterator(batch.begin()), std::make_move_iterator(batch.end()));
+            _failed = true;
+        }
+        else
+        {
+            _written = batchEnd;
+        }
+
+        _writtenConVar.notify_all();
+    }
+}
+
+
+void Journal::close()
+{
+    {
+        std::unique_lock lock(_mutex);
+
+        if( _fd < 0 )
+            return;
+
+        _stop = true;
+        _queuedConVar.notify_one();
+    }
+
+    _writer.join();
+
+    std::unique_lock lock(_mutex);
+
+
+    ::close(_fd);
+    _fd = -1;
+    _writtenConVar.notify_all();
+}
+
+
+}
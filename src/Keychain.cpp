@@ -0,0 +1,275 @@
+/*
+ * ncpasscpp. A library that implements Nextcloud Password's API.
+ * Copyright (C) 2021  Reed Krantz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <vector>
+#include <Keychain.hpp>
+#include <sodium.h>
+#include "utils.hpp"
+
+
+namespace ncpass
+{
+
+
+Keychain::Unlocking::Unlocking(Keychain& keychain) :
+    _keychain(keychain)
+{
+    std::unique_lock lock(_keychain._mutex);
+
+
+    _keychain._unlocking++;
+}
+
+
+Keychain::Unlocking::~Unlocking()
+{
+    std::unique_lock lock(_keychain._mutex);
+
+
+    _keychain._unlocking--;
+    _keychain._unlockedConVar.notify_all();
+}
+
+
+Keychain::Keychain() :
+    _unlocking(0)
+{
+    // Safe to call more than once and from multiple threads.
+    if( sodium_init() < 0 )
+        throw std::runtime_error("libsodium couldn't be initialized.");
+}
+
+
+std::optional<std::string> Keychain::open(const std::string& cipher, const unsigned char* key)
+{
+    if( cipher.size() < crypto_secretbox_NONCEBYTES + crypto_secretbox_MACBYTES )
+        return std::nullopt;
+
+    const unsigned char* nonce = (const unsigned char*)cipher.data();
+    const unsigned char* box   = nonce + crypto_secretbox_NONCEBYTES;
+    const size_t         boxSize = cipher.size() - crypto_secretbox_NONCEBYTES;
+
+    std::string plain(boxSize - crypto_secretbox_MACBYTES, '\0');
+
+
+    if( crypto_secretbox_open_easy((unsigned char*)plain.data(), box, boxSize, nonce, key) != 0 )
+        return std::nullopt;
+
+    return plain;
+}
+
+
+std::optional<std::string> Keychain::solveChallenge(const nlohmann::json& challenge, const std::string& masterPassword)
+{
+    // The challenge comes from the server, values of the wrong type are rejected rather than thrown on.
+    if( !challenge.is_object() || (challenge.value("type", nlohmann::json()) != "PWDv1r1") || !challenge.contains("salts") || !challenge.at("salts").is_array() ||
+        (challenge.at("salts").size() != 3) )
+        return std::nullopt;
+
+    for( const nlohmann::json& salt : challenge.at("salts") )
+    {
+        if( !salt.is_string() )
+            return std::nullopt;
+    }
+
+    std::optional<std::string> passwordSalt     = utils::hexToBin(challenge.at("salts").at(0));
+    std::optional<std::string> genericHashKey   = utils::hexToBin(challenge.at("salts").at(1));
+    std::optional<std::string> passwordHashSalt = utils::hexToBin(challenge.at("salts").at(2));
+
+
+    if( !passwordSalt || !genericHashKey || !passwordHashSalt || (passwordHashSalt->size() != crypto_pwhash_SALTBYTES) ||
+        (genericHashKey->size() > crypto_generichash_KEYBYTES_MAX) )
+        return std::nullopt;
+
+    std::string genericHash(crypto_generichash_BYTES_MAX, '\0');
+    std::string passwordHash(crypto_box_SEEDBYTES, '\0');
+    std::string salted = masterPassword + *passwordSalt;
+
+
+    crypto_generichash((unsigned char*)genericHash.data(), genericHash.size(), (const unsigned char*)salted.data(), salted.size(),
+                       (const unsigned char*)genericHashKey->data(), genericHashKey->size());
+    sodium_memzero(salted.data(), salted.size());
+
+    const int failed = crypto_pwhash((unsigned char*)passwordHash.data(), passwordHash.size(), genericHash.data(), genericHash.size(),
+                                     (const unsigned char*)passwordHashSalt->data(), crypto_pwhash_OPSLIMIT_INTERACTIVE, crypto_pwhash_MEMLIMIT_INTERACTIVE,
+                                     crypto_pwhash_ALG_DEFAULT);
+
+
+    sodium_memzero(genericHash.data(), genericHash.size());
+
+    if( failed )
+        return std::nullopt;
+
+    std::string solution = utils::binToHex(passwordHash);
+
+
+    sodium_memzero(passwordHash.data(), passwordHash.size());
+
+    return solution;
+}
+
+
+bool Keychain::unlock(const nlohmann::json& keychain_json, const std::string& masterPassword)
+{
+    Unlocking unlocking(*this);
+
+
+    if( !keychain_json.contains(k_type) || !keychain_json.at(k_type).is_string() )
+        return false;
+
+    std::optional<std::string> encrypted = utils::hexToBin(keychain_json.at(k_type));
+
+
+    if( !encrypted || (encrypted->size() < crypto_pwhash_SALTBYTES) )
+        return false;
+
+    SecureKey masterKey((unsigned char*)sodium_malloc(crypto_box_SEEDBYTES), sodium_free);
+
+
+    // The keychain is encrypted with a key derived from the master password and the salt in front of it.
+    if( !masterKey || crypto_pwhash(masterKey.get(), crypto_box_SEEDBYTES, masterPassword.c_str(), masterPassword.size(), (const unsigned char*)encrypted->data(),
+                      crypto_pwhash_OPSLIMIT_INTERACTIVE, crypto_pwhash_MEMLIMIT_INTERACTIVE, crypto_pwhash_ALG_DEFAULT) != 0 )
+        return false;
+
+    std::optional<std::string> plain = open(encrypted->substr(crypto_pwhash_SALTBYTES), masterKey.get());
+
+
+    sodium_memzero(masterKey.get(), crypto_box_SEEDBYTES);
+
+    if( !plain )
+        return false;
+
+    nlohmann::json json_keys = nlohmann::json::parse(*plain, nullptr, false);
+    std::unordered_map<std::string, SecureKey> keys;
+
+
+    sodium_memzero(plain->data(), plain->size());
+
+    if( !json_keys.is_object() || !json_keys.contains("keys") || !json_keys.at("keys").is_object() || !json_keys.contains("current") || !json_keys.at("current").is_string() )
+    {
+        utils::secureWipe(json_keys);
+        return false;
+    }
+
+    for( auto& [id, hexKey] : json_keys.at("keys").items() )
+    {
+        // A keychain from a newer or broken client may hold other values, they are no keys this client can use.
+        if( !hexKey.is_string() )
+            continue;
+
+        SecureKey key((unsigned char*)sodium_malloc(crypto_secretbox_KEYBYTES), sodium_free);
+        std::string& hex = hexKey.get_ref<std::string&>();
+        size_t       keySize = 0;
+
+
+        // A keychain missing a key would look unlocked while the passwords encrypted with it can't be decrypted.
+        if( !key )
+        {
+            utils::secureWipe(json_keys);
+            return false;
+        }
+
+        if( sodium_hex2bin(key.get(), crypto_secretbox_KEYBYTES, hex.c_str(), hex.size(), nullptr, &keySize, nullptr) == 0 && (keySize == crypto_secretbox_KEYBYTES) )
+            keys.emplace(id, std::move(key));
+
+        sodium_memzero(hex.data(), hex.size());
+    }
+
+    {
+        std::unique_lock lock(_mutex);
+
+        _keys    = std::move(keys);
+        _current = json_keys.at("current");
+    }
+
+    _unlockedConVar.notify_all();
+
+    return true;
+}
+
+
+void Keychain::lock()
+{
+    std::unique_lock lock(_mutex);
+
+
+    for( auto& [id, key] : _keys )
+        sodium_memzero(key.get(), crypto_secretbox_KEYBYTES);
+
+    _keys.clear();
+    _current.clear();
+
+    _unlockedConVar.notify_all();
+}
+
+
+bool Keychain::isUnlocked() const
+{
+    std::shared_lock lock(_mutex);
+
+
+    return !_keys.empty();
+}
+
+
+std::optional<std::string> Keychain::decrypt(const std::string& keyID, const std::string& cipher, const CancellationToken& token) const
+{
+    std::optional<std::string> bin = utils::hexToBin(cipher);
+    std::shared_lock           lock(_mutex);
+
+
+    if( !bin )
+        return std::nullopt;
+
+    // Only an unlock that's under way is waited for, nothing would ever wake up a thread waiting on a locked keychain.
+    if( !token.wait(_unlockedConVar, lock, [this] { return !_keys.empty() || (_unlocking == 0); }) )
+        return std::nullopt;
+
+    auto itr = _keys.find(keyID);
+
+
+    if( itr == _keys.end() )
+        return std::nullopt;
+
+    return open(*bin, itr->second.get());
+}
+
+
+std::optional<std::string> Keychain::encrypt(const std::string& plain, std::string& keyID, const CancellationToken& token) const
+{
+    std::string      cipher(crypto_secretbox_NONCEBYTES + crypto_secretbox_MACBYTES + plain.size(), '\0');
+    unsigned char*   nonce = (unsigned char*)cipher.data();
+    std::shared_lock lock(_mutex);
+
+
+    if( !token.wait(_unlockedConVar, lock, [this] { return !_keys.empty() || (_unlocking == 0); }) || !_keys.count(_current) )
+        return std::nullopt;
+
+    randombytes_buf(nonce, crypto_secretbox_NONCEBYTES);
+    crypto_secretbox_easy(nonce + crypto_secretbox_NONCEBYTES, (const unsigned char*)plain.data(), plain.size(), nonce, _keys.at(_current).get());
+
+    keyID = _current;
+
+    return utils::binToHex(cipher);
+}
+
+
+}
@@ -16,33 +16,33 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
-#pragma once
-#include <iomanip>
-#include <sstream>
-#include <string>
-#include <openssl/sha.h>
+#include <atomic>
+#include <MemoryAccount.hpp>
 
 
-namespace ncpass::utils
+namespace ncpass
 {
 
 
-static std::string SHA1(const std::string& input)
-{
-    unsigned char pwdHash[SHA_DIGEST_LENGTH];
+size_t MemoryUsage::total() const { return objects + payloads + pending + transport; }
 
 
-    ::SHA1((const unsigned char*)input.c_str(), input.size(), pwdHash);
+MemoryAccount::MemoryAccount()
+{
+    for( std::atomic<size_t>& bytes : _bytes )
+        bytes = 0;
+}
 
-    std::stringstream sstring;
 
+void MemoryAccount::add(Category category, size_t bytes) { _bytes[category] += bytes; }
 
-    sstring << std::hex << std::setfill('0');
 
-    for( unsigned int i = 0; i < SHA_DIGEST_LENGTH; i++ )
-        sstring << std::setw(2) << static_cast<unsigned>(pwdHash[i]);
+void MemoryAccount::remove(Category category, size_t bytes) { _bytes[category] -= bytes; }
 
-    return sstring.str();
+
+MemoryUsage MemoryAccount::get() const
+{
+    return { _bytes[OBJECTS], _bytes[PAYLOADS], _bytes[PENDING], _bytes[TRANSPORT] };
 }
 
 
@@ -16,14 +16,26 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
 #include <chrono>
+#include <deque>
+#include <exception>
+#include <future>
 #include <memory>
+#include <optional>
 #include <shared_mutex>
+#include <stdexcept>
 #include <thread>
+#include <tuple>
+#include <utility>
+#include <ChangeNotifier.hpp>
+#include <Folder.hpp>
 #include <nlohmann/json.hpp>
 #include <Password.hpp>
+#include <Session.hpp>
+#include <Tag.hpp>
 #include "API_Implementor.cpp"
-#include "utils.cpp"
+#include "utils.hpp"
 
 
 namespace ncpass
@@ -32,10 +44,18 @@ namespace ncpass
 
 void Password::setJsonPatch(nlohmann::json patch)
 {
+    _lastAccess = std::chrono::steady_clock::now();
+
+    getSession()._journal.append({ { "type", "edit" }, { "key", getJournalKey() }, { "patch", patch } });
+
     {
-        nlohmann::json json_bak = _json;
-        _json.merge_patch(patch);
-        patch = nlohmann::json::diff(_json, json_bak);
+        nlohmann::json json_bak = materialize();
+        nlohmann::json json_new = json_bak;
+
+
+        json_new.merge_patch(patch);
+        patch = nlohmann::json::diff(json_new, json_bak);
+        store(std::move(json_new));
         _updateConVar.notify_all();
     }
 
@@ -48,6 +68,7 @@ void Password::setJsonPatch(nlohmann::json patch)
                 if( currentOp.at("path") == op.at("path") )
                 {
                     _jsonPushQueue.push_back(patch);
+                    updateMemoryUsage();
 
                     return;
                 }
@@ -61,19 +82,111 @@ void Password::setJsonPatch(nlohmann::json patch)
     {
         _jsonPushQueue.push_back(patch);
     }
+
+    updateMemoryUsage();
+}
+
+
+void Password::setFields(const nlohmann::json& patch)
+{
+    std::unique_lock         lock(_memberMutex);
+    const std::string        revision = _json.value("revision", "");
+    const nlohmann::json     json_old = materialize();
+    std::vector<std::string> fields;
+
+
+    for( const auto& [key, value] : patch.items() )
+    {
+        if( !json_old.contains(key) || (json_old.at(key) != value) )
+            fields.push_back(key);
+    }
+
+    setJsonPatch(patch);
+
+    push();
+
+    lock.unlock();
+
+    if( !fields.empty() )
+        notifyChange(revision, revision, std::move(fields), ChangeEvent::LOCAL);
+}
+
+
+void Password::notifyChange(const std::string& oldRevision, const std::string& newRevision, std::vector<std::string> fields, ChangeEvent::Origin origin)
+{
+    getSession()._notifier.notify({ shared_from_this(), oldRevision, newRevision, std::move(fields), origin });
+}
+
+
+void Password::syncFailed()
+{
+    std::vector<std::string> fields;
+    std::string              revision;
+
+
+    {
+        std::shared_lock memberLock(_memberMutex);
+
+
+        for( const nlohmann::json& patch : _jsonPushQueue )
+        {
+            for( std::string& key : patchFields(patch) )
+            {
+                if( std::find(fields.begin(), fields.end(), key) == fields.end() )
+                    fields.push_back(std::move(key));
+            }
+        }
+
+        revision = _json.value("revision", "");
+    }
+
+    _syncFailed = true;
+
+    notifyChange(revision, revision, std::move(fields), ChangeEvent::FAILED);
+}
+
+
+std::vector<std::string> Password::patchFields(const nlohmann::json& patch)
+{
+    std::vector<std::string> fields;
+
+
+    for( const nlohmann::json& op : patch )
+    {
+        const std::string& path = op.at("path").get_ref<const std::string&>();
+        const std::string  key  = path.substr(1, path.find('/', 1) - 1);
+
+
+        if( std::find(fields.begin(), fields.end(), key) == fields.end() )
+            fields.push_back(key);
+    }
+
+    return fields;
 }
 
 
-Password::Password(const std::shared_ptr<Session>& session, const nlohmann::json& password_json) :
+Password::Password(const std::shared_ptr<Session>& session, const nlohmann::json& password_json, const CancellationToken& token,
+                   bool deferCreate) :
     _Base(session, "password"),
-    _json("{}")
+    _json(nlohmann::json::object()),
+    _cipher(nlohmann::json::object()),
+    _pullDetails(MODEL),
+    _pullCount(0),
+    _partial(false),
+    _lastAccess(std::chrono::steady_clock::now()),
+    _decryptionFailed(false),
+    _syncFailed(false),
+    _memberMutex("Password::_memberMutex"),
+    _apiMutex("Password::_apiMutex")
 {
     if( password_json.contains("id") )
     {
-        _json = password_json;
+        store(password_json);
     }
     else
     {
+        _journalKey = "local:" + utils::binToHex(utils::randomBytes(16));
+
         {
             nlohmann::json json_copy = password_json;
 
@@ -87,299 +200,1768 @@ Password::Password(const std::shared_ptr<Session>& session, const nlohmann::json
         assert(_json.contains("password") && _json.contains("label"));
 #endif
 
+        // Password::createMany() creates the password itself as part of its pipeline.
+        if( deferCreate )
+            return;
+
         std::thread t1(
-          [passwd = std::shared_ptr<Password>(this), apiLock = std::unique_lock(_apiMutex)] () {
+          [passwd = std::shared_ptr<Password>(this), token] () {
               std::this_thread::sleep_for(std::chrono::milliseconds(250));
 
+              // The password stays in the journal so it's created once the journal is opened again or by Password::sync().
+              if( !passwd->getSession().waitOnline(token) )
+              {
+                  passwd->syncFailed();
+                  return;
+              }
 
-              std::unique_lock memberLock(passwd->_memberMutex);
+              passwd->createBlocking(RequestLimiter::NORMAL, token);
+          }
+          );
 
-              nlohmann::json currentPatch = passwd->_json;
+        t1.detach();
+    }
+}
 
-              for( auto itr = passwd->_jsonPushQueue.rbegin(); itr != passwd->_jsonPushQueue.rend() - 1; itr++ )
-                  currentPatch = currentPatch.patch(*itr);
 
-              memberLock.unlock();
+bool Password::createBlocking(RequestLimiter::Priority priority, const CancellationToken& token)
+{
+    std::unique_lock apiLock(_apiMutex);
+    std::unique_lock memberLock(_memberMutex);
 
+    // Another call created it while this one was waiting.
+    if( _json.contains("id") )
+        return true;
 
-              nlohmann::json json_new = passwd->apiCall(POST, "create", currentPatch);
+    nlohmann::json currentPatch = materialize();
 
 
-              if( json_new.contains("id") && json_new.contains("revision") )
-              {
-                  memberLock.lock();
+    for( auto itr = _jsonPushQueue.rbegin(); itr != _jsonPushQueue.rend() - 1; itr++ )
+        currentPatch = currentPatch.patch(*itr);
 
-                  passwd->_json["id"]       = json_new.at("id");
-                  passwd->_json["revision"] = json_new.at("revision");
+    memberLock.unlock();
 
-                  passwd->_jsonPushQueue.pop_front();
+    nlohmann::json json_new;
 
-                  memberLock.unlock();
-                  passwd->_updateConVar.notify_all();
 
-                  passwd->registerInstance();
-                  passwd->pull();
-              }
-              else
-              {
-                  //TODO: Implement failure action.
-              }
-          }
-          );
+    // The password stays in the journal until it can be encrypted.
+    if( encryptFields(currentPatch, token) )
+        json_new = apiCall(POST, "create", currentPatch, priority, token);
 
-        t1.detach();
+    if( !json_new.contains("id") || !json_new.contains("revision") )
+    {
+        apiLock.unlock();
+        syncFailed();
+
+        return false;
     }
-}
 
+    memberLock.lock();
 
-void Password::pull()
-{
-    std::thread t1([passwd = shared_from_this()] ()
-      {
-          std::unique_lock apiLock(passwd->_apiMutex);
-          std::unique_lock memberLock(passwd->_memberMutex);
+    _syncFailed = false;
 
-          // Only pull once every 250 milliseconds.
-          if( std::chrono::system_clock::now() > passwd->_lastSync + std::chrono::milliseconds(250) )
-          {
-              nlohmann::json apiArgs;
-              apiArgs["id"] = passwd->_json.at("id");
+    _json["id"]       = json_new.at("id");
+    _json["revision"] = json_new.at("revision");
+    publish();
 
-              memberLock.unlock();
+    std::vector<std::string> fields = patchFields(_jsonPushQueue.front());
 
-              nlohmann::json json_new = passwd->apiCall(POST, "show", apiArgs); // Actual pull here.
+    _jsonPushQueue.pop_front();
+    updateMemoryUsage();
 
-              // Verify that json_new is valid and not an error code.
-              if( (json_new.value("id", "") == apiArgs.at("id")) && json_new.contains("revision") )
-              {
-                  memberLock.lock();
+    Journal& journal = getSession()._journal;
 
-                  // Delete any values that have changes pending so they don't get overwriten.
-                  for( const nlohmann::json& patch : passwd->_jsonPushQueue )
-                  {
-                      for( const nlohmann::json& op : patch )
-                      {
-                          if( json_new.contains(nlohmann::json::json_pointer(op.at("path").get_ref<const std::string&>())) )
-                              json_new.erase(nlohmann::json::json_pointer(op.at("path").get_ref<const std::string&>()));
-                      }
-                  }
-
-                  // If there are no pending patches to push or the current JSON doesn't contain "revision" (meaning it's the first pull) or the 2 objects have the same "revision" UUID then write new json.
-                  if( passwd->_jsonPushQueue.empty() || !passwd->_json.contains("revision") || (passwd->_json.at("revision") == json_new.at("revision")) )
-                  {
-                      passwd->_json.merge_patch(json_new);
-                      passwd->setPopulated();
-                  }
-                  // If none of the above then we have a conflict.
-                  else
-                  {
-                      //TODO: Register conflict here.
-                  }
-
-                  passwd->_lastSync = std::chrono::system_clock::now();
+    journal.append({ { "type", "created" }, { "key", _journalKey }, { "id", json_new.at("id") } });
 
-                  passwd->_updateConVar.notify_all();
-              }
-              // Register an error in the pull here.
-              else
-              {
-                  //TODO: Implement failure action.
-              }
-          }
-      }
-      );
+    const bool pending = !_jsonPushQueue.empty();
 
 
-    t1.detach();
+    if( !pending )
+        journal.append({ { "type", "synced" }, { "key", json_new.at("id") } });
+
+    memberLock.unlock();
+    apiLock.unlock();
+    _updateConVar.notify_all();
+
+    registerInstance();
+    notifyChange("", json_new.at("revision"), std::move(fields), ChangeEvent::PUSH);
+
+    // The server only answers with the ID and revision. The fields it fills in are pulled in the same lane and waited for,
+    // so a pipeline of creates doesn't leave a pull per password behind.
+    pull(MODEL, priority, token).wait();
+
+    // Changes made while the password was being created couldn't be pushed without an ID.
+    if( pending )
+        push(token);
+
+    return true;
 }
 
 
-void Password::push()
+void Password::pullBlocking(Details details, RequestLimiter::Priority priority, const CancellationToken& token)
 {
-    std::thread t1(
-      [passwd = shared_from_this()] () {
-          std::this_thread::sleep_for(std::chrono::milliseconds(250));
+    // Fail instead of waiting for the Session to come back online, so the waiters of the pull get to use what's there.
+    if( getSession().isOffline() )
+    {
+        std::unique_lock memberLock(_memberMutex);
 
-          {
-              std::shared_lock lock(passwd->_memberMutex);
-              passwd->_updateConVar.wait(lock, [passwd] { return passwd->_json.contains("revision"); });
-          }
 
-          std::unique_lock apiLock(passwd->_apiMutex);
-          std::unique_lock memberLock(passwd->_memberMutex);
+        _missedPull = std::max(_missedPull.value_or(details), details);
 
-          if( !passwd->_jsonPushQueue.empty() )
-          {
-              nlohmann::json currentPatch = passwd->_json;
+        throw std::runtime_error("The Session is offline.");
+    }
 
-              for( auto itr = passwd->_jsonPushQueue.rbegin(); itr != passwd->_jsonPushQueue.rend() - 1; itr++ )
-                  currentPatch = currentPatch.patch(*itr);
+    std::unique_lock apiLock(_apiMutex);
+    std::unique_lock memberLock(_memberMutex);
 
-              memberLock.unlock();
+    // Only pull once every 250 milliseconds unless fields are missing.
+    if( _partial || (std::chrono::system_clock::now() > _lastSync + std::chrono::milliseconds(250)) )
+    {
+        nlohmann::json apiArgs;
+        apiArgs["id"]      = _json.at("id");
+        apiArgs["details"] = strDetails[details];
 
+        memberLock.unlock();
 
-              nlohmann::json json_new = passwd->apiCall(PATCH, "update", currentPatch);
+        nlohmann::json json_new = apiCall(POST, "show", apiArgs, priority, token); // Actual pull here.
 
+        // Verify that json_new is valid and not an error code.
+        if( (json_new.value("id", "") == apiArgs.at("id")) && json_new.contains("revision") )
+        {
+            memberLock.lock();
 
-              if( (json_new.value("id", "") == currentPatch.at("id")) && json_new.contains("revision") )
-              {
-                  memberLock.lock();
+            const std::string oldRevision = _json.value("revision", "");
+            const std::string newRevision = json_new.at("revision");
 
-                  passwd->_json["revision"] = json_new.at("revision");
+            std::vector<std::string> fields = merge(std::move(json_new), details);
 
-                  passwd->_jsonPushQueue.pop_front();
+            memberLock.unlock();
 
-                  memberLock.unlock();
-                  passwd->_updateConVar.notify_all();
-              }
-              else
-              {
-                  //TODO: Implement failure action.
-              }
-          }
-      }
-      );
+            if( !fields.empty() )
+                notifyChange(oldRevision, newRevision, std::move(fields), ChangeEvent::PULL);
 
+            scheduleEviction(getSession());
+        }
+        // The waiters of the pull are woken up with the exception.
+        else
+        {
+            // A pull that failed because the Session went offline meanwhile is repeated once it's back online.
+            if( getSession().isOffline() )
+            {
+                memberLock.lock();
+                _missedPull = std::max(_missedPull.value_or(details), details);
+            }
 
-    t1.detach();
+            throw std::runtime_error("The server didn't return the password.");
+        }
+    }
 }
 
 
-void Password::sync()
+std::vector<std::string> Password::merge(nlohmann::json json_new, Details details)
 {
-    pull();
-    push();
-}
+    std::vector<std::string> fields;
+    const bool               wasPartial = _partial;
 
 
-void Password::wait()
-{
-    std::unique_lock apiLock(_apiMutex);
+    // "model+tags" returns whole tags but only the IDs are stored. The Tag objects come from Tag::fetchAll().
+    if( json_new.contains("tags") && json_new.at("tags").is_array() )
+    {
+        for( nlohmann::json& tag : json_new.at("tags") )
+        {
+            if( tag.is_object() )
+                tag = nlohmann::json(tag.at("id"));
+        }
+    }
 
+    // Delete any values that have changes pending so they don't get overwriten.
+    for( const nlohmann::json& patch : _jsonPushQueue )
+    {
+        for( const nlohmann::json& op : patch )
+        {
+            nlohmann::json::json_pointer path(op.at("path").get_ref<const std::string&>());
 
-    _updateConVar.wait(
-      apiLock, [this]
-      {
-          std::shared_lock memberLock(_memberMutex);
 
-          return _jsonPushQueue.empty();
-      }
-      );
-}
+            // basic_json::erase() has no json_pointer overload so erase the key from its parent.
+            if( json_new.contains(path) )
+                json_new.at(path.parent_pointer()).erase(path.back());
+        }
+    }
 
+    // If there are no pending patches to push or the current JSON doesn't contain "revision" (meaning it's the first pull) or the 2 objects have the same "revision" UUID then write new json.
+    if( _jsonPushQueue.empty() || !_json.contains("revision") || (_json.at("revision") == json_new.at("revision")) )
+    {
+        if( details == SUMMARY )
+        {
+            const bool firstPull = !_json.contains("revision");
+            const bool stale     = !firstPull && (_json.at("revision") != json_new.at("revision"));
 
-std::shared_ptr<Password> Password::create(const std::shared_ptr<Session>& session, const std::string& label, const std::string& password)
-{
-    nlohmann::json json;
 
+            for( const char* key : k_heavyKeys )
+            {
+                auto itr = json_new.find(key);
 
-    json["password"] = password;
-    json["label"]    = label;
 
-    return (new Password(session, json))->shared_from_this();
-}
+                if( itr != json_new.end() )
+                {
+                    utils::secureWipe(*itr);
+                    json_new.erase(itr);
+                }
+            }
 
+            // Heavy fields from an older revision would be out of date.
+            if( stale )
+                dropHeavyFields();
 
-std::shared_ptr<Password> Password::fetch(const std::shared_ptr<Session>& session, const std::string& id)
-{
-    nlohmann::json json;
+            _partial = _partial || firstPull || stale;
+        }
+        else
+        {
+            _partial = false;
+        }
 
+        nlohmann::json json_merged = materialize();
 
-    json["id"] = id;
 
-    std::shared_ptr<Password> toReturn = (new Password(session, json))->registerInstance();
+        for( const auto& [key, value] : json_new.items() )
+        {
+            auto itr = _cipher.find(key);
 
 
-    toReturn->pull();
+            // merge_patch() drops null values so null is the same as a missing field.
+            if( itr != _cipher.end() )
+            {
+                if( *itr != value )
+                    fields.push_back(key);
+            }
+            else if( value.is_null() ? json_merged.contains(key) : (!json_merged.contains(key) || (json_merged.at(key) != value)) )
+            {
+                fields.push_back(key);
+            }
+        }
 
-    return toReturn;
-}
+        // Encrypted fields are kept apart until they are accessed. Decrypted values from an older revision are dropped.
+        if( json_new.value("cseType", json_merged.value("cseType", "none")) != "none" )
+        {
+            for( const char* key : k_encryptedKeys )
+            {
+                auto itr = json_new.find(key);
 
 
-std::vector<std::shared_ptr<Password>> Password::getAll() { return _Base::getRegistered(); }
+                if( itr == json_new.end() )
+                    continue;
 
+                if( !_cipher.contains(key) || (_cipher.at(key) != *itr) )
+                {
+                    _cipher[key] = std::move(*itr);
 
-std::string Password::getID() const
-{
-    std::shared_lock lock(_memberMutex);
+                    if( json_merged.contains(key) )
+                    {
+                        utils::secureWipe(json_merged.at(key));
+                        json_merged.erase(key);
+                    }
+                }
 
+                json_new.erase(itr);
+            }
+        }
+        else
+        {
+            _cipher = nlohmann::json::object();
+        }
 
-    _updateConVar.wait(lock, [this] { return _json.contains("id"); });
+        json_merged.merge_patch(json_new);
+        store(std::move(json_merged));
+        setPopulated();
+    }
+    // If none of the above then we have a conflict.
+    else
+    {
+        //TODO: Register conflict here.
+    }
 
-    return _json.at("id");
+    _lastSync = std::chrono::system_clock::now();
+
+    // Nothing a waiter could be waiting for changed.
+    if( !fields.empty() || (wasPartial != _partial) )
+        _updateConVar.notify_all();
+
+    return fields;
 }
 
 
-std::string Password::getLabel() const
+nlohmann::json Password::materialize() const
 {
-    std::shared_lock lock(_memberMutex);
+    nlohmann::json json = _json;
 
 
-    _updateConVar.wait(lock, [this] { return _json.contains("label"); });
+    for( size_t i = 0; i < _interned.size(); i++ )
+    {
+        if( _interned[i] )
+            json[k_internedKeys[i]] = *_interned[i];
+    }
 
-    return _json.at("label");
+    return json;
 }
 
 
-void Password::setLabel(const std::string& label)
+void Password::store(nlohmann::json json)
 {
-    std::unique_lock lock(_memberMutex);
-    nlohmann::json   patch;
+    for( size_t i = 0; i < _interned.size(); i++ )
+    {
+        auto itr = json.find(k_internedKeys[i]);
 
 
-    patch["label"] = label;
-    setJsonPatch(patch);
+        if( (itr != json.end()) && itr->is_string() )
+        {
+            // Only go to the pool when the value actually changed.
+            if( !_interned[i] || (*_interned[i] != itr->get_ref<const std::string&>()) )
+                _interned[i] = getSession()._stringPool.intern(itr->get_ref<const std::string&>());
 
-    push();
+            json.erase(itr);
+        }
+        else
+        {
+            _interned[i].reset();
+        }
+    }
+
+    _json = std::move(json);
+
+    publish();
+    updateRelations();
+    updateHealth();
+    updateMemoryUsage();
 }
 
 
-std::string Password::getUsername() const
+void Password::publish()
 {
-    std::shared_lock lock(_memberMutex);
+    std::atomic_store(&_snapshot, std::shared_ptr<const Snapshot>(new Snapshot(_json, _interned)));
+}
+
+
+void Password::updateMemoryUsage() const
+{
+    size_t pending = 0;
+    size_t payload = utils::jsonSize(_json) + utils::jsonSize(_cipher);
 
 
-    _updateConVar.wait(lock, [this] { return _json.contains("username"); });
+    for( const nlohmann::json& patch : _jsonPushQueue )
+        pending += utils::jsonSize(patch);
 
-    return _json.at("username");
+    // The current snapshot holds a copy of Password::_json. Older snapshots still held by readers aren't counted.
+    if( std::shared_ptr<const Snapshot> snapshot = std::atomic_load(&_snapshot) )
+        payload += utils::jsonSize(snapshot->_json);
+
+    setMemoryUsage(MemoryAccount::PAYLOADS, payload);
+    setMemoryUsage(MemoryAccount::PENDING,  pending);
 }
 
 
-void Password::setUsername(const std::string& username)
+void Password::updateRelations()
 {
-    std::unique_lock lock(_memberMutex);
-    nlohmann::json   patch;
+    auto passwd = weak_from_this().lock();
 
 
-    patch["username"] = username;
-    setJsonPatch(patch);
+    // Still being constructed.
+    if( !passwd )
+        return;
 
-    push();
-}
+    RelationIndex& relations = getSession()._relations;
+    StringPool::Handle folder = getInternedHandle("folder");
+    std::vector<std::string> tags;
 
 
-std::string Password::getPassword() const
-{
-    std::shared_lock lock(_memberMutex);
+    if( (folder ? *folder : "") != _indexedFolder )
+    {
+        relations.setPasswordFolder(passwd, _indexedFolder, folder ? *folder : "");
+        _indexedFolder = folder ? *folder : "";
+    }
 
+    if( _json.contains("tags") && _json.at("tags").is_array() )
+    {
+        for( const nlohmann::json& tag : _json.at("tags") )
+        {
+            if( tag.is_string() )
+                tags.push_back(tag);
+        }
+    }
 
-    _updateConVar.wait(lock, [this] { return _json.contains("password"); });
+    std::sort(tags.begin(), tags.end());
 
-    return _json.at("password");
+    if( tags != _indexedTags )
+    {
+        relations.setPasswordTags(passwd, _indexedTags, tags);
+        _indexedTags = std::move(tags);
+    }
 }
 
 
-void Password::setPassword(const std::string& password)
+void Password::updateHealth()
 {
-    std::unique_lock lock(_memberMutex);
-    nlohmann::json   patch;
+    auto passwd = weak_from_this().lock();
 
 
-    patch["password"] = password;
-    patch["hash"]     = utils::SHA1(password);
-    setJsonPatch(patch);
+    // Still being constructed.
+    if( !passwd )
+        return;
 
-    push();
+    StringPool::Handle status = getInternedHandle("statusCode");
+    HealthIndex::Entry entry;
+
+
+    // Passwords in the trash don't count as reused or old.
+    if( !_json.value("trashed", false) )
+    {
+        if( _json.contains("hash") && _json.at("hash").is_string() )
+            entry.hash = HealthIndex::toHashKey(_json.at("hash"));
+
+        if( _json.contains("edited") && _json.at("edited").is_number_integer() )
+            entry.edited = _json.at("edited");
+
+        entry.status = status ? *status : "";
+    }
+
+    if( entry != _indexedHealth )
+    {
+        getSession()._health.setPassword(passwd, _indexedHealth, entry);
+        _indexedHealth = std::move(entry);
+    }
+}
+
+
+std::string Password::getJournalKey() const { return _json.contains("id") ? _json.at("id").get<std::string>() : _journalKey; }
+
+
+StringPool::Handle Password::getInternedHandle(const std::string& key) const
+{
+    for( size_t i = 0; i < _interned.size(); i++ )
+    {
+        if( key == k_internedKeys[i] )
+            return _interned[i];
+    }
+
+    return nullptr;
+}
+
+
+bool Password::hasField(const std::string& key) const
+{
+    for( size_t i = 0; i < _interned.size(); i++ )
+    {
+        if( key == k_internedKeys[i] )
+            return _interned[i] || _json.contains(key) || _cipher.contains(key);
+    }
+
+    return _json.contains(key) || _cipher.contains(key);
+}
+
+
+bool Password::isEncrypted(const std::string& key) const
+{
+    if( !_cipher.contains(key) )
+        return false;
+
+    return !getInternedHandle(key) && !_json.contains(key);
+}
+
+
+void Password::decryptFields(const std::vector<std::string>& keys, const CancellationToken& token)
+{
+    struct Field
+    {
+        std::string                key;
+        nlohmann::json             cipher;
+        std::optional<std::string> plain;
+    };
+
+    std::vector<Field> fields;
+    std::string        keyID;
+
+
+    {
+        std::shared_lock lock(_memberMutex);
+
+
+        for( const std::string& key : keys )
+        {
+            if( isEncrypted(key) )
+                fields.push_back({ key, _cipher.at(key), std::nullopt });
+        }
+
+        if( StringPool::Handle cseKey = getInternedHandle("cseKey") )
+            keyID = *cseKey;
+    }
+
+    if( fields.empty() )
+        return;
+
+    bool failed = false;
+
+
+    // Decrypt without holding the lock so the password stays usable while waiting for the Session to be unlocked.
+    for( Field& field : fields )
+    {
+        if( field.cipher == "" )
+            field.plain = "";
+        else if( field.cipher.is_string() )
+            field.plain = getSession()._keychain.decrypt(keyID, field.cipher, token);
+
+        if( !field.plain )
+            failed = true;
+    }
+
+    _decryptionFailed = failed;
+
+    std::unique_lock lock(_memberMutex);
+    nlohmann::json   json    = materialize();
+    bool             changed = false;
+
+
+    for( Field& field : fields )
+    {
+        // Skip fields that were changed or dropped while decrypting.
+        if( field.plain && isEncrypted(field.key) && (_cipher.at(field.key) == field.cipher) )
+        {
+            json[field.key] = std::move(*field.plain);
+            changed         = true;
+        }
+    }
+
+    if( changed )
+    {
+        store(std::move(json));
+        _updateConVar.notify_all();
+    }
+}
+
+
+bool Password::encryptFields(nlohmann::json& json, const CancellationToken& token) const
+{
+    std::string keyID;
+
+
+    if( json.value("cseType", "none") == "none" )
+        return true;
+
+    for( const char* key : k_encryptedKeys )
+    {
+        auto itr = json.find(key);
+
+
+        if( (itr != json.end()) && itr->is_string() )
+        {
+            std::optional<std::string> cipher = getSession()._keychain.encrypt(*itr, keyID, token);
+
+
+            utils::secureWipe(*itr);
+
+            if( !cipher )
+            {
+                utils::secureWipe(json);
+                return false;
+            }
+
+            *itr = std::move(*cipher);
+        }
+    }
+
+    if( !keyID.empty() )
+        json["cseKey"] = keyID;
+
+    return true;
+}
+
+
+void Password::decryptBatch(const std::vector<std::shared_ptr<Password>>& passwords)
+{
+    constexpr size_t batchSize = 64;
+
+    const std::vector<std::string> keys(std::begin(k_listedKeys), std::end(k_listedKeys));
+    const size_t                   batches = (passwords.size() + batchSize - 1) / batchSize;
+    const size_t                   workers = std::min<size_t>(std::max(std::thread::hardware_concurrency(), 1u), batches);
+
+    std::atomic<size_t>      nextBatch = 0;
+    std::vector<std::thread> threads;
+
+
+    auto worker = [&] ()
+      {
+          for( size_t batch = nextBatch++; batch < batches; batch = nextBatch++ )
+          {
+              for( size_t i = batch * batchSize; i < std::min(passwords.size(), (batch + 1) * batchSize); i++ )
+                  passwords[i]->decryptFields(keys);
+          }
+      };
+
+    // The calling thread takes part as well.
+    for( size_t i = 1; i < workers; i++ )
+        threads.emplace_back(worker);
+
+    worker();
+
+    for( std::thread& thread : threads )
+        thread.join();
+}
+
+
+bool Password::waitForField(std::shared_lock<ProfiledMutex<std::shared_mutex>>& lock, const std::string& key) const
+{
+    _lastAccess = std::chrono::steady_clock::now();
+
+    // Lazily fetched and evicted passwords are pulled the first time one of their missing fields is needed.
+    // Password::pull() attaches to a pull in flight or queues one behind it if it only asked for a Password::SUMMARY.
+    if( !hasField(key) && _json.contains("id") && (!_json.contains("revision") || _partial) )
+    {
+        lock.unlock();
+        const_cast<Password*>(this)->pull(MODEL, RequestLimiter::INTERACTIVE);
+        lock.lock();
+    }
+
+    // A failed pull wakes up the waiters as well so they don't wait for a field that isn't coming.
+    _updateConVar.wait(lock, [this, &key] { return hasField(key) || !_pullFuture.valid(); });
+
+    return hasField(key);
+}
+
+
+nlohmann::json Password::getField(const std::string& key) const
+{
+    std::shared_ptr<const Snapshot> snapshot = getSnapshot();
+
+
+    // Fields that are already available are read without locking.
+    if( snapshot->hasField(key) )
+        return snapshot->getField(key);
+
+    std::shared_lock lock(_memberMutex);
+
+
+    // The pull failed, the future returned by Password::pull() holds the reason.
+    if( !waitForField(lock, key) )
+        return "";
+
+    // Encrypted fields are decrypted the first time they are accessed.
+    if( isEncrypted(key) )
+    {
+        lock.unlock();
+        const_cast<Password*>(this)->decryptFields({ key });
+        lock.lock();
+
+        if( !waitForField(lock, key) || isEncrypted(key) )
+            return "";
+    }
+
+    for( size_t i = 0; i < _interned.size(); i++ )
+    {
+        if( (key == k_internedKeys[i]) && _interned[i] )
+            return *_interned[i];
+    }
+
+    return _json.at(key);
+}
+
+
+StringPool::Handle Password::getInternedField(const std::string& key) const
+{
+    for( size_t i = 0; i < _interned.size(); i++ )
+    {
+        if( key == k_internedKeys[i] )
+        {
+            if( StringPool::Handle handle = getSnapshot()->_interned[i] )
+                return handle;
+
+            std::shared_lock lock(_memberMutex);
+
+
+            if( !waitForField(lock, key) )
+                return nullptr;
+
+            if( isEncrypted(key) )
+            {
+                lock.unlock();
+                const_cast<Password*>(this)->decryptFields({ key });
+                lock.lock();
+            }
+
+            return _interned[i];
+        }
+    }
+
+    return nullptr;
+}
+
+
+std::shared_future<void> Password::pull(Details details, RequestLimiter::Priority priority, const CancellationToken& token)
+{
+    std::unique_lock memberLock(_memberMutex);
+
+    // Someone waiting for the pull in flight shouldn't wait behind the background work it was queued with.
+    CancellationToken inFlightToken = _pullToken;
+    const bool        promote       = _pullFuture.valid() && (priority == RequestLimiter::INTERACTIVE);
+
+
+    // Attach to the pull in flight instead of queuing up another one.
+    if( _pullFuture.valid() && (_pullDetails >= details) )
+    {
+        std::shared_future<void> inFlight = _pullFuture;
+
+
+        memberLock.unlock();
+
+        if( promote )
+            inFlightToken.setUrgent();
+
+        return inFlight;
+    }
+
+    // If the pull in flight asks for less details this one has to wait for it.
+    std::shared_future<void> previous = _pullFuture;
+    auto promise = std::make_shared<std::promise<void>>();
+
+    // The pull gets a token of its own, so promoting it doesn't promote everything else that was given the caller's token.
+    CancellationToken pullToken(token.getDeadline());
+
+
+    _pullFuture  = promise->get_future().share();
+    _pullDetails = details;
+    _pullToken   = pullToken;
+
+    std::shared_future<void> toReturn = _pullFuture;
+    const unsigned long      pullID   = ++_pullCount;
+
+
+    memberLock.unlock();
+
+    if( promote )
+        inFlightToken.setUrgent();
+
+    std::thread t1([passwd = shared_from_this(), promise, previous, details, priority, token, pullToken, pullID] () mutable
+      {
+          std::exception_ptr error;
+
+          CancellationToken::Wakeup forward(token, [&token, &pullToken] ()
+            {
+                if( token.isCancelled() )
+                    pullToken.cancel();
+                else if( token.isUrgent() )
+                    pullToken.setUrgent();
+            }
+            );
+
+
+          if( token.isCancelled() )
+              pullToken.cancel();
+          else if( token.isUrgent() )
+              pullToken.setUrgent();
+
+          if( previous.valid() )
+              previous.wait();
+
+          try
+          {
+              passwd->pullBlocking(details, priority, pullToken);
+          }
+          catch( ... )
+          {
+              error = std::current_exception();
+          }
+
+          {
+              std::unique_lock memberLock(passwd->_memberMutex);
+
+              // Don't clear a pull that was queued behind this one.
+              if( passwd->_pullCount == pullID )
+                  passwd->_pullFuture = std::shared_future<void>();
+          }
+
+          passwd->_updateConVar.notify_all();
+
+          if( error )
+              promise->set_exception(error);
+          else
+              promise->set_value();
+      }
+      );
+
+
+    t1.detach();
+
+    return toReturn;
+}
+
+
+void Password::push(const CancellationToken& token)
+{
+    std::thread t1(
+      [passwd = shared_from_this(), token] () {
+          std::this_thread::sleep_for(std::chrono::milliseconds(250));
+
+          // Password::pushPending() pushes the changes once the Session is back online.
+          if( passwd->getSession().isOffline() )
+              return;
+
+          {
+              std::shared_lock lock(passwd->_memberMutex);
+
+              // An update replaces the whole password on the server so evicted fields and passwords that were never pulled have to be pulled first.
+              if( passwd->_partial || (passwd->_json.contains("id") && !passwd->_json.contains("revision")) )
+              {
+                  lock.unlock();
+                  passwd->pull(MODEL, RequestLimiter::NORMAL, token);
+                  lock.lock();
+              }
+
+              // The changes stay queued if the pull fails or the token is cancelled.
+              token.wait(
+                passwd->_updateConVar, lock, [passwd]
+                {
+                    return (passwd->_json.contains("revision") && !passwd->_partial) || !passwd->_pullFuture.valid();
+                }
+                );
+
+              if( !passwd->_json.contains("revision") || passwd->_partial )
+              {
+                  lock.unlock();
+
+                  // A cancelled push isn't a failure, the caller asked for it.
+                  if( !token.isCancelled() )
+                      passwd->syncFailed();
+
+                  return;
+              }
+          }
+
+          // The whole password is encrypted again with the current key so every field has to be decrypted first.
+          passwd->decryptFields(std::vector<std::string>(std::begin(k_encryptedKeys), std::end(k_encryptedKeys)), token);
+
+          std::unique_lock apiLock(passwd->_apiMutex);
+          std::unique_lock memberLock(passwd->_memberMutex);
+
+          if( !passwd->_jsonPushQueue.empty() )
+          {
+              nlohmann::json currentPatch = passwd->materialize();
+
+              for( auto itr = passwd->_jsonPushQueue.rbegin(); itr != passwd->_jsonPushQueue.rend() - 1; itr++ )
+                  currentPatch = currentPatch.patch(*itr);
+
+              memberLock.unlock();
+
+              // The changes stay queued until the Session is unlocked.
+              if( !passwd->encryptFields(currentPatch, token) )
+                  return;
+
+
+              nlohmann::json json_new = passwd->apiCall(PATCH, "update", currentPatch, RequestLimiter::NORMAL, token);
+
+
+              if( (json_new.value("id", "") == currentPatch.at("id")) && json_new.contains("revision") )
+              {
+                  memberLock.lock();
+
+                  passwd->_syncFailed = false;
+
+                  const std::string oldRevision = passwd->_json.value("revision", "");
+
+                  passwd->_json["revision"] = json_new.at("revision");
+                  passwd->publish();
+
+                  std::vector<std::string> fields = patchFields(passwd->_jsonPushQueue.front());
+
+                  passwd->_jsonPushQueue.pop_front();
+                  passwd->updateMemoryUsage();
+
+                  if( passwd->_jsonPushQueue.empty() )
+                      passwd->getSession()._journal.append({ { "type", "synced" }, { "key", currentPatch.at("id") } });
+
+                  memberLock.unlock();
+                  passwd->_updateConVar.notify_all();
+
+                  passwd->notifyChange(oldRevision, json_new.at("revision"), std::move(fields), ChangeEvent::PUSH);
+              }
+              else if( !token.isCancelled() )
+              {
+                  apiLock.unlock();
+                  passwd->syncFailed();
+              }
+          }
+      }
+      );
+
+
+    t1.detach();
+}
+
+
+std::shared_ptr<const Password::Snapshot> Password::getCompleteSnapshot(const CancellationToken& token)
+{
+    bool needsPull;
+
+
+    {
+        std::shared_lock lock(_memberMutex);
+
+
+        needsPull = _partial || (_json.contains("id") && !_json.contains("revision"));
+    }
+
+    // The pull is waited for completely (not just for the fields) so nothing is in flight when evicting.
+    if( needsPull )
+        pull(MODEL, RequestLimiter::BULK, token).wait();
+
+    nlohmann::json ciphers = nlohmann::json::object(); // The fields that are only decrypted for this.
+
+
+    {
+        std::shared_lock lock(_memberMutex);
+
+
+        for( const char* key : k_encryptedKeys )
+        {
+            if( isEncrypted(key) )
+                ciphers[key] = _cipher.at(key);
+        }
+    }
+
+    decryptFields(std::vector<std::string>(std::begin(k_encryptedKeys), std::end(k_encryptedKeys)), token);
+
+    // Read straight from the snapshot, so exporting doesn't count as using the password.
+    std::shared_ptr<const Snapshot> snapshot = std::atomic_load(&_snapshot);
+
+
+    if( !ciphers.empty() )
+    {
+        std::unique_lock lock(_memberMutex);
+        nlohmann::json   json    = materialize();
+        bool             changed = false;
+
+
+        for( const auto& [key, cipher] : ciphers.items() )
+        {
+            auto itr = json.find(key);
+
+
+            // Fields that were changed or pulled again in the meantime are kept.
+            if( (itr == json.end()) || !_cipher.contains(key) || !(_cipher.at(key) == cipher) || !(*itr == snapshot->getField(key)) )
+                continue;
+
+            if( auto plain = _json.find(key); plain != _json.end() )
+                utils::secureWipe(*plain);
+
+            utils::secureWipe(*itr);
+            json.erase(itr);
+            changed = true;
+        }
+
+        // The fields go back to being encrypted, like they were before.
+        if( changed )
+            store(std::move(json));
+    }
+
+    if( needsPull )
+        evict();
+
+    return snapshot;
+}
+
+
+size_t Password::evict()
+{
+    std::unique_lock memberLock(_memberMutex);
+    size_t           freed = 0;
+
+
+    if( _partial || !_jsonPushQueue.empty() || _pullFuture.valid() || !_json.contains("revision") )
+        return 0;
+
+    freed    = dropHeavyFields();
+    _partial = true;
+
+    return freed;
+}
+
+
+bool Password::release()
+{
+    std::shared_ptr<Password> passwd = shared_from_this();
+
+
+    {
+        std::unique_lock memberLock(_memberMutex);
+
+
+        if( !_jsonPushQueue.empty() || _pullFuture.valid() )
+            return false;
+
+        getSession()._relations.setPasswordFolder(passwd, _indexedFolder, "");
+        getSession()._relations.setPasswordTags(passwd, _indexedTags, {});
+        getSession()._health.setPassword(passwd, _indexedHealth, HealthIndex::Entry());
+
+        _indexedFolder.clear();
+        _indexedTags.clear();
+        _indexedHealth = HealthIndex::Entry();
+    }
+
+    return unregisterInstance();
+}
+
+
+size_t Password::dropHeavyFields()
+{
+    std::shared_ptr<const Snapshot> snapshot = std::atomic_load(&_snapshot);
+    size_t                          freed    = 0;
+
+
+    for( const char* key : k_heavyKeys )
+    {
+        for( nlohmann::json* json : { &_json, &_cipher } )
+        {
+            auto itr = json->find(key);
+
+
+            if( itr != json->end() )
+            {
+                freed += utils::jsonSize(*itr);
+                utils::secureWipe(*itr);
+                json->erase(itr);
+            }
+        }
+    }
+
+    publish();
+    updateMemoryUsage();
+
+    // The copy held by the previous snapshot is freed once its last reader drops it.
+    freed += utils::jsonSize(snapshot->_json) - utils::jsonSize(std::atomic_load(&_snapshot)->_json);
+
+    return freed;
+}
+
+
+void Password::enforceMemoryBudget(const Session& session)
+{
+    const size_t budget = session.getMemoryBudget();
+    size_t       total  = 0;
+
+    std::vector<std::pair<std::chrono::steady_clock::time_point, std::shared_ptr<Password>>> candidates;
+
+
+    // The Session's memory account covers more than its passwords, so a Session under budget never needs the walk below.
+    if( !budget || (session.getMemoryUsage().payloads <= budget) )
+        return;
+
+    for( const std::shared_ptr<Password>& passwd : getRegistered() )
+    {
+        if( &passwd->getSession() != &session )
+            continue;
+
+        std::shared_lock memberLock(passwd->_memberMutex);
+
+
+        total += utils::jsonSize(passwd->_json) + utils::jsonSize(passwd->_cipher) + utils::jsonSize(std::atomic_load(&passwd->_snapshot)->_json);
+
+        if( !passwd->_partial )
+            candidates.emplace_back(passwd->_lastAccess.load(), passwd);
+    }
+
+    if( total <= budget )
+        return;
+
+    // Least recently used first.
+    std::sort(candidates.begin(), candidates.end(), [] (const auto& a, const auto& b) { return a.first < b.first; });
+
+    for( auto& candidate : candidates )
+    {
+        if( total <= budget )
+            break;
+
+        total -= std::min(total, candidate.second->evict());
+    }
+}
+
+
+void Password::scheduleEviction(const Session& session)
+{
+    if( !session.getMemoryBudget() || session._evictionScheduled.exchange(true) )
+        return;
+
+    std::thread t1([session = session.shared_from_this()] ()
+      {
+          // Give other pulls finishing around the same time a chance to join this pass.
+          std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+          session->_evictionScheduled = false;
+          enforceMemoryBudget(*session);
+      }
+      );
+
+
+    t1.detach();
+}
+
+
+void Password::sync(const CancellationToken& token)
+{
+    {
+        std::shared_lock memberLock(_memberMutex);
+
+        if( !_json.contains("id") )
+        {
+            std::thread t1([passwd = shared_from_this(), token] () { passwd->createBlocking(RequestLimiter::NORMAL, token); });
+
+
+            t1.detach();
+
+            return;
+        }
+    }
+
+    pull(MODEL, RequestLimiter::NORMAL, token);
+
+    {
+        std::shared_lock memberLock(_memberMutex);
+
+        if( _jsonPushQueue.empty() )
+            return;
+    }
+
+    push(token);
+}
+
+
+bool Password::wait(const CancellationToken& token)
+{
+    std::unique_lock apiLock(_apiMutex);
+
+
+    return token.wait(
+      _updateConVar, apiLock, [this]
+      {
+          std::shared_lock memberLock(_memberMutex);
+
+          return _jsonPushQueue.empty();
+      }
+      );
+}
+
+
+std::shared_ptr<Password> Password::create(const std::shared_ptr<Session>& session, const std::string& label, const std::string& password, const CancellationToken& token)
+{
+    nlohmann::json json;
+
+
+    json["password"] = password;
+    json["label"]    = label;
+
+    // New passwords use client side encryption whenever it's available.
+    if( session->isUnlocked() )
+        json["cseType"] = Keychain::k_type;
+
+    return (new Password(session, json, token))->shared_from_this();
+}
+
+
+Password::CreateBatch Password::createMany(const std::shared_ptr<Session>& session, const std::vector<nlohmann::json>& records, const CancellationToken& token)
+{
+    const size_t workers = std::min<size_t>(std::max(std::thread::hardware_concurrency(), 1u), records.size());
+
+    CreateBatch              batch;
+    std::atomic<size_t>      nextRecord = 0;
+    std::vector<std::thread> threads;
+
+
+    batch.passwords.resize(records.size());
+
+    // Hashing the passwords is the expensive part of constructing them, so they are constructed in parallel.
+    auto construct = [&] ()
+      {
+          for( size_t i = nextRecord++; i < records.size(); i = nextRecord++ )
+          {
+              nlohmann::json json = records[i];
+
+
+              // New passwords use client side encryption whenever it's available.
+              if( !json.contains("cseType") && session->isUnlocked() )
+                  json["cseType"] = Keychain::k_type;
+
+              batch.passwords[i] = std::shared_ptr<Password>(new Password(session, json, token, true));
+          }
+      };
+
+    // The calling thread takes part as well.
+    for( size_t i = 1; i < workers; i++ )
+        threads.emplace_back(construct);
+
+    construct();
+
+    for( std::thread& thread : threads )
+        thread.join();
+
+    batch.created = std::async(
+      std::launch::async, [session, passwords = batch.passwords, token] ()
+      {
+          // Not a std::vector<bool> so the workers can write their outcomes without racing on shared bytes.
+          std::vector<char>        created(passwords.size(), false);
+          std::atomic<size_t>      nextPassword = 0;
+          std::vector<std::thread> pipeline;
+
+
+          auto create = [&] ()
+            {
+                for( size_t i = nextPassword++; i < passwords.size(); i = nextPassword++ )
+                {
+                    if( session->waitOnline(token) )
+                        created[i] = passwords[i]->createBlocking(RequestLimiter::BULK, token);
+                }
+            };
+
+          for( size_t i = 0; i < std::min(k_createPipelineDepth, passwords.size()); i++ )
+              pipeline.emplace_back(create);
+
+          for( std::thread& thread : pipeline )
+              thread.join();
+
+          return std::vector<bool>(created.begin(), created.end());
+      }
+      );
+
+    return batch;
+}
+
+
+std::shared_ptr<Password> Password::fetch(const std::shared_ptr<Session>& session, const std::string& id, bool lazy, Details details, const CancellationToken& token)
+{
+    nlohmann::json json;
+
+
+    json["id"] = id;
+
+    std::shared_ptr<Password> toReturn = (new Password(session, json))->registerInstance();
+
+
+    // Whoever fetches a single password is most likely waiting for it.
+    if( !lazy )
+        toReturn->pull(details, RequestLimiter::INTERACTIVE, token);
+
+    return toReturn;
+}
+
+
+std::vector<std::shared_ptr<Password>> Password::mergeList(const std::shared_ptr<Session>& session, nlohmann::json& json_list, Details details,
+                                                         const std::function<void(const std::shared_ptr<Password>&)>& onFound)
+{
+    std::vector<std::shared_ptr<Password>> passwords;
+
+
+    // The future of Password::fetchAll() or Password::find() holds the exception.
+    if( !json_list.is_array() )
+        throw std::runtime_error("The server didn't return a list of passwords.");
+
+    for( nlohmann::json& json_new : json_list )
+    {
+        if( !json_new.contains("id") || !json_new.contains("revision") )
+            continue;
+
+        nlohmann::json json_id;
+
+
+        json_id["id"] = json_new.at("id");
+
+        std::shared_ptr<Password> passwd = (new Password(session, json_id))->registerInstance();
+        std::string               oldRevision;
+        std::string               newRevision = json_new.at("revision");
+        std::vector<std::string>  fields;
+
+        {
+            std::unique_lock memberLock(passwd->_memberMutex);
+
+
+            oldRevision = passwd->_json.value("revision", "");
+            fields      = passwd->merge(std::move(json_new), details);
+        }
+
+        if( !fields.empty() )
+            passwd->notifyChange(oldRevision, newRevision, std::move(fields), ChangeEvent::PULL);
+
+        passwords.push_back(passwd);
+
+        if( onFound )
+            onFound(passwd);
+    }
+
+    // Passwords that arrive while the Session is locked are decrypted by Session::unlock().
+    if( session->_keychain.isUnlocked() )
+        decryptBatch(passwords);
+
+    scheduleEviction(*session);
+
+    return passwords;
+}
+
+
+std::future<std::vector<std::shared_ptr<Password>>> Password::fetchAll(const std::shared_ptr<Session>& session, Details details)
+{
+    return std::async(
+      std::launch::async, [session, details] ()
+      {
+          nlohmann::json apiArgs;
+
+
+          apiArgs["details"] = strDetails[details];
+
+          nlohmann::json json_list = _Base::apiCall(*session, "password/", POST, "list", apiArgs);
+
+
+          return mergeList(session, json_list, details, nullptr);
+      }
+      );
+}
+
+
+std::future<std::vector<std::shared_ptr<Password>>> Password::find(const std::shared_ptr<Session>& session, const nlohmann::json& criteria,
+                                                                   const std::function<void(const std::shared_ptr<Password>&)>& onFound, Details details)
+{
+    return std::async(
+      std::launch::async, [session, criteria, onFound, details] ()
+      {
+          nlohmann::json apiArgs;
+
+
+          apiArgs["criteria"] = criteria;
+          apiArgs["details"]  = strDetails[details];
+
+          nlohmann::json json_list = _Base::apiCall(*session, "password/", POST, "find", apiArgs);
+
+
+          return mergeList(session, json_list, details, onFound);
+      }
+      );
+}
+
+
+void Password::prefetch(const std::shared_ptr<Session>& session, const std::vector<std::string>& ids)
+{
+    std::thread t1([session, ids] ()
+      {
+          std::deque<std::shared_future<void>> inFlight;
+
+
+          for( const std::string& id : ids )
+          {
+              std::shared_ptr<Password> passwd = fetch(session, id, true);
+
+              {
+                  std::shared_lock memberLock(passwd->_memberMutex);
+
+                  if( passwd->_json.contains("revision") || passwd->_pullFuture.valid() )
+                      continue;
+              }
+
+              // The next pull starts as soon as the oldest one is done, instead of waiting for a whole batch.
+              if( inFlight.size() >= k_prefetchDepth )
+              {
+                  inFlight.front().wait();
+                  inFlight.pop_front();
+              }
+
+              inFlight.push_back(passwd->pull(MODEL, RequestLimiter::BULK));
+          }
+      }
+      );
+
+
+    t1.detach();
+}
+
+
+std::chrono::steady_clock::duration Password::refresh(const std::shared_ptr<Session>& session, const SyncScheduler::Settings& settings, std::chrono::seconds interval,
+                                                     std::chrono::steady_clock::time_point since, bool& active)
+{
+    const std::chrono::system_clock::time_point now       = std::chrono::system_clock::now();
+    const std::chrono::steady_clock::time_point nowSteady = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::duration         untilDue  = interval;
+
+    std::vector<std::tuple<std::chrono::system_clock::duration, Details, std::shared_ptr<Password>>> outdated;
+
+
+    for( const std::shared_ptr<Password>& passwd : getRegistered() )
+    {
+        if( &passwd->getSession() != session.get() )
+            continue;
+
+        const std::chrono::steady_clock::time_point lastAccess = passwd->_lastAccess;
+        const bool                                  hot        = (nowSteady - lastAccess) < settings.hotWindow;
+
+
+        active = active || (lastAccess > since);
+
+        std::shared_lock memberLock(passwd->_memberMutex);
+
+
+        // Passwords that were never pulled or are being pulled right now are left alone.
+        if( !passwd->_json.contains("revision") || passwd->_pullFuture.valid() )
+            continue;
+
+        const std::chrono::system_clock::duration age    = now - passwd->_lastSync;
+        const std::chrono::system_clock::duration maxAge = hot ? std::min(settings.hotInterval, interval) : interval;
+
+
+        if( age >= maxAge )
+            outdated.emplace_back(age - maxAge, passwd->_partial ? SUMMARY : MODEL, passwd);
+        else
+            untilDue = std::min(untilDue, std::chrono::duration_cast<std::chrono::steady_clock::duration>(maxAge - age));
+    }
+
+    if( outdated.size() > settings.batchSize )
+    {
+        // The most outdated passwords go first, the rest waits for the next tick.
+        std::partial_sort(outdated.begin(), outdated.begin() + settings.batchSize, outdated.end(),
+                          [] (const auto& a, const auto& b) { return std::get<0>(a) > std::get<0>(b); });
+        outdated.resize(settings.batchSize);
+
+        untilDue = std::chrono::steady_clock::duration::zero();
+    }
+
+    for( auto& [overdue, details, passwd] : outdated )
+        passwd->pull(details, RequestLimiter::BULK);
+
+    return untilDue;
+}
+
+
+void Password::pullMissed(const Session& session)
+{
+    for( const std::shared_ptr<Password>& passwd : getRegistered() )
+    {
+        if( &passwd->getSession() != &session )
+            continue;
+
+        std::optional<Details> details;
+
+        {
+            std::unique_lock memberLock(passwd->_memberMutex);
+
+            details.swap(passwd->_missedPull);
+        }
+
+        if( details )
+            passwd->pull(*details, RequestLimiter::BULK);
+    }
+}
+
+
+void Password::pushPending(const Session& session, const CancellationToken& token)
+{
+    for( const std::shared_ptr<Password>& passwd : getRegistered() )
+    {
+        if( &passwd->getSession() != &session )
+            continue;
+
+        {
+            std::shared_lock memberLock(passwd->_memberMutex);
+
+            if( passwd->_jsonPushQueue.empty() )
+                continue;
+        }
+
+        passwd->push(token);
+    }
+}
+
+
+void Password::replay(const std::shared_ptr<Session>& session, const std::map<std::string, nlohmann::json>& pending)
+{
+    for( const auto& [key, patch] : pending )
+    {
+        // Passwords that were never created are created again. They get a new journal key so the old one is done.
+        if( key.rfind("local:", 0) == 0 )
+        {
+            if( patch.contains("label") && patch.contains("password") )
+                (new Password(session, patch))->shared_from_this();
+
+            session->_journal.append({ { "type", "synced" }, { "key", key } });
+
+            continue;
+        }
+
+        std::shared_ptr<Password> passwd = fetch(session, key, true);
+
+        {
+            std::unique_lock memberLock(passwd->_memberMutex);
+
+            passwd->setJsonPatch(patch);
+        }
+
+        passwd->push();
+    }
+}
+
+
+std::future<void> Password::decryptAll(const std::shared_ptr<Session>& session)
+{
+    return std::async(
+      std::launch::async, [session] ()
+      {
+          std::vector<std::shared_ptr<Password>> passwords;
+
+
+          for( const std::shared_ptr<Password>& passwd : getRegistered() )
+          {
+              if( &passwd->getSession() == session.get() )
+                  passwords.push_back(passwd);
+          }
+
+          decryptBatch(passwords);
+      }
+      );
+}
+
+
+std::vector<std::shared_ptr<Password>> Password::getAll() { return _Base::getRegistered(); }
+
+
+MemoryUsage Password::getMemoryUsage() { return _Base::getTypeMemoryUsage(); }
+
+
+ChangeNotifier::SubscriptionID Password::subscribe(ChangeNotifier::Callback callback, ChangeNotifier::Executor executor)
+{
+    return getSession()._notifier.subscribe(this, "", std::move(callback), std::move(executor));
+}
+
+
+ChangeNotifier::SubscriptionID Password::subscribe(const std::string& field, ChangeNotifier::Callback callback, ChangeNotifier::Executor executor)
+{
+    return getSession()._notifier.subscribe(this, field, std::move(callback), std::move(executor));
+}
+
+
+void Password::unsubscribe(ChangeNotifier::SubscriptionID id) { getSession()._notifier.unsubscribe(id); }
+
+
+std::shared_ptr<const Password::Snapshot> Password::getSnapshot() const
+{
+    _lastAccess = std::chrono::steady_clock::now();
+
+    return std::atomic_load(&_snapshot);
+}
+
+
+std::string Password::getID() const
+{
+    std::shared_ptr<const Snapshot> snapshot = std::atomic_load(&_snapshot);
+
+
+    if( snapshot->hasField("id") )
+        return snapshot->getID();
+
+    std::shared_lock lock(_memberMutex);
+
+
+    _updateConVar.wait(lock, [this] { return _json.contains("id"); });
+
+    return _json.at("id");
+}
+
+
+bool Password::hasDecryptionFailed() const { return _decryptionFailed; }
+
+
+bool Password::hasSyncFailed() const { return _syncFailed; }
+
+
+std::shared_ptr<Folder> Password::getFolder() const
+{
+    StringPool::Handle folder = getInternedField("folder");
+
+
+    return folder ? getSession()._relations.getFolder(*folder) : nullptr;
+}
+
+
+std::vector<std::shared_ptr<Tag>> Password::getTags() const
+{
+    std::shared_ptr<const Snapshot>   snapshot = getSnapshot();
+    std::vector<std::shared_ptr<Tag>> tags;
+
+
+    // Only pulls with Password::TAGS or more details return the tags, so they are pulled the first time they're asked for.
+    if( !snapshot->hasField("tags") && snapshot->hasField("id") )
+    {
+        const_cast<Password*>(this)->pull(TAGS, RequestLimiter::INTERACTIVE).wait();
+        snapshot = getSnapshot();
+    }
+
+    const nlohmann::json ids = snapshot->getField("tags");
+
+
+    // The tags couldn't be pulled (example: the Session is offline).
+    if( !ids.is_array() )
+        return tags;
+
+    for( const nlohmann::json& id : ids )
+    {
+        if( auto tag = getSession()._relations.getTag(id) )
+            tags.push_back(tag);
+    }
+
+    return tags;
+}
+
+
+std::string Password::getLabel() const
+{
+    return getField("label");
+}
+
+
+void Password::setLabel(const std::string& label)
+{
+    nlohmann::json patch;
+
+
+    patch["label"] = label;
+    setFields(patch);
+}
+
+
+std::string Password::getUsername() const
+{
+    return getField("username");
+}
+
+
+void Password::setUsername(const std::string& username)
+{
+    nlohmann::json patch;
+
+
+    patch["username"] = username;
+    setFields(patch);
+}
+
+
+std::string Password::getPassword() const
+{
+    return getField("password");
+}
+
+
+void Password::setPassword(const std::string& password)
+{
+    nlohmann::json patch;
+
+
+    patch["password"] = password;
+    patch["hash"]     = utils::SHA1(password);
+    setFields(patch);
+}
+
+
+std::string Password::getNotes() const
+{
+    return getField("notes");
+}
+
+
+void Password::setNotes(const std::string& notes)
+{
+    nlohmann::json patch;
+
+
+    patch["notes"] = notes;
+    setFields(patch);
+}
+
+
+Password::Snapshot::Snapshot(nlohmann::json json, const std::array<StringPool::Handle, std::size(Password::k_internedKeys)>& interned) :
+    _json(std::move(json)),
+    _interned(interned)
+{}
+
+
+Password::Snapshot::~Snapshot()
+{
+    for( const char* key : k_heavyKeys )
+    {
+        auto itr = _json.find(key);
+
+
+        if( itr != _json.end() )
+            utils::secureWipe(*itr);
+    }
+}
+
+
+bool Password::Snapshot::hasField(const std::string& key) const
+{
+    for( size_t i = 0; i < _interned.size(); i++ )
+    {
+        if( (key == k_internedKeys[i]) && _interned[i] )
+            return true;
+    }
+
+    return _json.contains(key);
+}
+
+
+nlohmann::json Password::Snapshot::getField(const std::string& key) const
+{
+    for( size_t i = 0; i < _interned.size(); i++ )
+    {
+        if( (key == k_internedKeys[i]) && _interned[i] )
+            return *_interned[i];
+    }
+
+    return _json.value(key, nlohmann::json(""));
+}
+
+
+StringPool::Handle Password::Snapshot::getInternedField(const std::string& key) const
+{
+    for( size_t i = 0; i < _interned.size(); i++ )
+    {
+        if( key == k_internedKeys[i] )
+            return _interned[i];
+    }
+
+    return nullptr;
+}
+
+
+std::string Password::Snapshot::getID() const { return _json.value("id", ""); }
+
+
+std::string Password::Snapshot::getRevision() const { return _json.value("revision", ""); }
+
+
+std::string Password::Snapshot::getLabel() const { return getField("label"); }
+
+
+std::string Password::Snapshot::getUsername() const { return getField("username"); }
+
+
+std::string Password::Snapshot::getUrl() const { return getField("url"); }
+
+
+std::string Password::Snapshot::getPassword() const { return getField("password"); }
+
+
+std::string Password::Snapshot::getNotes() const { return getField("notes"); }
+
+
+nlohmann::json Password::Snapshot::toJson() const
+{
+    nlohmann::json json = _json;
+
+
+    for( size_t i = 0; i < _interned.size(); i++ )
+    {
+        if( _interned[i] )
+            json[k_internedKeys[i]] = *_interned[i];
+    }
+
+    return json;
 }
 
 
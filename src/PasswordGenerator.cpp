@@ -0,0 +1,205 @@
+/*
+ * ncpasscpp. A library that implements Nextcloud Password's API.
+ * Copyright (C) 2021  Reed Krantz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+#include <PasswordGenerator.hpp>
+#include <sodium.h>
+
+
+namespace ncpass
+{
+
+
+bool PasswordGenerator::Settings::operator<(const Settings& other) const
+{
+    return std::tie(strength, numbers, special) < std::tie(other.strength, other.numbers, other.special);
+}
+
+
+PasswordGenerator::SecureString PasswordGenerator::secure(const std::string& password)
+{
+    SecureString copy((char*)sodium_malloc(password.size() + 1), sodium_free);
+
+
+    if( !copy )
+        return copy;
+
+    std::memcpy(copy.get(), password.c_str(), password.size() + 1);
+
+    return copy;
+}
+
+
+PasswordGenerator::PasswordGenerator(Source source) :
+    _source(std::move(source)),
+    _stop(false)
+{
+    if( sodium_init() < 0 )
+        throw std::runtime_error("libsodium couldn't be initialized.");
+}
+
+
+PasswordGenerator::~PasswordGenerator() { stop(); }
+
+
+void PasswordGenerator::start()
+{
+    if( !_stop && !_refiller.joinable() )
+        _refiller = std::thread(&PasswordGenerator::refill, this);
+}
+
+
+void PasswordGenerator::refill()
+{
+    std::unique_lock lock(_mutex);
+
+
+    while( !_stop )
+    {
+        auto itr = _pools.end();
+
+
+        // The pool with the fewest passwords ready goes first so a busy pool can't starve the others.
+        for( auto pool = _pools.begin(); pool != _pools.end(); pool++ )
+        {
+            if( (pool->second.passwords.size() < pool->second.size) && ((itr == _pools.end()) || (pool->second.passwords.size() < itr->second.passwords.size())) )
+                itr = pool;
+        }
+
+        if( itr == _pools.end() )
+        {
+            _refillConVar.wait(lock);
+            continue;
+        }
+
+        const Settings settings = itr->first;
+
+        lock.unlock();
+
+        std::optional<std::string> password = _source(settings, RequestLimiter::BULK, _stopToken);
+
+        lock.lock();
+
+        // Example: the server is unreachable. Nobody is waiting for the pool, so it's retried later. Taking a password falls back to a request.
+        if( !password )
+        {
+            _refillConVar.wait_for(lock, k_retryDelay, [this] { return _stop; });
+            continue;
+        }
+
+        // The pool may have been dropped or filled up while the password was generated.
+        itr = _pools.find(settings);
+
+        if( (itr != _pools.end()) && (itr->second.passwords.size() < itr->second.size) )
+        {
+            SecureString copy = secure(*password);
+
+
+            // Secure memory is scarce (it's locked into RAM), a password that doesn't fit is dropped and generated again later.
+            if( copy )
+                itr->second.passwords.push_back(std::move(copy));
+            else
+            {
+                sodium_memzero(password->data(), password->size());
+                _refillConVar.wait_for(lock, k_retryDelay, [this] { return _stop; });
+                continue;
+            }
+        }
+
+        sodium_memzero(password->data(), password->size());
+    }
+}
+
+
+void PasswordGenerator::setPoolSize(const Settings& settings, size_t size)
+{
+    std::unique_lock lock(_mutex);
+
+
+    if( !size )
+    {
+        _pools.erase(settings);
+        return;
+    }
+
+    Pool& pool = _pools.try_emplace(settings, Pool{ {}, size }).first->second;
+
+
+    pool.size = size;
+
+    while( pool.passwords.size() > size )
+        pool.passwords.pop_back();
+
+    start();
+    _refillConVar.notify_one();
+}
+
+
+std::optional<std::string> PasswordGenerator::generate(const Settings& settings, const CancellationToken& token)
+{
+    {
+        std::unique_lock lock(_mutex);
+
+
+        if( !_stop )
+        {
+            Pool& pool = _pools.try_emplace(settings, Pool{ {}, k_defaultPoolSize }).first->second;
+
+
+            start();
+            _refillConVar.notify_one();
+
+            if( !pool.passwords.empty() )
+            {
+                std::string password = pool.passwords.front().get();
+
+
+                pool.passwords.pop_front();
+
+                return password;
+            }
+        }
+    }
+
+    // The pool ran dry, so this password is generated right away while the pool is refilled in the background.
+    return _source(settings, RequestLimiter::INTERACTIVE, token);
+}
+
+
+void PasswordGenerator::stop()
+{
+    {
+        std::unique_lock lock(_mutex);
+
+
+        _stop = true;
+        _stopToken.cancel();
+        _pools.clear();
+        _refillConVar.notify_one();
+    }
+
+    if( _refiller.joinable() )
+        _refiller.join();
+}
+
+
+}
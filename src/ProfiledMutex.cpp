@@ -0,0 +1,117 @@
+/*
+ * ncpasscpp. A library that implements Nextcloud Password's API.
+ * Copyright (C) 2021  Reed Krantz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ProfiledMutex.hpp>
+
+
+namespace ncpass
+{
+
+
+/**
+ * @brief The counters of every name. Never destroyed so mutexes that outlive static destruction can still count.
+ */
+struct LockProfilerState
+{
+    std::map<std::string, std::unique_ptr<LockProfiler::Counters>> counters; ///< The counters by name.
+    std::mutex mutex;                                                         ///< Mutex used for locking access to LockProfilerState::counters.
+};
+
+
+static LockProfilerState& lockProfilerState()
+{
+    static LockProfilerState* state = new LockProfilerState();
+
+
+    return *state;
+}
+
+
+bool LockProfiler::isEnabled()
+{
+#ifdef NCPASSCPP_LOCK_STATS
+    return true;
+#else
+    return false;
+#endif
+}
+
+
+LockProfiler::Counters& LockProfiler::get(const std::string& name)
+{
+    LockProfilerState& state = lockProfilerState();
+    std::unique_lock   lock(state.mutex);
+    auto&              counters = state.counters[name];
+
+
+    if( !counters )
+        counters = std::make_unique<Counters>();
+
+    return *counters;
+}
+
+
+void LockProfiler::record(std::atomic<uint64_t>& total, std::atomic<uint64_t>& max, std::chrono::steady_clock::duration time)
+{
+    const uint64_t nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(time).count();
+    uint64_t       previous    = max;
+
+
+    total += nanoseconds;
+
+    while( (previous < nanoseconds) && !max.compare_exchange_weak(previous, nanoseconds) )
+    {}
+}
+
+
+std::vector<LockProfiler::Stats> LockProfiler::getStats()
+{
+    LockProfilerState& state = lockProfilerState();
+    std::unique_lock   lock(state.mutex);
+    std::vector<Stats> stats;
+
+
+    for( const auto& [name, counters] : state.counters )
+    {
+        stats.push_back({ name, counters->acquisitions, counters->contentions, std::chrono::nanoseconds(counters->totalWait),
+                          std::chrono::nanoseconds(counters->maxWait), std::chrono::nanoseconds(counters->totalHold), std::chrono::nanoseconds(counters->maxHold) });
+    }
+
+    return stats;
+}
+
+
+void LockProfiler::reset()
+{
+    LockProfilerState& state = lockProfilerState();
+    std::unique_lock   lock(state.mutex);
+
+
+    for( const auto& [name, counters] : state.counters )
+    {
+        for( std::atomic<uint64_t>* counter : { &counters->acquisitions, &counters->contentions, &counters->totalWait, &counters->maxWait, &counters->totalHold,
+                                                &counters->maxHold } )
+            *counter = 0;
+    }
+}
+
+
+}
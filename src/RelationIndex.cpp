@@ -0,0 +1,153 @@
+/*
+ * ncpasscpp. A library that implements Nextcloud Password's API.
+ * Copyright (C) 2021  Reed Krantz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <mutex>
+#include <shared_mutex>
+#include <RelationIndex.hpp>
+
+
+namespace ncpass
+{
+
+
+template <class API_Type>
+void RelationIndex::move(Members<API_Type>& members, const std::shared_ptr<API_Type>& member, const std::string& oldParent, const std::string& newParent)
+{
+    if( !oldParent.empty() )
+    {
+        auto itr = members.find(oldParent);
+
+
+        if( itr != members.end() )
+        {
+            itr->second.erase(member);
+
+            if( itr->second.empty() )
+                members.erase(itr);
+        }
+    }
+
+    if( !newParent.empty() )
+        members[newParent].insert(member);
+}
+
+
+template <class API_Type>
+std::vector<std::shared_ptr<API_Type>> RelationIndex::get(const Members<API_Type>& members, const std::string& parent)
+{
+    auto itr = members.find(parent);
+
+
+    if( itr == members.end() )
+        return {};
+
+    return std::vector<std::shared_ptr<API_Type>>(itr->second.begin(), itr->second.end());
+}
+
+
+void RelationIndex::setFolder(const std::shared_ptr<Folder>& folder, const std::string& id, const std::string& oldParent, const std::string& newParent)
+{
+    std::unique_lock lock(_mutex);
+
+
+    _folders[id] = folder;
+
+    // The root folder is its own parent.
+    move(_folderFolders, folder, oldParent, newParent != id ? newParent : "");
+}
+
+
+void RelationIndex::setTag(const std::shared_ptr<Tag>& tag, const std::string& id)
+{
+    std::unique_lock lock(_mutex);
+
+
+    _tags[id] = tag;
+}
+
+
+void RelationIndex::setPasswordFolder(const std::shared_ptr<Password>& password, const std::string& oldFolder, const std::string& newFolder)
+{
+    std::unique_lock lock(_mutex);
+
+
+    move(_folderPasswords, password, oldFolder, newFolder);
+}
+
+
+void RelationIndex::setPasswordTags(const std::shared_ptr<Password>& password, const std::vector<std::string>& oldTags, const std::vector<std::string>& newTags)
+{
+    std::unique_lock lock(_mutex);
+
+
+    for( const std::string& tag : oldTags )
+        move(_tagPasswords, password, tag, "");
+
+    for( const std::string& tag : newTags )
+        move(_tagPasswords, password, "", tag);
+}
+
+
+std::shared_ptr<Folder> RelationIndex::getFolder(const std::string& id) const
+{
+    std::shared_lock lock(_mutex);
+    auto             itr = _folders.find(id);
+
+
+    return itr != _folders.end() ? itr->second : nullptr;
+}
+
+
+std::shared_ptr<Tag> RelationIndex::getTag(const std::string& id) const
+{
+    std::shared_lock lock(_mutex);
+    auto             itr = _tags.find(id);
+
+
+    return itr != _tags.end() ? itr->second : nullptr;
+}
+
+
+std::vector<std::shared_ptr<Folder>> RelationIndex::getFolderFolders(const std::string& id) const
+{
+    std::shared_lock lock(_mutex);
+
+
+    return get(_folderFolders, id);
+}
+
+
+std::vector<std::shared_ptr<Password>> RelationIndex::getFolderPasswords(const std::string& id) const
+{
+    std::shared_lock lock(_mutex);
+
+
+    return get(_folderPasswords, id);
+}
+
+
+std::vector<std::shared_ptr<Password>> RelationIndex::getTagPasswords(const std::string& id) const
+{
+    std::shared_lock lock(_mutex);
+
+
+    return get(_tagPasswords, id);
+}
+
+
+}
@@ -0,0 +1,221 @@
+/*
+ * ncpasscpp. A library that implements Nextcloud Password's API.
+ * Copyright (C) 2021  Reed Krantz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <RequestLimiter.hpp>
+
+
+namespace ncpass
+{
+
+
+RequestLimiter::Slot::Slot(RequestLimiter* limiter) :
+    _limiter(limiter)
+{}
+
+
+RequestLimiter::Slot::Slot(Slot&& slot) :
+    _limiter(slot._limiter)
+{
+    slot._limiter = nullptr;
+}
+
+
+RequestLimiter::Slot::~Slot() { release(); }
+
+
+void RequestLimiter::Slot::release()
+{
+    if( _limiter )
+    {
+        _limiter->release();
+        _limiter = nullptr;
+    }
+}
+
+
+RequestLimiter::Slot::operator bool() const { return _limiter != nullptr; }
+
+
+RequestLimiter::RequestLimiter(double requestsPerSecond, unsigned burst, unsigned maxInFlight) :
+    _rate(requestsPerSecond),
+    _burst(std::max(burst, 1u)),
+    _tokens(_burst),
+    _maxInFlight(maxInFlight),
+    _inFlight(0),
+    _lastRefill(std::chrono::steady_clock::now())
+{}
+
+
+void RequestLimiter::refill(std::chrono::steady_clock::time_point now)
+{
+    if( _rate > 0 )
+        _tokens = std::min(_burst, _tokens + std::chrono::duration<double>(now - _lastRefill).count() * _rate);
+    else
+        _tokens = _burst;
+
+    _lastRefill = now;
+}
+
+
+RequestLimiter::Waiter* RequestLimiter::front() const
+{
+    for( const std::deque<Waiter*>& queue : _queues )
+    {
+        if( !queue.empty() )
+            return queue.front();
+    }
+
+    return nullptr;
+}
+
+
+void RequestLimiter::notifyFront()
+{
+    if( Waiter* waiter = front() )
+        waiter->conVar.notify_one();
+}
+
+
+void RequestLimiter::release()
+{
+    std::unique_lock lock(_mutex);
+
+
+    _inFlight--;
+    notifyFront();
+}
+
+
+void RequestLimiter::setRateLimit(double requestsPerSecond, unsigned burst)
+{
+    std::unique_lock lock(_mutex);
+
+
+    refill(std::chrono::steady_clock::now());
+
+    _rate   = requestsPerSecond;
+    _burst  = std::max(burst, 1u);
+    _tokens = std::min(_tokens, _burst);
+
+    notifyFront();
+}
+
+
+void RequestLimiter::setMaxInFlight(unsigned maxInFlight)
+{
+    std::unique_lock lock(_mutex);
+
+
+    _maxInFlight = maxInFlight;
+    notifyFront();
+}
+
+
+RequestLimiter::Slot RequestLimiter::acquire(Priority priority, const CancellationToken& token)
+{
+    Waiter waiter;
+
+    // Declared before the lock, so the wake up is registered and dropped without holding it.
+    CancellationToken::Wakeup wakeup(token, [this, &waiter] ()
+      {
+          std::unique_lock lock(_mutex);
+
+          waiter.conVar.notify_all();
+      }
+      );
+
+    std::unique_lock lock(_mutex);
+
+
+    _queues[priority].push_back(&waiter);
+
+    while( true )
+    {
+        if( token.isCancelled() )
+        {
+            std::deque<Waiter*>& queue = _queues[priority];
+
+
+            queue.erase(std::find(queue.begin(), queue.end(), &waiter));
+
+            // This might have been the front of the queue.
+            notifyFront();
+
+            return Slot(nullptr);
+        }
+
+        // Someone started waiting for the request, so it moves to the back of the interactive lane.
+        if( token.isUrgent() && (priority != INTERACTIVE) )
+        {
+            std::deque<Waiter*>& queue = _queues[priority];
+
+
+            queue.erase(std::find(queue.begin(), queue.end(), &waiter));
+
+            priority = INTERACTIVE;
+            _queues[priority].push_back(&waiter);
+
+            // Whoever is at the front now might have been waiting behind this request.
+            notifyFront();
+        }
+
+        // Only the oldest request of the highest lane may be admitted. Everyone else waits for their turn.
+        if( front() != &waiter )
+        {
+            token.waitOnce(waiter.conVar, lock);
+            continue;
+        }
+
+        // Bulk requests leave the last slot to the others.
+        const unsigned maxInFlight = ((priority == BULK) && (_maxInFlight > 1)) ? _maxInFlight - 1 : _maxInFlight;
+
+
+        if( maxInFlight && _inFlight >= maxInFlight )
+        {
+            token.waitOnce(waiter.conVar, lock); // Woken up by release().
+            continue;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+
+
+        refill(now);
+
+        if( _tokens < 1 )
+        {
+            // Sleep until the bucket has a whole token again.
+            waiter.conVar.wait_until(lock, std::min(token.getDeadline(), now + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>((1 - _tokens) / _rate))));
+            continue;
+        }
+
+        _tokens -= 1;
+        _inFlight++;
+        _queues[priority].pop_front();
+
+        // The next request might be able to go right away (burst or free slots).
+        notifyFront();
+
+        return Slot(this);
+    }
+}
+
+
+}
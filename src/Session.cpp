@@ -16,8 +16,15 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <cstring>
+#include <future>
+#include <memory>
+#include <mutex>
 #include <thread>
+#include <utility>
+#include <Password.hpp>
 #include <Session.hpp>
+#include <sodium.h>
 #include "API_Implementor.cpp"
 
 namespace ncpass
@@ -26,11 +33,326 @@ namespace ncpass
 
 Session::Session(const std::string& username, const std::string& serverRoot, const std::string& password) :
     _Base("session"),
-    k_apiURL("https://" + serverRoot + (serverRoot.back() != '/' ? "/" : "") + "apps/passwords/api/1.0/"),
+    k_apiURL((serverRoot.find("://") == std::string::npos ? "https://" : "") + serverRoot + (serverRoot.back() != '/' ? "/" : "") + "apps/passwords/api/1.0/"),
     k_federatedID(username + "@" + (serverRoot.back() != '/' ? serverRoot : serverRoot.substr(0, serverRoot.size() - 1))),
     k_username(username),
-    _password(password)
-{}
+    _password(password),
+    _limiter(0, 1, 6),
+    _masterPassword(nullptr, sodium_free),
+    _cookieAuth(false),
+    _keepaliveRunning(false),
+    _keepaliveInterval(std::chrono::minutes(5)),
+    _keepaliveSignal(std::make_shared<KeepaliveSignal>()),
+    _lastRequest(std::chrono::steady_clock::now()),
+    _connectTimeout(std::chrono::seconds(10)),
+    _requestTimeout(std::chrono::seconds(60)),
+    _curlShare(curl_share_init()),
+    _memoryBudget(0),
+    _evictionScheduled(false),
+    _offline(false),
+    _disconnected(false),
+    _generator(
+      [this] (const PasswordGenerator::Settings& settings, RequestLimiter::Priority priority, const CancellationToken& token) -> std::optional<std::string>
+      {
+          nlohmann::json apiArgs;
+
+
+          apiArgs["strength"] = settings.strength;
+          apiArgs["numbers"]  = settings.numbers;
+          apiArgs["special"]  = settings.special;
+
+          nlohmann::json json_new = _Base::apiCall(*this, "service/", POST, "password", apiArgs, priority, token);
+
+
+          if( !json_new.contains("password") || !json_new.at("password").is_string() )
+              return std::nullopt;
+
+          return std::move(json_new.at("password").get_ref<std::string&>());
+      }
+      ),
+    _favicons(
+      [this] (const std::string& action, RequestLimiter::Priority priority, const CancellationToken& token) -> std::optional<std::string>
+      {
+          long                       responseCode = 0;
+          std::optional<std::string> image        = _Base::apiRequest(*this, "service/", GET, action, nlohmann::json::object(), priority, token, &responseCode);
+
+
+          if( responseCode != 200 )
+              return std::nullopt;
+
+          return image;
+      }
+      )
+{
+    typedef decltype(_curlShareMutexes) Mutexes;
+
+
+    curl_share_setopt(_curlShare, CURLSHOPT_SHARE,    CURL_LOCK_DATA_COOKIE);
+    curl_share_setopt(_curlShare, CURLSHOPT_SHARE,    CURL_LOCK_DATA_DNS);
+    curl_share_setopt(_curlShare, CURLSHOPT_SHARE,    CURL_LOCK_DATA_SSL_SESSION);
+    curl_share_setopt(_curlShare, CURLSHOPT_USERDATA, &_curlShareMutexes);
+    curl_share_setopt(
+      _curlShare, CURLSHOPT_LOCKFUNC, +[] (CURL*, curl_lock_data data, curl_lock_access, void* userptr)
+        {
+            (*(Mutexes*)userptr)[data].lock();
+        }
+      );
+    curl_share_setopt(
+      _curlShare, CURLSHOPT_UNLOCKFUNC, +[] (CURL*, curl_lock_data data, void* userptr)
+        {
+            (*(Mutexes*)userptr)[data].unlock();
+        }
+      );
+
+    setMemoryUsage(MemoryAccount::OBJECTS, sizeof(Session));
+}
+
+
+Session::~Session()
+{
+    SyncScheduler::get().remove(this);
+
+    {
+        std::unique_lock lock(_keepaliveSignal->mutex);
+
+        _keepaliveSignal->changes++;
+        _keepaliveSignal->conVar.notify_all();
+    }
+
+    // The generator and the favicon cache send requests with this Session, so they have to stop before the connections are closed.
+    _generator.stop();
+    _favicons.stop();
+
+    for( CURL* curl : _curlHandles )
+    {
+        curl_easy_cleanup(curl);
+        removeMemory(*this, MemoryAccount::TRANSPORT, k_curlBufferSize);
+    }
+
+    releaseMemoryUsage();
+
+    curl_share_cleanup(_curlShare);
+}
+
+
+CURL* Session::takeCurlHandle() const
+{
+    CURL* curl = nullptr;
+
+
+    {
+        std::unique_lock lock(_curlHandlesMutex);
+
+        if( !_curlHandles.empty() )
+        {
+            curl = _curlHandles.back();
+            _curlHandles.pop_back();
+        }
+    }
+
+    // Resetting a handle keeps its connection open.
+    if( curl )
+        curl_easy_reset(curl);
+    else if( (curl = curl_easy_init()) )
+        addMemory(*this, MemoryAccount::TRANSPORT, k_curlBufferSize);
+
+    if( curl )
+    {
+        curl_easy_setopt(curl, CURLOPT_SHARE,      _curlShare);
+        curl_easy_setopt(curl, CURLOPT_COOKIEFILE, ""); // Enables the cookie engine without reading a file.
+    }
+
+    return curl;
+}
+
+
+void Session::returnCurlHandle(CURL* curl) const
+{
+    constexpr size_t maxIdle = 16;
+
+
+    {
+        std::unique_lock lock(_curlHandlesMutex);
+
+        if( _curlHandles.size() < maxIdle )
+        {
+            _curlHandles.push_back(curl);
+
+            return;
+        }
+    }
+
+    curl_easy_cleanup(curl);
+    removeMemory(*this, MemoryAccount::TRANSPORT, k_curlBufferSize);
+}
+
+
+bool Session::reopen(const std::string& expiredID) const
+{
+    std::unique_lock reopenLock(_reopenMutex);
+    std::string      masterPassword;
+
+
+    {
+        std::unique_lock lock(_mutex);
+
+        // Another request already opened a new session.
+        if( _apiSessionID != expiredID )
+            return !_apiSessionID.empty();
+
+        _apiSessionID.clear();
+
+        if( _masterPassword )
+            masterPassword = _masterPassword.get();
+    }
+
+    // The login cookie belongs to the expired session.
+    if( CURL* curl = takeCurlHandle() )
+    {
+        curl_easy_setopt(curl, CURLOPT_COOKIELIST, "ALL");
+        returnCurlHandle(curl);
+    }
+
+    const bool opened = const_cast<Session*>(this)->open(masterPassword).get();
+
+
+    sodium_memzero(masterPassword.data(), masterPassword.size());
+
+    return opened;
+}
+
+
+void Session::setDisconnected(bool disconnected) const
+{
+    if( !disconnected )
+    {
+        if( _disconnected.exchange(false) && !_offline )
+            notifyOnline();
+
+        return;
+    }
+
+    if( _disconnected.exchange(true) )
+        return;
+
+    std::thread t1([weakSession = std::weak_ptr<const Session>(shared_from_this())] ()
+      {
+          for( std::chrono::seconds delay(1);; delay = std::min(delay * 2, std::chrono::seconds(60)) )
+          {
+              std::this_thread::sleep_for(delay);
+
+              std::shared_ptr<const Session> session = weakSession.lock();
+
+
+              if( !session || !session->_disconnected )
+                  return;
+
+              // Only check if a connection can be made so the server doesn't have to do any work.
+              CURL* curl = curl_easy_init();
+
+              if( !curl )
+                  continue;
+
+              curl_easy_setopt(curl, CURLOPT_URL,          session->k_apiURL.c_str());
+              curl_easy_setopt(curl, CURLOPT_CONNECT_ONLY, 1L);
+
+              CURLcode res = curl_easy_perform(curl);
+
+              curl_easy_cleanup(curl);
+
+              if( res == CURLE_OK )
+              {
+                  session->setDisconnected(false);
+                  return;
+              }
+          }
+      }
+      );
+
+
+    t1.detach();
+}
+
+
+void Session::notifyOnline() const
+{
+    {
+        std::unique_lock lock(_onlineMutex);
+
+        _onlineConVar.notify_all();
+    }
+
+    Password::pullMissed(*this);
+    Password::pushPending(*this);
+}
+
+
+bool Session::waitOnline(const CancellationToken& token) const
+{
+    std::unique_lock lock(_onlineMutex);
+
+
+    return token.wait(_onlineConVar, lock, [this] { return !isOffline(); });
+}
+
+
+void Session::startKeepalive() const
+{
+    if( _keepaliveRunning.exchange(true) )
+        return;
+
+    std::thread t1([weakSession = std::weak_ptr<const Session>(shared_from_this()), signal = _keepaliveSignal] ()
+      {
+          for( ;; )
+          {
+              std::chrono::steady_clock::time_point due;
+              unsigned long                         changes;
+
+
+              {
+                  std::unique_lock lock(signal->mutex);
+
+                  changes = signal->changes;
+              }
+
+              {
+                  std::shared_ptr<const Session> session = weakSession.lock();
+
+
+                  if( !session )
+                      return;
+
+                  {
+                      std::shared_lock lock(session->_mutex);
+
+                      if( session->_apiSessionID.empty() )
+                      {
+                          session->_keepaliveRunning = false;
+                          return;
+                      }
+                  }
+
+                  due = session->_lastRequest.load() + session->_keepaliveInterval.load();
+
+                  // Any request keeps the session alive, so only idle sessions need a keepalive.
+                  if( std::chrono::steady_clock::now() >= due )
+                  {
+                      _Base::apiCall(*session, "session/", GET, "keepalive", nlohmann::json::object());
+                      continue;
+                  }
+              }
+
+              // Wait without holding the Session, so it can be destroyed in the meantime. A new interval or the destruction wake the thread early.
+              std::unique_lock lock(signal->mutex);
+
+              signal->conVar.wait_until(lock, due, [&signal, changes] { return signal->changes != changes; });
+          }
+      }
+      );
+
+
+    t1.detach();
+}
 
 
 std::shared_ptr<Session> Session::create(const std::string& username, const std::string& serverRoot, const std::string& password)
@@ -65,4 +387,273 @@ void Session::setPassword(const std::string& password)
 }
 
 
+void Session::setRateLimit(double requestsPerSecond, unsigned burst) { _limiter.setRateLimit(requestsPerSecond, burst); }
+
+
+void Session::setMaxInFlight(unsigned maxInFlight) { _limiter.setMaxInFlight(maxInFlight); }
+
+
+void Session::setKeepaliveInterval(std::chrono::seconds interval)
+{
+    _keepaliveInterval = interval;
+
+    std::unique_lock lock(_keepaliveSignal->mutex);
+
+    _keepaliveSignal->changes++;
+    _keepaliveSignal->conVar.notify_all();
+}
+
+
+void Session::setTimeouts(std::chrono::milliseconds connect, std::chrono::milliseconds request)
+{
+    _connectTimeout = connect;
+    _requestTimeout = request;
+}
+
+
+void Session::setAutoSync(bool enabled, const SyncScheduler::Settings& settings)
+{
+    if( enabled )
+        SyncScheduler::get().add(shared_from_this(), settings);
+    else
+        SyncScheduler::get().remove(this);
+}
+
+
+void Session::setMemoryBudget(size_t bytes) { _memoryBudget = bytes; }
+
+
+size_t Session::getMemoryBudget() const { return _memoryBudget; }
+
+
+MemoryUsage Session::getMemoryUsage() const { return _memoryAccount.get(); }
+
+
+std::future<bool> Session::open(const std::string& masterPassword)
+{
+    // Decrypting waits for the keychain that comes with the session instead of failing in the meantime.
+    std::shared_ptr<Keychain::Unlocking> unlocking = masterPassword.empty() ? nullptr : std::make_shared<Keychain::Unlocking>(_keychain);
+
+
+    return std::async(
+      std::launch::async, [session = shared_from_this(), masterPassword = std::string(masterPassword), unlocking] () mutable
+      {
+          // The task keeps its captures until the future is dropped, the unlock ends with the thread.
+          std::shared_ptr<Keychain::Unlocking> unlocked = std::move(unlocking);
+
+          // The copy of the master password is wiped however opening ends.
+          auto wipe = [&masterPassword] (bool result)
+            {
+                sodium_memzero(masterPassword.data(), masterPassword.size());
+
+                return result;
+            };
+
+
+          {
+              SecureString     secure((char*)sodium_malloc(masterPassword.size() + 1), sodium_free);
+              std::unique_lock lock(session->_mutex);
+
+
+              // The session isn't opened without a secure copy of the master password, it's needed to reopen the session once it expires.
+              if( !secure )
+                  return wipe(false);
+
+              std::memcpy(secure.get(), masterPassword.c_str(), masterPassword.size() + 1);
+              session->_masterPassword = std::move(secure);
+          }
+
+          nlohmann::json json_request = _Base::apiCall(*session, "session/", GET, "request", nlohmann::json::object(), RequestLimiter::INTERACTIVE);
+          nlohmann::json apiArgs     = nlohmann::json::object();
+
+
+          // Accounts with a master password have to solve a challenge first. The connection stays open in the meantime.
+          // Nothing can be fetched alongside: the keychain only comes with "session/open", and the server refuses "keychain/get" until the session is open.
+          if( json_request.contains("challenge") && json_request.at("challenge").is_object() )
+          {
+              std::optional<std::string> solution = Keychain::solveChallenge(json_request.at("challenge"), masterPassword);
+
+
+              if( !solution )
+                  return wipe(false);
+
+              apiArgs["challenge"] = std::move(*solution);
+          }
+
+          nlohmann::json json_open = _Base::apiCall(*session, "session/", POST, "open", apiArgs, RequestLimiter::INTERACTIVE);
+
+
+          // Example: a wrong master password. Requests keep logging in with the password.
+          if( !json_open.value("success", false) )
+              return wipe(false);
+
+          session->_cookieAuth = true;
+          session->startKeepalive();
+
+          // The keychain comes with the session when client side encryption is set up.
+          if( json_open.contains("keys") && session->_keychain.unlock(json_open.at("keys"), masterPassword) )
+              Password::decryptAll(session).wait();
+
+          return wipe(true);
+      }
+      );
+}
+
+
+std::future<bool> Session::openJournal(const std::string& path, const std::string& passphrase)
+{
+    return std::async(
+      std::launch::async, [session = shared_from_this(), path, passphrase] ()
+      {
+          auto pending = session->_journal.open(path, passphrase);
+
+
+          if( !pending )
+              return false;
+
+          Password::replay(session, *pending);
+
+          return true;
+      }
+      );
+}
+
+
+void Session::setOffline(bool offline)
+{
+    _offline = offline;
+
+    if( !offline && !_disconnected )
+        notifyOnline();
+}
+
+
+bool Session::isOffline() const { return _offline || _disconnected; }
+
+
+std::future<bool> Session::flush(const CancellationToken& token)
+{
+    return std::async(
+      std::launch::async, [session = shared_from_this(), token] ()
+      {
+          if( !session->waitOnline(token) )
+              return false;
+
+          Password::pushPending(*session, token);
+
+          for( const std::shared_ptr<Password>& passwd : Password::getAll() )
+          {
+              if( (&passwd->getSession() == session.get()) && !passwd->wait(token) )
+                  return false;
+          }
+
+          return session->_journal.flush();
+      }
+      );
+}
+
+
+ChangeNotifier::SubscriptionID Session::subscribe(ChangeNotifier::Callback callback, ChangeNotifier::Executor executor)
+{
+    return _notifier.subscribe(nullptr, "", std::move(callback), std::move(executor));
+}
+
+
+ChangeNotifier::SubscriptionID Session::subscribe(const std::string& field, ChangeNotifier::Callback callback, ChangeNotifier::Executor executor)
+{
+    return _notifier.subscribe(nullptr, field, std::move(callback), std::move(executor));
+}
+
+
+void Session::unsubscribe(ChangeNotifier::SubscriptionID id) { _notifier.unsubscribe(id); }
+
+
+std::future<bool> Session::unlock(const std::string& masterPassword)
+{
+    // Marked before the thread starts, so decrypting right after calling this waits for the keychain.
+    auto unlocking = std::make_shared<Keychain::Unlocking>(_keychain);
+
+
+    return std::async(
+      std::launch::async, [session = shared_from_this(), masterPassword, unlocking] () mutable
+      {
+          // The task keeps its captures until the future is dropped, the unlock ends with the thread.
+          std::shared_ptr<Keychain::Unlocking> unlocked = std::move(unlocking);
+          nlohmann::json                       json_keychain = _Base::apiCall(*session, "keychain/", GET, "get", nlohmann::json::object(), RequestLimiter::INTERACTIVE);
+
+
+          if( !session->_keychain.unlock(json_keychain, masterPassword) )
+              return false;
+
+          Password::decryptAll(session).wait();
+
+          if( !session->isOffline() )
+              Password::pushPending(*session);
+
+          return true;
+      }
+      );
+}
+
+
+void Session::lock() { _keychain.lock(); }
+
+
+bool Session::isUnlocked() const { return _keychain.isUnlocked(); }
+
+
+std::optional<std::string> Session::generatePassword(const PasswordGenerator::Settings& settings, const CancellationToken& token)
+{
+    return _generator.generate(settings, token);
+}
+
+
+void Session::setGeneratorPool(const PasswordGenerator::Settings& settings, size_t size) { _generator.setPoolSize(settings, size); }
+
+
+std::vector<std::vector<std::shared_ptr<Password>>> Session::getReusedPasswords() const { return _health.getReused(); }
+
+
+std::vector<std::shared_ptr<Password>> Session::getPasswordsEditedBefore(std::chrono::system_clock::time_point time) const
+{
+    return _health.getEditedBefore(std::chrono::duration_cast<std::chrono::seconds>(time.time_since_epoch()).count());
+}
+
+
+std::vector<std::shared_ptr<Password>> Session::getPasswordsByStatus(const std::string& statusCode) const { return _health.getByStatus(statusCode); }
+
+
+std::shared_future<FaviconCache::Image> Session::getFavicon(const std::string& url, int size) { return _favicons.getFavicon(url, size); }
+
+
+std::shared_future<FaviconCache::Image> Session::getPreview(const std::string& url, bool mobile, int width, int height) { return _favicons.getPreview(url, mobile, width, height); }
+
+
+void Session::prefetchFavicons(const std::vector<std::shared_ptr<Password>>& passwords, int size)
+{
+    std::vector<std::string> urls;
+
+
+    for( const std::shared_ptr<Password>& passwd : passwords )
+    {
+        // Read straight from the snapshot, so prefetching doesn't count as using the password.
+        const nlohmann::json url = std::atomic_load(&passwd->_snapshot)->getField("url");
+
+
+        if( url.is_string() && !url.get_ref<const std::string&>().empty() )
+            urls.push_back(url);
+    }
+
+    _favicons.prefetchFavicons(urls, size);
+}
+
+
+bool Session::setFaviconCache(const std::string& directory, size_t diskBytes, size_t memoryBytes)
+{
+    _favicons.setMemoryLimit(memoryBytes);
+
+    return _favicons.setDiskCache(directory, diskBytes);
+}
+
+
 }
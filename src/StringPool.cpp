@@ -0,0 +1,83 @@
+/*
+ * ncpasscpp. A library that implements Nextcloud Password's API.
+ * Copyright (C) 2021  Reed Krantz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <memory>
+#include <mutex>
+#include <StringPool.hpp>
+
+
+namespace ncpass
+{
+
+
+StringPool::StringPool() :
+    k_state(std::make_shared<State>())
+{}
+
+
+StringPool::Handle StringPool::intern(const std::string& str)
+{
+    std::unique_lock lock(k_state->mutex);
+
+
+    auto itr = k_state->strings.find(str);
+
+    if( itr != k_state->strings.end() )
+    {
+        if( Handle handle = itr->second.lock() )
+            return handle;
+
+        // The last handle is being destroyed right now. Its deleter will skip the erase since the entry gets replaced.
+        k_state->strings.erase(itr);
+    }
+
+    Handle handle(
+      new std::string(str), [weakState = std::weak_ptr<State>(k_state)] (const std::string* interned)
+      {
+          if( auto state = weakState.lock() )
+          {
+              std::unique_lock lock(state->mutex);
+              auto             itr = state->strings.find(*interned);
+
+
+              // Only erase the entry if it still belongs to this string.
+              if( (itr != state->strings.end()) && (itr->first.data() == interned->data()) )
+                  state->strings.erase(itr);
+          }
+
+          delete interned;
+      }
+      );
+
+
+    k_state->strings.emplace(*handle, handle);
+
+    return handle;
+}
+
+
+size_t StringPool::size() const
+{
+    std::unique_lock lock(k_state->mutex);
+
+
+    return k_state->strings.size();
+}
+
+
+}
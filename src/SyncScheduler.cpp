@@ -0,0 +1,172 @@
+/*
+ * ncpasscpp. A library that implements Nextcloud Password's API.
+ * Copyright (C) 2021  Reed Krantz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+#include <random>
+#include <thread>
+#include <Password.hpp>
+#include <Session.hpp>
+#include <SyncScheduler.hpp>
+
+
+namespace ncpass
+{
+
+
+SyncScheduler::SyncScheduler() :
+    _running(false)
+{}
+
+
+std::chrono::steady_clock::duration SyncScheduler::addJitter(std::chrono::steady_clock::duration delay, double jitter)
+{
+    thread_local std::minstd_rand engine(std::random_device {}());
+
+    std::uniform_real_distribution<double> factor(1.0 - jitter, 1.0 + jitter);
+
+
+    return std::chrono::duration_cast<std::chrono::steady_clock::duration>(delay * factor(engine));
+}
+
+
+void SyncScheduler::run()
+{
+    std::unique_lock lock(_mutex);
+
+
+    for( ;; )
+    {
+        auto next = _entries.end();
+
+
+        for( auto itr = _entries.begin(); itr != _entries.end(); itr++ )
+        {
+            if( (next == _entries.end()) || (itr->second.due < next->second.due) )
+                next = itr;
+        }
+
+        // The timer thread only runs while there are Sessions to keep fresh. SyncScheduler::add() starts it again.
+        if( next == _entries.end() )
+        {
+            _running = false;
+            return;
+        }
+
+        // A copy since the entry can be removed while waiting.
+        const std::chrono::steady_clock::time_point due = next->second.due;
+
+
+        if( std::chrono::steady_clock::now() < due )
+        {
+            _conVar.wait_until(lock, due);
+            continue;
+        }
+
+        std::shared_ptr<Session> session = next->second.session.lock();
+
+
+        if( !session )
+        {
+            _entries.erase(next);
+            continue;
+        }
+
+        const Session* key   = next->first;
+        Entry          entry = next->second;
+
+
+        lock.unlock();
+
+        const std::chrono::steady_clock::time_point now    = std::chrono::steady_clock::now();
+        bool                                        active = false;
+
+        std::chrono::steady_clock::duration delay = Password::refresh(session, entry.settings, entry.interval, entry.lastTick, active);
+
+
+        session.reset();
+
+        // An idle Session backs off. Touching any of its passwords brings it right back.
+        entry.interval = active ? entry.settings.interval : std::min(entry.interval * 2, entry.settings.maxInterval);
+
+        // A backlog is worked off one batch per second.
+        delay = std::clamp<std::chrono::steady_clock::duration>(delay, std::chrono::seconds(1), entry.interval);
+
+        lock.lock();
+
+        auto itr = _entries.find(key);
+
+
+        // The Session might have been removed or added again with other settings in the meantime.
+        if( (itr != _entries.end()) && (itr->second.due == entry.due) )
+        {
+            itr->second.interval = entry.interval;
+            itr->second.lastTick = now;
+            itr->second.due      = now + addJitter(delay, entry.settings.jitter);
+        }
+    }
+}
+
+
+SyncScheduler& SyncScheduler::get()
+{
+    // Never destroyed so a detached timer thread that's still running at exit can't outlive it.
+    static SyncScheduler* scheduler = new SyncScheduler();
+
+
+    return *scheduler;
+}
+
+
+void SyncScheduler::add(const std::shared_ptr<Session>& session, const Settings& settings)
+{
+    std::unique_lock                            lock(_mutex);
+    const std::chrono::steady_clock::time_point now   = std::chrono::steady_clock::now();
+    Entry&                                      entry = _entries[session.get()];
+
+
+    entry.session  = session;
+    entry.settings = settings;
+    entry.interval = settings.interval;
+    entry.lastTick = now;
+    entry.due      = now + addJitter(std::min(settings.hotInterval, settings.interval), settings.jitter);
+
+    if( !_running )
+    {
+        std::thread t1([this] () { run(); });
+
+
+        t1.detach();
+        _running = true;
+    }
+
+    _conVar.notify_one();
+}
+
+
+void SyncScheduler::remove(const Session* session)
+{
+    std::unique_lock lock(_mutex);
+
+
+    _entries.erase(session);
+    _conVar.notify_one();
+}
+
+
+}
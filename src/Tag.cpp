@@ -0,0 +1,206 @@
+/*
+ * ncpasscpp. A library that implements Nextcloud Password's API.
+ * Copyright (C) 2021  Reed Krantz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <future>
+#include <memory>
+#include <shared_mutex>
+#include <stdexcept>
+#include <thread>
+#include <nlohmann/json.hpp>
+#include <Session.hpp>
+#include <Tag.hpp>
+#include "API_Implementor.cpp"
+#include "utils.hpp"
+
+
+namespace ncpass
+{
+
+
+void Tag::merge(const nlohmann::json& json_new)
+{
+    _json.merge_patch(json_new);
+
+    if( auto tag = weak_from_this().lock() )
+        getSession()._relations.setTag(tag, _json.at("id"));
+
+    setMemoryUsage(MemoryAccount::PAYLOADS, utils::jsonSize(_json));
+    _pullFailed = false;
+    _updateConVar.notify_all();
+}
+
+
+Tag::Tag(const std::shared_ptr<Session>& session, const nlohmann::json& tag_json) :
+    _Base(session, "tag"),
+    _json(tag_json),
+    _pullFailed(false),
+    _decryptionFailed(false)
+{}
+
+
+void Tag::pull()
+{
+    std::thread t1([tag = shared_from_this()] ()
+      {
+          nlohmann::json apiArgs;
+
+
+          apiArgs["id"] = tag->getID();
+
+          nlohmann::json json_new = tag->apiCall(POST, "show", apiArgs);
+
+
+          if( (json_new.value("id", "") == apiArgs.at("id")) && json_new.contains("revision") )
+          {
+              std::unique_lock memberLock(tag->_memberMutex);
+              tag->merge(json_new);
+          }
+          else
+          {
+              std::unique_lock memberLock(tag->_memberMutex);
+
+              tag->_pullFailed = true;
+              tag->_updateConVar.notify_all();
+          }
+      }
+      );
+
+
+    t1.detach();
+}
+
+
+std::shared_ptr<Tag> Tag::fetch(const std::shared_ptr<Session>& session, const std::string& id)
+{
+    nlohmann::json json;
+
+
+    json["id"] = id;
+
+    std::shared_ptr<Tag> toReturn = (new Tag(session, json))->registerInstance();
+
+
+    toReturn->pull();
+
+    return toReturn;
+}
+
+
+std::future<std::vector<std::shared_ptr<Tag>>> Tag::fetchAll(const std::shared_ptr<Session>& session)
+{
+    return std::async(
+      std::launch::async, [session] ()
+      {
+          std::vector<std::shared_ptr<Tag>> tags;
+          nlohmann::json json_list = _Base::apiCall(*session, "tag/", POST, "list", nlohmann::json::object());
+
+
+          if( !json_list.is_array() )
+              throw std::runtime_error("The server didn't return a list of tags.");
+
+          for( const nlohmann::json& json_new : json_list )
+          {
+              if( !json_new.contains("id") )
+                  continue;
+
+              nlohmann::json json_id;
+
+
+              json_id["id"] = json_new.at("id");
+
+              std::shared_ptr<Tag> tag = (new Tag(session, json_id))->registerInstance();
+
+              {
+                  std::unique_lock memberLock(tag->_memberMutex);
+                  tag->merge(json_new);
+              }
+
+              tags.push_back(tag);
+          }
+
+          return tags;
+      }
+      );
+}
+
+
+std::vector<std::shared_ptr<Tag>> Tag::getAll() { return _Base::getRegistered(); }
+
+
+MemoryUsage Tag::getMemoryUsage() { return _Base::getTypeMemoryUsage(); }
+
+
+std::string Tag::getField(const std::string& key) const
+{
+    std::shared_lock lock(_memberMutex);
+
+
+    _updateConVar.wait(lock, [this, &key] { return _json.contains(key) || _pullFailed; });
+
+    if( !_json.contains(key) )
+        return "";
+
+    if( _json.value("cseType", "none") == "none" )
+        return _json.at(key);
+
+    const std::string cipher = _json.at(key);
+    const std::string keyID  = _json.value("cseKey", "");
+
+
+    lock.unlock();
+
+    std::optional<std::string> plain = getSession()._keychain.decrypt(keyID, cipher);
+
+
+    _decryptionFailed = !plain;
+
+    return plain.value_or("");
+}
+
+
+std::string Tag::getID() const
+{
+    std::shared_lock lock(_memberMutex);
+
+
+    return _json.at("id");
+}
+
+
+bool Tag::hasDecryptionFailed() const { return _decryptionFailed; }
+
+
+bool Tag::hasPullFailed() const
+{
+    std::shared_lock lock(_memberMutex);
+
+
+    return _pullFailed;
+}
+
+
+std::string Tag::getLabel() const { return getField("label"); }
+
+
+std::string Tag::getColor() const { return getField("color"); }
+
+
+std::vector<std::shared_ptr<Password>> Tag::getPasswords() const { return getSession()._relations.getTagPasswords(getID()); }
+
+
+}
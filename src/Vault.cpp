@@ -0,0 +1,400 @@
+/*
+ * ncpasscpp. A library that implements Nextcloud Password's API.
+ * Copyright (C) 2021  Reed Krantz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <future>
+#include <istream>
+#include <iterator>
+#include <optional>
+#include <ostream>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include <Password.hpp>
+#include <Session.hpp>
+#include <Vault.hpp>
+#include "API_Implementor.cpp"
+
+
+namespace ncpass
+{
+
+
+Vault::Importer::Importer(const std::shared_ptr<Session>& session, const CancellationToken& token) :
+    _session(session),
+    _token(token),
+    _result({ 0, 0, 0, true, {} })
+{}
+
+
+void Vault::Importer::collect()
+{
+    if( !_inFlight.valid() )
+        return;
+
+    const std::vector<bool> created = _inFlight.get();
+
+
+    for( size_t i = 0; i < created.size(); i++ )
+    {
+        if( created[i] )
+        {
+            _result.created++;
+            _passwords[i]->evict();
+            _passwords[i]->release();
+        }
+        else
+        {
+            _result.failed++;
+            _result.pending.push_back(std::move(_passwords[i]));
+        }
+    }
+
+    _passwords.clear();
+}
+
+
+void Vault::Importer::submit()
+{
+    collect();
+
+    // Records that were read before the token was cancelled are still handed over, so they come back as pending.
+    if( _batch.empty() )
+        return;
+
+    Password::CreateBatch created = Password::createMany(_session, _batch, _token);
+
+
+    _passwords = std::move(created.passwords);
+    _inFlight  = std::move(created.created);
+    _batch.clear();
+}
+
+
+void Vault::Importer::add(const nlohmann::json& json)
+{
+    nlohmann::json record = nlohmann::json::object();
+
+
+    for( const char* key : k_importKeys )
+    {
+        auto itr = json.find(key);
+
+
+        if( (itr != json.end()) && !itr->is_null() )
+            record[key] = *itr;
+    }
+
+    // Newer backups store the custom fields as an array, the API expects them as a JSON string.
+    if( record.contains("customFields") && !record.at("customFields").is_string() )
+        record["customFields"] = record.at("customFields").dump();
+
+    if( !record.value("label", nlohmann::json()).is_string() || !record.value("password", nlohmann::json()).is_string() || (record.at("password") == "") )
+    {
+        _result.skipped++;
+        return;
+    }
+
+    _batch.push_back(std::move(record));
+
+    if( _batch.size() >= k_importBatchSize )
+        submit();
+}
+
+
+Vault::ImportResult Vault::Importer::finish(bool complete)
+{
+    submit();
+    collect();
+
+    _result.complete = complete && !_token.isCancelled();
+
+    return _result;
+}
+
+
+std::string Vault::quoteCsv(const std::string& value)
+{
+    std::string quoted = "\"";
+
+
+    for( char c : value )
+    {
+        if( c == '"' )
+            quoted += '"';
+
+        quoted += c;
+    }
+
+    return quoted + '"';
+}
+
+
+bool Vault::readCsvRecord(std::istream& in, std::vector<std::string>& fields)
+{
+    std::string field;
+    bool        quoted = false;
+    int         c;
+
+
+    fields.clear();
+
+    if( in.peek() == std::istream::traits_type::eof() )
+        return false;
+
+    while( (c = in.get()) != std::istream::traits_type::eof() )
+    {
+        if( quoted )
+        {
+            if( c != '"' )
+                field += static_cast<char>(c);
+            else if( in.peek() == '"' )
+                field += static_cast<char>(in.get());
+            else
+                quoted = false;
+        }
+        else if( c == '"' )
+        {
+            quoted = true;
+        }
+        else if( c == ',' )
+        {
+            fields.push_back(std::move(field));
+            field.clear();
+        }
+        else if( c == '\n' )
+        {
+            break;
+        }
+        else if( c != '\r' )
+        {
+            field += static_cast<char>(c);
+        }
+    }
+
+    fields.push_back(std::move(field));
+
+    return true;
+}
+
+
+bool Vault::importCsv(std::istream& in, Importer& importer, const CancellationToken& token)
+{
+    std::vector<std::string> header;
+    std::vector<std::string> fields;
+
+
+    if( !readCsvRecord(in, header) )
+        return !in.bad();
+
+    // Maps the columns to fields, columns that don't map to a field are left empty.
+    for( std::string& column : header )
+    {
+        std::string name;
+
+
+        std::transform(column.begin(), column.end(), std::back_inserter(name), [] (unsigned char c) { return std::tolower(c); });
+
+        column.clear();
+
+        for( const char* key : k_csvColumns )
+        {
+            if( name == key )
+                column = key;
+        }
+
+        for( const auto& alias : k_csvAliases )
+        {
+            if( name == alias[0] )
+                column = alias[1];
+        }
+    }
+
+    while( !token.isCancelled() && readCsvRecord(in, fields) )
+    {
+        nlohmann::json record = nlohmann::json::object();
+
+
+        for( size_t i = 0; i < std::min(header.size(), fields.size()); i++ )
+        {
+            if( !header[i].empty() )
+                record[header[i]] = std::move(fields[i]);
+        }
+
+        importer.add(record);
+    }
+
+    return !in.bad();
+}
+
+
+bool Vault::importJson(std::istream& in, Importer& importer, const CancellationToken& token)
+{
+    using Event = nlohmann::json::parse_event_t;
+
+    std::string         key;       // The key of the top level object that is being parsed.
+    std::optional<bool> encrypted; // Unknown until the "encrypted" flag is parsed.
+    bool                rejected  = false; // True once a password came before the flag.
+
+
+    nlohmann::json root = nlohmann::json::parse(
+      in, [&] (int depth, Event event, nlohmann::json& parsed)
+      {
+          if( (depth == 1) && (event == Event::key) )
+          {
+              key = parsed;
+              return true;
+          }
+
+          if( (depth == 1) && (event == Event::value) && (key == "encrypted") )
+              encrypted = (parsed == true);
+
+          // The passwords can't be told apart from encrypted ones without the flag, so a backup that doesn't state it before them is rejected.
+          if( (depth == 2) && (event == Event::object_end) && (key == "passwords") )
+          {
+              if( !encrypted.has_value() )
+                  rejected = true;
+              else if( !*encrypted && !token.isCancelled() )
+                  importer.add(parsed);
+          }
+
+          // Only the password being parsed is kept, everything that's done is discarded right away.
+          return !(((depth == 1) || (depth == 2)) && ((event == Event::value) || (event == Event::object_end) || (event == Event::array_end)));
+      },
+      false
+      );
+
+
+    return !root.is_discarded() && (encrypted == false) && !rejected;
+}
+
+
+Vault::ExportResult Vault::exportPasswords(const std::shared_ptr<Session>& session, std::ostream& out, Format format, const CancellationToken& token)
+{
+    ExportResult          result = { 0, false };
+    std::set<std::string> fetched; // The passwords that were fetched before the export stay as they are.
+
+
+    for( const std::shared_ptr<Password>& passwd : Password::getAll() )
+    {
+        if( &passwd->getSession() == session.get() )
+            fetched.insert(passwd->getID());
+    }
+
+    if( format == CSV )
+    {
+        for( size_t i = 0; i < std::size(k_csvColumns); i++ )
+            out << (i ? "," : "") << k_csvColumns[i];
+
+        out << "\r\n";
+    }
+    else
+    {
+        out << "{\"version\":" << k_backupVersion << ",\"encrypted\":false,\"passwords\":[";
+    }
+
+    std::vector<std::shared_ptr<Password>> passwords;
+    bool                                   listed = true;
+
+
+    // The vault is listed from the server so passwords that weren't fetched yet are exported too.
+    try
+    {
+        passwords = Password::fetchAll(session, Password::MODEL).get();
+    }
+    catch( const std::runtime_error& e )
+    {
+        listed = false;
+    }
+
+    auto itr = passwords.begin();
+
+
+    for( ; itr != passwords.end(); itr++ )
+    {
+        if( token.isCancelled() || !out )
+            break;
+
+        std::shared_ptr<const Password::Snapshot> snapshot = (*itr)->getCompleteSnapshot(token);
+
+
+        // A cancelled snapshot may be missing fields so it isn't written.
+        if( token.isCancelled() )
+            break;
+
+        if( format == CSV )
+        {
+            for( size_t i = 0; i < std::size(k_csvColumns); i++ )
+            {
+                nlohmann::json value = snapshot->getField(k_csvColumns[i]);
+
+
+                out << (i ? "," : "") << quoteCsv(value.is_string() ? value.get<std::string>() : value.dump());
+            }
+
+            out << "\r\n";
+        }
+        else
+        {
+            nlohmann::json json = snapshot->toJson();
+
+
+            // The fields are written decrypted.
+            json["cseType"] = "none";
+            json.erase("cseKey");
+
+            out << (result.written ? ",\n" : "\n") << json.dump();
+        }
+
+        result.written++;
+
+        if( !fetched.count((*itr)->getID()) )
+            (*itr)->evict();
+    }
+
+    // The document is closed even if the export stopped early, so the passwords written so far can still be read back.
+    if( format == JSON )
+        out << "\n],\"folders\":[],\"tags\":[]}\n";
+
+    out.flush();
+
+    result.complete = listed && (itr == passwords.end()) && out.good();
+
+    return result;
+}
+
+
+Vault::ImportResult Vault::importPasswords(const std::shared_ptr<Session>& session, std::istream& in, Format format, const CancellationToken& token)
+{
+    Importer importer(session, token);
+    bool     complete;
+
+
+    if( format == CSV )
+        complete = importCsv(in, importer, token);
+    else
+        complete = importJson(in, importer, token);
+
+    return importer.finish(complete);
+}
+
+
+}
@@ -0,0 +1,134 @@
+/*
+ * ncpasscpp. A library that implements Nextcloud Password's API.
+ * Copyright (C) 2021  Reed Krantz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include <iomanip>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <nlohmann/json.hpp>
+#include <openssl/sha.h>
+#include <sodium.h>
+
+
+namespace ncpass::utils
+{
+
+
+// The helpers are defined inline, so every source that includes them shares one definition and none warns about the helpers it doesn't use.
+
+
+inline std::string SHA1(const std::string& input)
+{
+    unsigned char pwdHash[SHA_DIGEST_LENGTH];
+
+
+    ::SHA1((const unsigned char*)input.c_str(), input.size(), pwdHash);
+
+    std::stringstream sstring;
+
+
+    sstring << std::hex << std::setfill('0');
+
+    for( unsigned int i = 0; i < SHA_DIGEST_LENGTH; i++ )
+        sstring << std::setw(2) << static_cast<unsigned>(pwdHash[i]);
+
+    return sstring.str();
+}
+
+
+inline size_t jsonSize(const nlohmann::json& json)
+{
+    size_t size = sizeof(nlohmann::json);
+
+
+    if( json.is_string() )
+    {
+        size += json.get_ref<const std::string&>().capacity();
+    }
+    else if( json.is_object() )
+    {
+        for( auto itr = json.begin(); itr != json.end(); itr++ )
+            size += itr.key().capacity() + jsonSize(itr.value());
+    }
+    else if( json.is_array() )
+    {
+        for( const nlohmann::json& element : json )
+            size += jsonSize(element);
+    }
+
+    return size;
+}
+
+
+inline void secureWipe(nlohmann::json& json)
+{
+    if( json.is_string() )
+    {
+        std::string& str = json.get_ref<std::string&>();
+
+
+        sodium_memzero(str.data(), str.size());
+    }
+    else if( json.is_structured() )
+    {
+        for( nlohmann::json& element : json )
+            secureWipe(element);
+    }
+}
+
+
+inline std::optional<std::string> hexToBin(const std::string& hex)
+{
+    std::string bin(hex.size() / 2, '\0');
+    size_t      binSize;
+
+
+    if( sodium_hex2bin((unsigned char*)bin.data(), bin.size(), hex.c_str(), hex.size(), nullptr, &binSize, nullptr) != 0 )
+        return std::nullopt;
+
+    bin.resize(binSize);
+
+    return bin;
+}
+
+
+inline std::string binToHex(const std::string& bin)
+{
+    std::string hex(bin.size() * 2 + 1, '\0');
+
+
+    sodium_bin2hex(hex.data(), hex.size(), (const unsigned char*)bin.data(), bin.size());
+    hex.pop_back();
+
+    return hex;
+}
+
+
+inline std::string randomBytes(size_t size)
+{
+    std::string bytes(size, '\0');
+
+
+    randombytes_buf(bytes.data(), bytes.size());
+
+    return bytes;
+}
+
+
+}
@@ -0,0 +1,299 @@
+/*
+ * ncpasscpp. A library that implements Nextcloud Password's API.
+ * Copyright (C) 2021  Reed Krantz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+// A minimal stand-in for the Nextcloud Passwords API so the stress test never touches a real server.
+// Plain HTTP on 127.0.0.1, one thread per connection, passwords kept in memory.
+
+#include <arpa/inet.h>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <netinet/in.h>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+
+class StandInServer
+{
+  private:
+
+    constexpr static const char* k_apiPath = "/apps/passwords/api/1.0/";
+
+    int                      _listenFD;
+    uint16_t                 _port;
+    std::chrono::microseconds _latency;
+    std::thread              _acceptThread;
+    std::vector<std::thread> _connectionThreads;
+    std::vector<int>         _connectionFDs;
+    std::mutex               _connectionsMutex;
+
+    std::map<std::string, nlohmann::json> _passwords;
+    unsigned long                         _revisions = 0;
+    std::mutex                            _passwordsMutex;
+
+    std::atomic<unsigned long> _requests;
+
+
+    nlohmann::json newPassword(const std::string& id, const std::string& label)
+    {
+        return { { "id", id }, { "revision", "r" + std::to_string(++_revisions) }, { "label", label }, { "username", "user" }, { "password", "password" },
+                 { "url", "https://example.com" }, { "notes", "" }, { "customFields", "[]" }, { "hash", "" }, { "folder", "00000000-0000-0000-0000-000000000000" },
+                 { "tags", nlohmann::json::array() }, { "cseType", "none" }, { "cseKey", "" }, { "edited", 0 }, { "status", 0 }, { "statusCode", "GOOD" },
+                 { "share", nullptr }, { "shared", false }, { "hidden", false }, { "trashed", false }, { "favorite", false }, { "created", 0 }, { "updated", 0 } };
+    }
+
+
+    nlohmann::json route(const std::string& action, const nlohmann::json& args, int& status)
+    {
+        std::unique_lock lock(_passwordsMutex);
+
+
+        status = 200;
+
+        if( action == "password/list" )
+        {
+            nlohmann::json list = nlohmann::json::array();
+
+
+            for( const auto& [id, password] : _passwords )
+                list.push_back(password);
+
+            return list;
+        }
+
+        if( (action == "password/show") || (action == "password/update") )
+        {
+            auto itr = _passwords.find(args.value("id", ""));
+
+
+            if( itr == _passwords.end() )
+            {
+                status = 404;
+                return { { "status", "error" }, { "message", "Not found" } };
+            }
+
+            if( action == "password/show" )
+                return itr->second;
+
+            for( const auto& [key, value] : args.items() )
+            {
+                if( itr->second.contains(key) )
+                    itr->second[key] = value;
+            }
+
+            itr->second["revision"] = "r" + std::to_string(++_revisions);
+
+            return { { "id", itr->first }, { "revision", itr->second.at("revision") } };
+        }
+
+        if( action == "password/create" )
+        {
+            char id[48];
+
+
+            snprintf(id, sizeof(id), "10000000-0000-0000-0000-%012lu", _passwords.size());
+
+            nlohmann::json password = newPassword(id, args.value("label", ""));
+
+
+            for( const auto& [key, value] : args.items() )
+            {
+                if( key != "id" )
+                    password[key] = value;
+            }
+
+            _passwords[id] = password;
+            status         = 201;
+
+            return { { "id", id }, { "revision", password.at("revision") } };
+        }
+
+        if( action == "folder/list" )
+            return nlohmann::json::array({ { { "id", "00000000-0000-0000-0000-000000000000" }, { "label", "Home" }, { "parent", "00000000-0000-0000-0000-000000000000" }, { "revision", "r0" } } });
+
+        if( action == "tag/list" )
+            return nlohmann::json::array();
+
+        status = 404;
+
+        return { { "status", "error" }, { "message", "Unknown action" } };
+    }
+
+
+    void serve(int fd)
+    {
+        std::string buffer;
+        char        chunk[16384];
+
+
+        for( ;; )
+        {
+            size_t headerEnd;
+
+
+            while( (headerEnd = buffer.find("\r\n\r\n")) == std::string::npos )
+            {
+                ssize_t received = recv(fd, chunk, sizeof(chunk), 0);
+
+
+                if( received <= 0 )
+                    return;
+
+                buffer.append(chunk, received);
+            }
+
+            std::string head = buffer.substr(0, headerEnd);
+            std::string lower(head);
+
+
+            buffer.erase(0, headerEnd + 4);
+
+            for( char& c : lower )
+                c = std::tolower((unsigned char)c);
+
+            size_t contentLength = 0;
+            size_t pos           = lower.find("content-length:");
+
+
+            if( pos != std::string::npos )
+                contentLength = std::stoul(head.substr(pos + 15));
+
+            if( lower.find("expect: 100-continue") != std::string::npos )
+                send(fd, "HTTP/1.1 100 Continue\r\n\r\n", 25, MSG_NOSIGNAL);
+
+            while( buffer.size() < contentLength )
+            {
+                ssize_t received = recv(fd, chunk, sizeof(chunk), 0);
+
+
+                if( received <= 0 )
+                    return;
+
+                buffer.append(chunk, received);
+            }
+
+            const std::string body = buffer.substr(0, contentLength);
+            const size_t      path = head.find(k_apiPath);
+            std::string       action;
+            int               status;
+
+
+            buffer.erase(0, contentLength);
+
+            if( path != std::string::npos )
+                action = head.substr(path + std::char_traits<char>::length(k_apiPath), head.find(' ', path) - path - std::char_traits<char>::length(k_apiPath));
+
+            _requests++;
+            std::this_thread::sleep_for(_latency);
+
+            const std::string response = route(action, nlohmann::json::parse(body, nullptr, false), status).dump();
+            const std::string reply    = "HTTP/1.1 " + std::to_string(status) + (status < 300 ? " OK" : " Error") +
+                                         "\r\nContent-Type: application/json\r\nContent-Length: " + std::to_string(response.size()) + "\r\n\r\n" + response;
+
+
+            if( send(fd, reply.data(), reply.size(), MSG_NOSIGNAL) != (ssize_t)reply.size() )
+                return;
+        }
+    }
+
+
+  public:
+
+    StandInServer(size_t passwords, std::chrono::microseconds latency) :
+        _listenFD(socket(AF_INET, SOCK_STREAM, 0)),
+        _port(0),
+        _latency(latency),
+        _requests(0)
+    {
+        sockaddr_in address = {};
+        socklen_t   length  = sizeof(address);
+
+
+        for( size_t i = 0; i < passwords; i++ )
+        {
+            char id[48];
+
+
+            snprintf(id, sizeof(id), "00000000-0000-0000-0000-%012zu", i);
+            _passwords[id] = newPassword(id, "Password " + std::to_string(i));
+        }
+
+        address.sin_family      = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        bind(_listenFD, (sockaddr*)&address, sizeof(address));
+        listen(_listenFD, 64);
+        getsockname(_listenFD, (sockaddr*)&address, &length);
+
+        _port = ntohs(address.sin_port);
+
+        _acceptThread = std::thread([this] ()
+          {
+              int fd;
+
+
+              while( (fd = accept(_listenFD, nullptr, nullptr)) >= 0 )
+              {
+                  std::unique_lock lock(_connectionsMutex);
+
+                  _connectionFDs.push_back(fd);
+                  _connectionThreads.emplace_back([this, fd] () { serve(fd); });
+              }
+          }
+          );
+    }
+
+
+    ~StandInServer()
+    {
+        shutdown(_listenFD, SHUT_RDWR);
+        close(_listenFD);
+        _acceptThread.join();
+
+        for( int fd : _connectionFDs )
+            shutdown(fd, SHUT_RDWR);
+
+        for( std::thread& thread : _connectionThreads )
+            thread.join();
+
+        for( int fd : _connectionFDs )
+            close(fd);
+    }
+
+
+    std::string getRoot() const { return "http://127.0.0.1:" + std::to_string(_port); }
+
+
+    unsigned long getRequestCount() const { return _requests; }
+
+
+    nlohmann::json getPassword(const std::string& id)
+    {
+        std::unique_lock lock(_passwordsMutex);
+
+
+        return _passwords.at(id);
+    }
+};
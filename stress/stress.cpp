@@ -0,0 +1,242 @@
+/*
+ * ncpasscpp. A library that implements Nextcloud Password's API.
+ * Copyright (C) 2021  Reed Krantz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+// Stress test and benchmark for concurrent access to passwords.
+// purpose: Hammer the getters, setters, sync(), wait() and getAll() of shared passwords from many threads against a local stand-in server,
+//          report the throughput and lock contention, then verify that every change reached the server.
+// usage: stress [--threads=N] [--seconds=N] [--passwords=N] [--latency-us=N]
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <CancellationToken.hpp>
+#include <Password.hpp>
+#include <ProfiledMutex.hpp>
+#include <Session.hpp>
+#include "standInServer.cpp"
+
+using namespace std;
+
+
+enum Operation
+{
+    GET,
+    SET,
+    SYNC,
+    WAIT,
+    GET_ALL
+};
+
+
+constexpr const char* strOperations[] = { "get", "set", "sync", "wait", "getAll" };
+constexpr unsigned    operationWeights[] = { 60, 15, 10, 5, 10 }; // Out of 100.
+
+
+struct OperationStats
+{
+    unsigned long long count = 0;
+    chrono::nanoseconds total{ 0 };
+    chrono::nanoseconds max{ 0 };
+};
+
+
+int main(int argc, char** argv)
+{
+    unsigned threadCount = max(4u, thread::hardware_concurrency());
+    unsigned seconds     = 10;
+    unsigned passwords   = 200;
+    unsigned latency     = 1000;
+
+
+    for( int i = 1; i < argc; i++ )
+    {
+        if( sscanf(argv[i], "--threads=%u", &threadCount) || sscanf(argv[i], "--seconds=%u", &seconds) || sscanf(argv[i], "--passwords=%u", &passwords) ||
+            sscanf(argv[i], "--latency-us=%u", &latency) )
+            continue;
+
+        cout << "usage: " << argv[0] << " [--threads=N] [--seconds=N] [--passwords=N] [--latency-us=N]\n";
+
+        return 1;
+    }
+
+    StandInServer server(passwords, chrono::microseconds(latency));
+
+    shared_ptr<ncpass::Session>               session = ncpass::Session::create("stress", server.getRoot(), "stress");
+    vector<shared_ptr<ncpass::Password>>      all     = ncpass::Password::fetchAll(session, ncpass::Password::MODEL).get();
+    vector<array<OperationStats, GET_ALL + 1>> stats(threadCount);
+    vector<thread>                             threads;
+    atomic<bool>                               running(true);
+
+
+    if( all.size() != passwords )
+    {
+        cout << "Fetched " << all.size() << " of " << passwords << " passwords.\n";
+
+        return 1;
+    }
+
+    cout << threadCount << " threads, " << seconds << " s, " << passwords << " passwords, " << latency << " us server latency\n";
+
+    ncpass::LockProfiler::reset();
+
+    const auto start = chrono::steady_clock::now();
+
+
+    for( unsigned t = 0; t < threadCount; t++ )
+    {
+        threads.emplace_back([&, t] ()
+          {
+              mt19937                         random(t);
+              uniform_int_distribution<size_t> pickPassword(0, all.size() - 1);
+              discrete_distribution<int>       pickOperation(begin(operationWeights), end(operationWeights));
+              unsigned long                    edits = 0;
+
+
+              while( running )
+              {
+                  const Operation                  operation = (Operation)pickOperation(random);
+                  const shared_ptr<ncpass::Password>& passwd    = all[pickPassword(random)];
+                  const auto                       opStart   = chrono::steady_clock::now();
+
+
+                  switch( operation )
+                  {
+                      case GET:
+                          passwd->getLabel();
+                          passwd->getUsername();
+                          passwd->getPassword();
+                          passwd->getNotes();
+                          break;
+
+                      case SET:
+                          passwd->setNotes("thread " + to_string(t) + " edit " + to_string(++edits));
+                          break;
+
+                      case SYNC:
+                          passwd->sync();
+                          break;
+
+                      case WAIT:
+                          passwd->wait(ncpass::CancellationToken::after(chrono::milliseconds(100)));
+                          break;
+
+                      case GET_ALL:
+                          ncpass::Password::getAll();
+                          break;
+                  }
+
+                  const chrono::nanoseconds elapsed = chrono::steady_clock::now() - opStart;
+                  OperationStats&           opStats = stats[t][operation];
+
+
+                  opStats.count++;
+                  opStats.total += elapsed;
+                  opStats.max    = max(opStats.max, elapsed);
+              }
+          }
+          );
+    }
+
+    this_thread::sleep_for(chrono::seconds(seconds));
+    running = false;
+
+    for( thread& thread : threads )
+        thread.join();
+
+    const double duration = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+
+    cout << fixed << setprecision(1) << '\n' << left << setw(10) << "operation" << right << setw(12) << "ops" << setw(12) << "ops/s" << setw(12) << "avg us" << setw(12)
+         << "max us" << '\n';
+
+    unsigned long long total = 0;
+
+
+    for( int op = GET; op <= GET_ALL; op++ )
+    {
+        OperationStats merged;
+
+
+        for( const auto& threadStats : stats )
+        {
+            merged.count += threadStats[op].count;
+            merged.total += threadStats[op].total;
+            merged.max    = max(merged.max, threadStats[op].max);
+        }
+
+        total += merged.count;
+
+        cout << left << setw(10) << strOperations[op] << right << setw(12) << merged.count << setw(12) << merged.count / duration << setw(12)
+             << (merged.count ? chrono::duration<double, micro>(merged.total).count() / merged.count : 0.0) << setw(12) << chrono::duration<double, micro>(merged.max).count()
+             << '\n';
+    }
+
+    cout << left << setw(10) << "total" << right << setw(12) << total << setw(12) << total / duration << "\n\n";
+
+    if( ncpass::LockProfiler::isEnabled() )
+    {
+        cout << left << setw(28) << "lock" << right << setw(12) << "locks" << setw(12) << "contended" << setw(12) << "wait avg us" << setw(12) << "wait max us" << setw(12)
+             << "hold avg us" << setw(12) << "hold max us" << '\n';
+
+        for( const ncpass::LockProfiler::Stats& lock : ncpass::LockProfiler::getStats() )
+        {
+            const double locks = max<double>(1, lock.acquisitions);
+
+
+            cout << left << setw(28) << lock.name << right << setw(12) << lock.acquisitions << setw(12) << lock.contentions << setw(12)
+                 << chrono::duration<double, micro>(lock.totalWait).count() / locks << setw(12) << chrono::duration<double, micro>(lock.maxWait).count() << setw(12)
+                 << chrono::duration<double, micro>(lock.totalHold).count() / locks << setw(12) << chrono::duration<double, micro>(lock.maxHold).count() << '\n';
+        }
+    }
+    else
+    {
+        cout << "Lock wait and hold times are only collected when built with -Dlock_stats=true.\n";
+    }
+
+    cout << "\nserver requests: " << server.getRequestCount() << '\n';
+
+    // Every change has to end up on the server.
+    if( !session->flush(ncpass::CancellationToken::after(chrono::seconds(60))).get() )
+    {
+        cout << "Flushing the pending changes timed out.\n";
+
+        return 1;
+    }
+
+    unsigned mismatches = 0;
+
+
+    for( const shared_ptr<ncpass::Password>& passwd : all )
+    {
+        if( passwd->getNotes() != server.getPassword(passwd->getID()).value("notes", "") )
+            mismatches++;
+    }
+
+    cout << "passwords out of sync with the server: " << mismatches << '\n';
+
+    return mismatches ? 1 : 0;
+}
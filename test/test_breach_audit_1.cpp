@@ -0,0 +1,154 @@
+/*
+ * ncpasscpp. A library that implements Nextcloud Password's API.
+ * Copyright (C) 2021  Reed Krantz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+// Test for BreachAudit class
+// purpose: Look up hashes in breach lists, including the first and last entries, prefixes, CRLF line breaks and lists without counts.
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <BreachAudit.hpp>
+
+// Used to format output as an argument to std::setw().
+#define TEST_WIDTH 32
+
+using namespace std;
+
+
+int main(int argc, char** argv)
+{
+    if( argc != 1 )
+    {
+        cout << argv[0] << " takes no arguments.\n";
+
+        return 1;
+    }
+
+    // print "true"/"false" for bools
+    cout << boolalpha;
+
+    const string path = (filesystem::temp_directory_path() / ("test_breach_audit_1-" + to_string(::getpid()))).string();
+
+    mt19937_64     random(1);
+    vector<string> hashes;
+
+
+    // Random SHA-1 hashes, sorted like the lists from haveibeenpwned.com.
+    for( int i = 0; i < 10000; i++ )
+    {
+        string hash;
+
+
+        for( int j = 0; j < 40; j++ )
+            hash += "0123456789ABCDEF"[random() % 16];
+
+        hashes.push_back(hash);
+    }
+
+    sort(hashes.begin(), hashes.end());
+    hashes.erase(unique(hashes.begin(), hashes.end()), hashes.end());
+
+    // Writes the hashes with the count i + 1.
+    auto writeList = [&] (const string& lineBreak, bool counts)
+      {
+          ofstream file(path, ios::trunc | ios::binary);
+
+
+          for( size_t i = 0; i < hashes.size(); i++ )
+              file << hashes[i] << (counts ? ":" + to_string(i + 1) : "") << (i + 1 < hashes.size() ? lineBreak : "");
+      };
+
+    // Looks up every hash and returns true if all counts are right.
+    auto lookupAll = [&] (const ncpass::BreachAudit& audit, bool counts)
+      {
+          for( size_t i = 0; i < hashes.size(); i++ )
+          {
+              if( audit.lookup(hashes[i]) != (counts ? i + 1 : 1) )
+                  return false;
+          }
+
+          return true;
+      };
+
+    std::vector<bool> tests; // The results of all the tests.
+
+
+    writeList("\n", true);
+
+    {
+        shared_ptr<ncpass::BreachAudit> audit = ncpass::BreachAudit::open(path);
+
+        string lower = hashes[42];
+        string after = hashes.back();
+
+
+        transform(lower.begin(), lower.end(), lower.begin(), [] (unsigned char c) { return tolower(c); });
+        after.back() = (after.back() == 'F') ? 'E' : 'F';
+
+        tests.push_back(false); cout << setw(TEST_WIDTH) << "Open pass? "     << (tests.back() = bool(audit)) << endl;
+        tests.push_back(false); cout << setw(TEST_WIDTH) << "Lookup pass? "   << (tests.back() = audit && lookupAll(*audit, true)) << endl;
+        tests.push_back(false); cout << setw(TEST_WIDTH) << "Boundary pass? " << (tests.back() = audit && (audit->lookup(hashes.front()) == 1) && (audit->lookup(hashes.back()) == hashes.size())) << endl;
+        tests.push_back(false); cout << setw(TEST_WIDTH) << "Case pass? "     << (tests.back() = audit && (audit->lookup(lower) == 43)) << endl;
+        tests.push_back(false); cout << setw(TEST_WIDTH) << "Prefix pass? "   << (tests.back() = audit && (audit->lookup(hashes[1234].substr(0, 20)) == 1235)) << endl;
+        tests.push_back(false); cout << setw(TEST_WIDTH) << "Missing pass? "
+                                     << (tests.back() = audit && !audit->lookup(string(40, '0')) && !audit->lookup(string(40, 'F')) && (after == hashes.back() || !audit->lookup(after))) << endl;
+        tests.push_back(false); cout << setw(TEST_WIDTH) << "Invalid pass? "  << (tests.back() = audit && !audit->lookup("") && !audit->lookup(hashes[7].substr(0, 39) + "G") && !audit->lookup(hashes[7] + "0")) << endl;
+    }
+
+    writeList("\r\n", true);
+
+    {
+        shared_ptr<ncpass::BreachAudit> audit = ncpass::BreachAudit::open(path);
+
+
+        tests.push_back(false); cout << setw(TEST_WIDTH) << "CRLF pass? " << (tests.back() = audit && lookupAll(*audit, true)) << endl;
+    }
+
+    writeList("\n", false);
+
+    {
+        shared_ptr<ncpass::BreachAudit> audit = ncpass::BreachAudit::open(path);
+
+
+        tests.push_back(false); cout << setw(TEST_WIDTH) << "No counts pass? " << (tests.back() = audit && lookupAll(*audit, false)) << endl;
+    }
+
+    ofstream(path, ios::trunc);
+
+    tests.push_back(false); cout << setw(TEST_WIDTH) << "Empty pass? " << (tests.back() = !ncpass::BreachAudit::open(path)) << endl;
+
+    filesystem::remove(path);
+
+
+    // return fail status if any tests failed
+    for( bool test : tests )
+    {
+        if( !test )
+            return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,176 @@
+/*
+ * ncpasscpp. A library that implements Nextcloud Password's API.
+ * Copyright (C) 2021  Reed Krantz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+// Test for CancellationToken class
+// purpose: Check cancelling, deadlines, urgency and waiting on a condition variable with a token.
+
+#include <chrono>
+#include <condition_variable>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <CancellationToken.hpp>
+
+// Used to format output as an argument to std::setw().
+#define TEST_WIDTH 32
+
+using namespace std;
+
+
+int main(int argc, char** argv)
+{
+    if( argc != 1 )
+    {
+        cout << argv[0] << " takes no arguments.\n";
+
+        return 1;
+    }
+
+    // print "true"/"false" for bools
+    cout << boolalpha;
+
+    std::vector<bool> tests; // The results of all the tests.
+
+
+    // Copies share their state.
+    {
+        ncpass::CancellationToken token;
+        ncpass::CancellationToken copy = token;
+
+        const bool fresh = !token.isCancelled() && !token.isUrgent() && (token.getDeadline() == std::chrono::steady_clock::time_point::max());
+
+
+        copy.setUrgent();
+        copy.cancel();
+
+        tests.push_back(false); cout << setw(TEST_WIDTH) << "Fresh pass? "  << (tests.back() = fresh) << endl;
+        tests.push_back(false); cout << setw(TEST_WIDTH) << "Cancel pass? " << (tests.back() = token.isCancelled() && token.isUrgent()) << endl;
+    }
+
+    // A token with a timeout counts as cancelled once its deadline passed.
+    {
+        ncpass::CancellationToken token = ncpass::CancellationToken::after(50ms);
+
+        const bool early = !token.isCancelled();
+
+
+        std::this_thread::sleep_for(60ms);
+
+        tests.push_back(false); cout << setw(TEST_WIDTH) << "Deadline pass? " << (tests.back() = early && token.isCancelled()) << endl;
+    }
+
+    std::mutex              mutex;
+    std::condition_variable conVar;
+    bool                    ready = false;
+
+
+    // Waiting returns true once the predicate is true.
+    {
+        ncpass::CancellationToken token = ncpass::CancellationToken::after(1s);
+        std::unique_lock          lock(mutex);
+
+        std::thread notifier([&] ()
+          {
+              std::this_thread::sleep_for(20ms);
+
+              std::unique_lock notifyLock(mutex);
+
+              ready = true;
+              conVar.notify_all();
+          }
+          );
+
+
+        const bool waited = token.wait(conVar, lock, [&] () { return ready; });
+
+
+        lock.unlock();
+        notifier.join();
+
+        tests.push_back(false); cout << setw(TEST_WIDTH) << "Wait pass? " << (tests.back() = waited && !token.isCancelled()) << endl;
+    }
+
+    ready = false;
+
+    // Cancelling wakes up a waiting thread, nobody has to notify the condition variable.
+    {
+        ncpass::CancellationToken token;
+        std::unique_lock          lock(mutex);
+
+        const auto start = std::chrono::steady_clock::now();
+
+        std::thread canceller([token] () mutable
+          {
+              std::this_thread::sleep_for(20ms);
+              token.cancel();
+          }
+          );
+
+
+        const bool waited = token.wait(conVar, lock, [&] () { return ready; });
+
+
+        lock.unlock();
+        canceller.join();
+
+        tests.push_back(false); cout << setw(TEST_WIDTH) << "Wait cancel pass? " << (tests.back() = !waited && (std::chrono::steady_clock::now() - start < 1s)) << endl;
+    }
+
+    // The deadline wakes up a waiting thread as well.
+    {
+        ncpass::CancellationToken token = ncpass::CancellationToken::after(30ms);
+        std::unique_lock          lock(mutex);
+
+        const auto start     = std::chrono::steady_clock::now();
+        const bool waited    = token.wait(conVar, lock, [&] () { return ready; });
+        const auto waitedFor = std::chrono::steady_clock::now() - start;
+
+
+        tests.push_back(false); cout << setw(TEST_WIDTH) << "Wait deadline pass? " << (tests.back() = !waited && (waitedFor >= 30ms) && (waitedFor < 1s)) << endl;
+    }
+
+    // A wake up function is only called while it's registered.
+    {
+        ncpass::CancellationToken token;
+        int                       calls = 0;
+
+
+        {
+            ncpass::CancellationToken::Wakeup wakeup(token, [&calls] () { calls++; });
+
+            token.setUrgent();
+        }
+
+        token.cancel();
+
+        tests.push_back(false); cout << setw(TEST_WIDTH) << "Wakeup pass? " << (tests.back() = calls == 1) << endl;
+    }
+
+
+    // return fail status if any tests failed
+    for( bool test : tests )
+    {
+        if( !test )
+            return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,159 @@
+/*
+ * ncpasscpp. A library that implements Nextcloud Password's API.
+ * Copyright (C) 2021  Reed Krantz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+// Test for Journal class
+// purpose: Write edits to a journal and read back the ones that are still pending, with a wrong passphrase, a torn last record and a damaged record.
+
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <Journal.hpp>
+#include <nlohmann/json.hpp>
+
+// Used to format output as an argument to std::setw().
+#define TEST_WIDTH 32
+
+using namespace std;
+
+
+// Reads a whole file.
+string readFile(const string& path)
+{
+    ifstream      file(path);
+    ostringstream content;
+
+
+    content << file.rdbuf();
+
+    return content.str();
+}
+
+
+int main(int argc, char** argv)
+{
+    if( argc != 1 )
+    {
+        cout << argv[0] << " takes no arguments.\n";
+
+        return 1;
+    }
+
+    // print "true"/"false" for bools
+    cout << boolalpha;
+
+    const string path = (filesystem::temp_directory_path() / ("test_journal_1-" + to_string(::getpid()))).string();
+
+    std::vector<bool> tests; // The results of all the tests.
+
+
+    // A new journal has nothing pending.
+    {
+        ncpass::Journal journal;
+
+        optional<map<string, nlohmann::json>> pending = journal.open(path, "passphrase");
+
+
+        tests.push_back(false); cout << setw(TEST_WIDTH) << "Create pass? " << (tests.back() = pending && pending->empty() && journal.isOpen()) << endl;
+
+        journal.append({ { "type", "edit" },    { "key", "a" },   { "patch", { { "label", "A" } } } });
+        journal.append({ { "type", "edit" },    { "key", "b" },   { "patch", { { "label", "B" } } } });
+        journal.append({ { "type", "edit" },    { "key", "a" },   { "patch", { { "notes", "A notes" } } } });
+        journal.append({ { "type", "synced" },  { "key", "b" } });
+        journal.append({ { "type", "edit" },    { "key", "new" }, { "patch", { { "label", "C" } } } });
+        journal.append({ { "type", "created" }, { "key", "new" }, { "id", "c" } });
+
+        tests.push_back(false); cout << setw(TEST_WIDTH) << "Flush pass? " << (tests.back() = journal.flush()) << endl;
+    }
+
+    const map<string, nlohmann::json> expected = { { "a", { { "label", "A" }, { "notes", "A notes" } } }, { "c", { { "label", "C" } } } };
+    const string                      written  = readFile(path);
+
+
+    // A wrong passphrase is detected and leaves the file alone.
+    {
+        ncpass::Journal journal;
+
+
+        tests.push_back(false); cout << setw(TEST_WIDTH) << "Wrong passphrase pass? " << (tests.back() = !journal.open(path, "wrong") && !journal.isOpen() && (readFile(path) == written)) << endl;
+    }
+
+    // The pending edits are merged per password, synced ones are dropped and created ones move to their ID.
+    {
+        ncpass::Journal journal;
+
+        optional<map<string, nlohmann::json>> pending = journal.open(path, "passphrase");
+
+
+        tests.push_back(false); cout << setw(TEST_WIDTH) << "Round trip pass? " << (tests.back() = pending && (*pending == expected)) << endl;
+    }
+
+    // A torn last record is dropped.
+    {
+        ncpass::Journal journal;
+
+
+        ofstream(path, ios::app) << written.substr(written.rfind('\n', written.size() - 2) + 1, 40);
+
+        optional<map<string, nlohmann::json>> pending = journal.open(path, "passphrase");
+
+
+        tests.push_back(false); cout << setw(TEST_WIDTH) << "Torn tail pass? " << (tests.back() = pending && (*pending == expected)) << endl;
+    }
+
+    // A damaged record before the last one makes the journal untrusted.
+    {
+        ncpass::Journal journal;
+        string          damaged = readFile(path);
+
+
+        damaged[damaged.find('\n') + 60] ^= 1;
+        ofstream(path, ios::trunc) << damaged;
+
+        tests.push_back(false); cout << setw(TEST_WIDTH) << "Damaged pass? " << (tests.back() = !journal.open(path, "passphrase") && (readFile(path) == damaged)) << endl;
+    }
+
+    // Anything that isn't a journal is left alone.
+    {
+        ncpass::Journal journal;
+
+
+        ofstream(path, ios::trunc) << "not a journal\n";
+
+        tests.push_back(false); cout << setw(TEST_WIDTH) << "Foreign file pass? " << (tests.back() = !journal.open(path, "passphrase") && (readFile(path) == "not a journal\n")) << endl;
+    }
+
+    filesystem::remove(path);
+
+
+    // return fail status if any tests failed
+    for( bool test : tests )
+    {
+        if( !test )
+            return 1;
+    }
+
+    return 0;
+}
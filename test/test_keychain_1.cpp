@@ -0,0 +1,94 @@
+/*
+ * ncpasscpp. A library that implements Nextcloud Password's API.
+ * Copyright (C) 2021  Reed Krantz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+// Test for Keychain class
+// purpose: Solve a known "PWDv1r1" challenge and reject challenges that aren't supported or are malformed.
+
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+#include <Keychain.hpp>
+#include <nlohmann/json.hpp>
+
+// Used to format output as an argument to std::setw().
+#define TEST_WIDTH 32
+
+using namespace std;
+
+
+int main(int argc, char** argv)
+{
+    if( argc != 1 )
+    {
+        cout << argv[0] << " takes no arguments.\n";
+
+        return 1;
+    }
+
+    // print "true"/"false" for bools
+    cout << boolalpha;
+
+    const string         password  = "correct horse battery staple";
+    const nlohmann::json challenge = { { "type", "PWDv1r1" },
+                                       { "salts", { "0102030405060708090a0b0c0d0e0f10",
+                                                    "202122232425262728292a2b2c2d2e2f303132333435363738393a3b3c3d3e3f",
+                                                    "6465666768696a6b6c6d6e6f70717273" } } };
+
+    // Returns a copy of the challenge with one value replaced.
+    auto changed = [&] (const nlohmann::json::json_pointer& pointer, const nlohmann::json& value)
+      {
+          nlohmann::json copy = challenge;
+
+
+          copy[pointer] = value;
+
+          return copy;
+      };
+
+    std::vector<bool> tests; // The results of all the tests.
+
+
+    // Computed with libsodium directly: argon2id(blake2b(password + salt 0, key: salt 1), salt 2) with the interactive limits.
+    tests.push_back(false); cout << setw(TEST_WIDTH) << "Solve pass? "
+                                 << (tests.back() = ncpass::Keychain::solveChallenge(challenge, password) == "d71b354bc51e55ac982a9a2a95a0fa7ab751dbc751e8077cff45f2858e30e3d5") << endl;
+    tests.push_back(false); cout << setw(TEST_WIDTH) << "Wrong password pass? "
+                                 << (tests.back() = ncpass::Keychain::solveChallenge(challenge, "wrong") != "d71b354bc51e55ac982a9a2a95a0fa7ab751dbc751e8077cff45f2858e30e3d5") << endl;
+
+    tests.push_back(false); cout << setw(TEST_WIDTH) << "Type pass? "        << (tests.back() = !ncpass::Keychain::solveChallenge(changed("/type"_json_pointer, "PWDv2r1"), password)) << endl;
+    tests.push_back(false); cout << setw(TEST_WIDTH) << "Type type pass? "   << (tests.back() = !ncpass::Keychain::solveChallenge(changed("/type"_json_pointer, 1), password)) << endl;
+    tests.push_back(false); cout << setw(TEST_WIDTH) << "Salt count pass? "  << (tests.back() = !ncpass::Keychain::solveChallenge(changed("/salts/3"_json_pointer, "00"), password)) << endl;
+    tests.push_back(false); cout << setw(TEST_WIDTH) << "Hex pass? "         << (tests.back() = !ncpass::Keychain::solveChallenge(changed("/salts/0"_json_pointer, "0g"), password)) << endl;
+    tests.push_back(false); cout << setw(TEST_WIDTH) << "Salt size pass? "   << (tests.back() = !ncpass::Keychain::solveChallenge(changed("/salts/2"_json_pointer, "6465"), password)) << endl;
+    tests.push_back(false); cout << setw(TEST_WIDTH) << "Key size pass? "    << (tests.back() = !ncpass::Keychain::solveChallenge(changed("/salts/1"_json_pointer, string(130, 'a')), password)) << endl;
+    tests.push_back(false); cout << setw(TEST_WIDTH) << "Salt type pass? "   << (tests.back() = !ncpass::Keychain::solveChallenge(changed("/salts/0"_json_pointer, 1), password)) << endl;
+    tests.push_back(false); cout << setw(TEST_WIDTH) << "Salts type pass? "  << (tests.back() = !ncpass::Keychain::solveChallenge(changed("/salts"_json_pointer, "salts"), password)) << endl;
+    tests.push_back(false); cout << setw(TEST_WIDTH) << "Not object pass? "  << (tests.back() = !ncpass::Keychain::solveChallenge(nullptr, password)) << endl;
+
+
+    // return fail status if any tests failed
+    for( bool test : tests )
+    {
+        if( !test )
+            return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,175 @@
+/*
+ * ncpasscpp. A library that implements Nextcloud Password's API.
+ * Copyright (C) 2021  Reed Krantz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+// Test for RequestLimiter class
+// purpose: Check the cap on requests in flight, the order of the lanes, urgent requests and the token bucket.
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <CancellationToken.hpp>
+#include <RequestLimiter.hpp>
+
+// Used to format output as an argument to std::setw().
+#define TEST_WIDTH 32
+
+using namespace std;
+
+
+int main(int argc, char** argv)
+{
+    if( argc != 1 )
+    {
+        cout << argv[0] << " takes no arguments.\n";
+
+        return 1;
+    }
+
+    // print "true"/"false" for bools
+    cout << boolalpha;
+
+    std::vector<bool> tests; // The results of all the tests.
+
+
+    // A request over the cap waits until its token is cancelled.
+    {
+        ncpass::RequestLimiter limiter(0, 1, 2);
+
+        ncpass::RequestLimiter::Slot first  = limiter.acquire();
+        ncpass::RequestLimiter::Slot second = limiter.acquire();
+        ncpass::RequestLimiter::Slot third  = limiter.acquire(ncpass::RequestLimiter::NORMAL, ncpass::CancellationToken::after(50ms));
+
+
+        tests.push_back(false); cout << setw(TEST_WIDTH) << "Cap pass? " << (tests.back() = first && second && !third) << endl;
+
+        // Releasing a slot makes room for the next request.
+        second.release();
+
+        ncpass::RequestLimiter::Slot fourth = limiter.acquire(ncpass::RequestLimiter::NORMAL, ncpass::CancellationToken::after(50ms));
+
+
+        tests.push_back(false); cout << setw(TEST_WIDTH) << "Release pass? " << (tests.back() = bool(fourth)) << endl;
+    }
+
+    // Bulk requests leave the last slot to the others.
+    {
+        ncpass::RequestLimiter limiter(0, 1, 2);
+
+        ncpass::RequestLimiter::Slot held   = limiter.acquire();
+        ncpass::RequestLimiter::Slot bulk   = limiter.acquire(ncpass::RequestLimiter::BULK, ncpass::CancellationToken::after(50ms));
+        ncpass::RequestLimiter::Slot normal = limiter.acquire(ncpass::RequestLimiter::NORMAL, ncpass::CancellationToken::after(50ms));
+
+
+        tests.push_back(false); cout << setw(TEST_WIDTH) << "Bulk reserve pass? " << (tests.back() = !bulk && normal) << endl;
+    }
+
+    // Waiting requests are admitted by lane, then in the order they arrived. An urgent request moves up to the interactive lane.
+    {
+        ncpass::RequestLimiter   limiter(0, 1, 1);
+        ncpass::CancellationToken urgentToken;
+        std::mutex               orderMutex;
+        std::vector<std::string> order;
+        std::vector<std::thread> threads;
+
+        ncpass::RequestLimiter::Slot held = limiter.acquire();
+
+
+        auto queue = [&] (ncpass::RequestLimiter::Priority priority, const std::string& name, const ncpass::CancellationToken& token)
+          {
+              threads.emplace_back([&, priority, name, token] ()
+                {
+                    ncpass::RequestLimiter::Slot slot = limiter.acquire(priority, token);
+
+                    std::unique_lock lock(orderMutex);
+
+                    order.push_back(slot ? name : "cancelled " + name);
+                }
+                );
+
+              // Gives the thread time to queue up.
+              std::this_thread::sleep_for(20ms);
+          };
+
+        queue(ncpass::RequestLimiter::BULK, "bulk", ncpass::CancellationToken());
+        queue(ncpass::RequestLimiter::NORMAL, "normal 1", ncpass::CancellationToken());
+        queue(ncpass::RequestLimiter::NORMAL, "normal 2", urgentToken);
+        queue(ncpass::RequestLimiter::INTERACTIVE, "interactive", ncpass::CancellationToken());
+        queue(ncpass::RequestLimiter::NORMAL, "normal 3", ncpass::CancellationToken::after(10ms));
+
+        urgentToken.setUrgent();
+        std::this_thread::sleep_for(20ms);
+        held.release();
+
+        for( std::thread& thread : threads )
+            thread.join();
+
+        const std::vector<std::string> expected = { "cancelled normal 3", "interactive", "normal 2", "normal 1", "bulk" };
+
+
+        tests.push_back(false); cout << setw(TEST_WIDTH) << "Lane order pass? " << (tests.back() = order == expected) << endl;
+    }
+
+    // Requests over the burst wait for tokens to be refilled.
+    {
+        ncpass::RequestLimiter limiter(20, 2, 0);
+
+        const auto start = std::chrono::steady_clock::now();
+
+
+        for( int i = 0; i < 2; i++ )
+            limiter.acquire();
+
+        const auto burst = std::chrono::steady_clock::now() - start;
+
+
+        for( int i = 0; i < 4; i++ )
+            limiter.acquire();
+
+        const auto refill = std::chrono::steady_clock::now() - start;
+
+
+        tests.push_back(false); cout << setw(TEST_WIDTH) << "Burst pass? "  << (tests.back() = burst < 40ms) << endl;
+        tests.push_back(false); cout << setw(TEST_WIDTH) << "Refill pass? " << (tests.back() = (refill >= 180ms) && (refill < 1s)) << endl;
+
+        // Turning the rate limit off lets waiting requests through right away.
+        limiter.setRateLimit(0, 1);
+
+        const auto unlimited = std::chrono::steady_clock::now();
+
+
+        for( int i = 0; i < 100; i++ )
+            limiter.acquire();
+
+        tests.push_back(false); cout << setw(TEST_WIDTH) << "Unlimited pass? " << (tests.back() = std::chrono::steady_clock::now() - unlimited < 40ms) << endl;
+    }
+
+
+    // return fail status if any tests failed
+    for( bool test : tests )
+    {
+        if( !test )
+            return 1;
+    }
+
+    return 0;
+}
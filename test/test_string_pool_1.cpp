@@ -0,0 +1,97 @@
+/*
+ * ncpasscpp. A library that implements Nextcloud Password's API.
+ * Copyright (C) 2021  Reed Krantz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+// Test for StringPool class
+// purpose: Check that equal strings share one allocation and are removed from the pool with their last handle.
+
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <StringPool.hpp>
+
+// Used to format output as an argument to std::setw().
+#define TEST_WIDTH 32
+
+using namespace std;
+
+
+int main(int argc, char** argv)
+{
+    if( argc != 1 )
+    {
+        cout << argv[0] << " takes no arguments.\n";
+
+        return 1;
+    }
+
+    // print "true"/"false" for bools
+    cout << boolalpha;
+
+    std::vector<bool> tests; // The results of all the tests.
+
+    ncpass::StringPool::Handle survivor; // Outlives the pool.
+
+
+    {
+        ncpass::StringPool pool;
+
+        ncpass::StringPool::Handle first  = pool.intern("https://example.com");
+        ncpass::StringPool::Handle second = pool.intern(string("https://") + "example.com");
+        ncpass::StringPool::Handle other  = pool.intern("https://example.org");
+
+
+        tests.push_back(false); cout << setw(TEST_WIDTH) << "Share pass? "    << (tests.back() = (first == second) && (*first == "https://example.com")) << endl;
+        tests.push_back(false); cout << setw(TEST_WIDTH) << "Distinct pass? " << (tests.back() = (first != other) && (*other == "https://example.org")) << endl;
+        tests.push_back(false); cout << setw(TEST_WIDTH) << "Size pass? "     << (tests.back() = pool.size() == 2) << endl;
+
+        // The string stays in the pool until its last handle is gone.
+        first.reset();
+
+        const bool kept = pool.size() == 2;
+
+
+        second.reset();
+
+        tests.push_back(false); cout << setw(TEST_WIDTH) << "Release pass? " << (tests.back() = kept && (pool.size() == 1)) << endl;
+
+        // A released string is interned again as a new string.
+        ncpass::StringPool::Handle again = pool.intern("https://example.com");
+
+
+        tests.push_back(false); cout << setw(TEST_WIDTH) << "Intern again pass? " << (tests.back() = (*again == "https://example.com") && (pool.size() == 2)) << endl;
+
+        survivor = other;
+    }
+
+    tests.push_back(false); cout << setw(TEST_WIDTH) << "Outlive pool pass? " << (tests.back() = *survivor == "https://example.org") << endl;
+
+    survivor.reset();
+
+
+    // return fail status if any tests failed
+    for( bool test : tests )
+    {
+        if( !test )
+            return 1;
+    }
+
+    return 0;
+}
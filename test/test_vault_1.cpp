@@ -0,0 +1,164 @@
+/*
+ * ncpasscpp. A library that implements Nextcloud Password's API.
+ * Copyright (C) 2021  Reed Krantz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+// Test for Vault class
+// purpose: Import CSV files and JSON backups into a stand-in server and export them again.
+//          Checks quoted CSV fields and that JSON backups are only imported if they state that they aren't encrypted before their passwords.
+
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <Session.hpp>
+#include <Vault.hpp>
+#include <nlohmann/json.hpp>
+#include "../stress/standInServer.cpp"
+
+// Used to format output as an argument to std::setw().
+#define TEST_WIDTH 32
+
+using namespace std;
+
+
+int main(int argc, char** argv)
+{
+    if( argc != 1 )
+    {
+        cout << argv[0] << " takes no arguments.\n";
+
+        return 1;
+    }
+
+    // print "true"/"false" for bools
+    cout << boolalpha;
+
+    StandInServer server(2, chrono::microseconds(0));
+
+    shared_ptr<ncpass::Session> session = ncpass::Session::create("test", server.getRoot(), "test");
+    size_t                      created = 0; // The amount of passwords created on the server so far.
+
+    // Maps the labels of the passwords created on the server since the last call to the passwords.
+    auto getCreated = [&] ()
+      {
+          map<string, nlohmann::json> passwords;
+          char                        id[48];
+
+
+          for( ; passwords.size() < 100; created++ )
+          {
+              snprintf(id, sizeof(id), "10000000-0000-0000-0000-%012zu", created + 2);
+
+              try
+              {
+                  nlohmann::json password = server.getPassword(id);
+
+                  passwords[password.at("label")] = password;
+              }
+              catch( const out_of_range& e )
+              {
+                  break;
+              }
+          }
+
+          return passwords;
+      };
+
+    std::vector<bool> tests; // The results of all the tests.
+
+
+    // Quoted fields may hold commas, quotes and line breaks. Columns are matched by name, unknown ones are ignored and records without a password are skipped.
+    {
+        istringstream in("Title,Login,Password,Extra,URL,Notes\r\n"
+                         "\"Comma, Inc\",alice,\"pa\"\"ss\",x,https://a.example,\"line 1\r\nline 2\"\r\n"
+                         "Plain,bob,secret,,https://b.example,\n"
+                         "No password,carol,,,https://c.example,\r\n");
+
+        ncpass::Vault::ImportResult result = ncpass::Vault::importPasswords(session, in, ncpass::Vault::CSV);
+        map<string, nlohmann::json> passwords = getCreated();
+
+
+        tests.push_back(false); cout << setw(TEST_WIDTH) << "CSV import pass? "
+                                     << (tests.back() = result.complete && (result.created == 2) && (result.failed == 0) && (result.skipped == 1) && (passwords.size() == 2)) << endl;
+        tests.push_back(false); cout << setw(TEST_WIDTH) << "CSV quoting pass? "
+                                     << (tests.back() = passwords.count("Comma, Inc") && (passwords["Comma, Inc"].value("username", "") == "alice") && (passwords["Comma, Inc"].value("password", "") == "pa\"ss") &&
+                                                        (passwords["Comma, Inc"].value("url", "") == "https://a.example") && (passwords["Comma, Inc"].value("notes", "") == "line 1\r\nline 2")) << endl;
+        tests.push_back(false); cout << setw(TEST_WIDTH) << "CSV plain pass? "
+                                     << (tests.back() = passwords.count("Plain") && (passwords["Plain"].value("password", "") == "secret") && (passwords["Plain"].value("notes", "x") == "")) << endl;
+    }
+
+    // A backup stating that it isn't encrypted before its passwords is imported.
+    {
+        istringstream in(R"({"version":2,"encrypted":false,"passwords":[{"label":"From backup","password":"backup","favorite":true}],"folders":[]})");
+
+        ncpass::Vault::ImportResult result = ncpass::Vault::importPasswords(session, in, ncpass::Vault::JSON);
+        map<string, nlohmann::json> passwords = getCreated();
+
+
+        tests.push_back(false); cout << setw(TEST_WIDTH) << "JSON import pass? "
+                                     << (tests.back() = result.complete && (result.created == 1) && passwords.count("From backup") && (passwords["From backup"].value("favorite", false) == true)) << endl;
+    }
+
+    // Passwords before the flag can't be told apart from encrypted ones, so none are imported.
+    {
+        istringstream in(R"({"version":2,"passwords":[{"label":"Too early","password":"early"}],"encrypted":false})");
+
+        ncpass::Vault::ImportResult result = ncpass::Vault::importPasswords(session, in, ncpass::Vault::JSON);
+
+
+        tests.push_back(false); cout << setw(TEST_WIDTH) << "JSON flag order pass? " << (tests.back() = !result.complete && (result.created == 0) && getCreated().empty()) << endl;
+    }
+
+    // Encrypted backups aren't imported.
+    {
+        istringstream in(R"({"version":2,"encrypted":true,"passwords":[{"label":"Encrypted","password":"cipher"}]})");
+
+        ncpass::Vault::ImportResult result = ncpass::Vault::importPasswords(session, in, ncpass::Vault::JSON);
+
+
+        tests.push_back(false); cout << setw(TEST_WIDTH) << "JSON encrypted pass? " << (tests.back() = !result.complete && (result.created == 0) && getCreated().empty()) << endl;
+    }
+
+    // Exports hold every password on the server. CSV fields are quoted, so commas, quotes and line breaks survive.
+    {
+        ostringstream csv;
+        ostringstream json;
+
+        ncpass::Vault::ExportResult csvResult  = ncpass::Vault::exportPasswords(session, csv, ncpass::Vault::CSV);
+        ncpass::Vault::ExportResult jsonResult = ncpass::Vault::exportPasswords(session, json, ncpass::Vault::JSON);
+        nlohmann::json              backup     = nlohmann::json::parse(json.str(), nullptr, false);
+
+
+        tests.push_back(false); cout << setw(TEST_WIDTH) << "CSV export pass? "
+                                     << (tests.back() = csvResult.complete && (csvResult.written == 5) && (csv.str().find("\"Comma, Inc\",\"alice\",\"pa\"\"ss\",\"https://a.example\",\"line 1\r\nline 2\"\r\n") != string::npos)) << endl;
+        tests.push_back(false); cout << setw(TEST_WIDTH) << "JSON export pass? "
+                                     << (tests.back() = jsonResult.complete && (jsonResult.written == 5) && !backup.is_discarded() && (backup.value("encrypted", true) == false) && (backup.at("passwords").size() == 5)) << endl;
+    }
+
+
+    // return fail status if any tests failed
+    for( bool test : tests )
+    {
+        if( !test )
+            return 1;
+    }
+
+    return 0;
+}
@@ -56,3 +56,13 @@ const std::string TEST_SESSION_1_FEDERATEDIDS[] = { "user@cloud.example.com", "u
 #define TEST_PASSWORD_3_USERNAME_OLD "Password Username Old"
 #define TEST_PASSWORD_3_PASSWORD_NEW "password123 New"
 #define TEST_PASSWORD_3_PASSWORD_OLD "password123 Old"
+
+
+
+
+//*****************
+// FOLDER TESTS
+//*****************
+
+//TEST 1 (read only): All folders, tags and passwords of this account will be fetched.
+#define TEST_FOLDER_1_ACCOUNT TEST_PASSWORD_GLOBAL_ACCOUNT